@@ -0,0 +1,338 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * 端到端基准: bench [选项]
+ *
+ *   --threads T    线程数 (默认 1), > 1 时 mul / sqr / unbal 执行 mul_plan_create_mt 建立的计划, 每个规模建一次,
+ *                  任务池与工作区不计入计时; slice / auto 总是单线程
+ *   --cpu K        把进程绑定到 CPU K .. K + T - 1, -1 为不绑定 (默认 0)
+ *   --min-log a    最小长度 2^a (默认 10)
+ *   --max-log b    最大长度 2^b (默认 22)
+ *   --ratio R      不平衡乘法的长度比 len1 / len2 (默认 16)
+ *   --cases s      以逗号分隔的 mul, sqr, unbal, slice, auto (默认全部)
+ *   --warmup W     每个规模计时前的预热次数 (默认 2)
+ *   --reps a,b     每个规模最少 / 最多计时次数 (默认 5,50)
+ *   --tol x        中位数连续 3 次相对变化小于 x 时视为稳定并停止 (默认 0.01)
+ *   --budget ms    每个规模的计时时间上限, 达到最少次数后生效 (默认 2000)
+ *   --csv path     每个 case 一行中位数 (微秒, 逗号分隔), 与 cc_ntt-crt_times.csv / time_plot.m 的格式相同
+ *   --json path    逐规模的 min / median / p95 与重复次数
+ *
+ * 每个 2^k 测两个长度: len1 = 2^k 时变换长度刚好装下, len1 = 2^k + 1 时刚刚越过.
+ * unbal, slice, auto 的 len2 = len1 / ratio, 依次为 abs_mul64 (整个乘积补零后做一次变换), abs_mul64_unbal
+ * (切片) 与 abs_mul64_auto (按长度分派).
+ * 输入由固定种子的 xorshift 生成, 每次运行相同.
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#define NTT_NO_MAIN
+#include "main.c"
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#define BENCH_MAX_SIZES 128
+
+typedef enum { BENCH_MUL, BENCH_SQR, BENCH_UNBAL, BENCH_SLICE, BENCH_AUTO, BENCH_CASE_COUNT } bench_kind;
+
+static const char* bench_case_name[BENCH_CASE_COUNT] = {"mul", "sqr", "unbal", "slice", "auto"};
+
+typedef struct BenchOpts {
+    int threads;
+    int cpu;
+    int min_log, max_log;
+    u64 ratio;
+    bool cases[BENCH_CASE_COUNT];
+    int warmup;
+    int min_reps, max_reps;
+    double tol;
+    double budget_ms;
+    const char* csv_path;
+    const char* json_path;
+} bench_opts;
+
+typedef struct BenchResult {
+    u64 len1, len2;
+    int reps;
+    double min_us, median_us, p95_us;
+} bench_result;
+
+static double bench_now_us(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec * 1e-3;
+}
+
+static u64 bench_rng = 88172645463325252ull;
+
+static void bench_fill(u64* arr, u64 len) {
+    for (u64 ii = 0; ii < len; ii++) {
+        bench_rng ^= bench_rng << 13;
+        bench_rng ^= bench_rng >> 7;
+        bench_rng ^= bench_rng << 17;
+        arr[ii] = bench_rng;
+    }
+}
+
+/* 绑定到 CPU [first, first + count), 之后创建的线程继承该设置 */
+static int bench_pin(int first, int count) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cc = first; cc < first + count; cc++) {
+        CPU_SET(cc, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set);
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cc = first; cc < first + count; cc++) {
+        mask |= (DWORD_PTR)1 << cc;
+    }
+    return SetProcessAffinityMask(GetCurrentProcess(), mask) ? 0 : -1;
+#else
+    (void)first, (void)count;
+    return -1;
+#endif
+}
+
+static int bench_cmp(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* 已排序样本的 q 分位数 (最近秩) */
+static double bench_quantile(const double* sorted, int n, double q) {
+    int rank = (int)(q * n + 0.999999);
+    rank = (rank < 1) ? 1 : (rank > n ? n : rank);
+    return sorted[rank - 1];
+}
+
+/* plan 不为 NULL 时 mul / sqr / unbal 用它计算 */
+static void bench_call(bench_kind kind, mul_plan* plan, u64* in1, u64 len1, u64* in2, u64 len2, u64* out) {
+    if (kind == BENCH_SLICE) {
+        abs_mul64_unbal(in1, len1, in2, len2, out);
+    } else if (kind == BENCH_AUTO) {
+        abs_mul64_auto(in1, len1, in2, len2, out);
+    } else if (plan != NULL) {
+        mul_plan_execute(plan, in1, len1, (kind == BENCH_SQR) ? in1 : in2, len2, out);
+    } else if (kind == BENCH_SQR) {
+        abs_sqr64(in1, len1, out);
+    } else {
+        abs_mul64(in1, len1, in2, len2, out);
+    }
+}
+
+/* 预热后反复计时, 直到中位数稳定, 次数用完或超出时间上限 */
+static bench_result bench_one(const bench_opts* opt, bench_kind kind, u64 len1, u64 len2) {
+    bench_result res = {len1, len2, 0, 0, 0, 0};
+    u64 *in1 = (u64*)malloc(len1 * sizeof(u64)), *in2 = (u64*)malloc(len2 * sizeof(u64));
+    u64* out = (u64*)malloc((len1 + len2) * sizeof(u64));
+    double* samples = (double*)malloc(opt->max_reps * sizeof(double));
+    double* sorted = (double*)malloc(opt->max_reps * sizeof(double));
+    if (in1 == NULL || in2 == NULL || out == NULL || samples == NULL || sorted == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    bench_fill(in1, len1);
+    bench_fill(in2, len2);
+    mul_plan* plan = NULL;
+    if (opt->threads > 1 && kind != BENCH_SLICE && kind != BENCH_AUTO) {
+        plan = mul_plan_create_mt(len1, len2, MUL_PLAN_DEFAULT, opt->threads);
+        if (plan == NULL) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            abort();
+        }
+    }
+
+    for (int ww = 0; ww < opt->warmup; ww++) {
+        bench_call(kind, plan, in1, len1, in2, len2, out);
+    }
+    double begin = bench_now_us(), last_median = 0;
+    int n = 0, stable = 0;
+    while (n < opt->max_reps) {
+        double start = bench_now_us();
+        bench_call(kind, plan, in1, len1, in2, len2, out);
+        samples[n++] = bench_now_us() - start;
+        if (n < opt->min_reps) {
+            continue;
+        }
+        memcpy(sorted, samples, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), bench_cmp);
+        double median = bench_quantile(sorted, n, 0.5), diff = median - last_median;
+        stable = ((diff < 0 ? -diff : diff) < opt->tol * median) ? stable + 1 : 0;
+        last_median = median;
+        if (stable >= 3 || bench_now_us() - begin > opt->budget_ms * 1e3) {
+            break;
+        }
+    }
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), bench_cmp);
+    res.reps = n;
+    res.min_us = sorted[0];
+    res.median_us = bench_quantile(sorted, n, 0.5);
+    res.p95_us = bench_quantile(sorted, n, 0.95);
+
+    mul_plan_destroy(&plan);
+    free(sorted);
+    free(samples);
+    free(out);
+    free(in2);
+    free(in1);
+    return res;
+}
+
+static void bench_usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--threads T] [--cpu K] [--min-log a] [--max-log b] [--ratio R]\n"
+            "          [--cases mul,sqr,unbal,slice,auto] [--warmup W] [--reps min,max] [--tol x] [--budget ms]\n"
+            "          [--csv path] [--json path]\n",
+            prog);
+}
+
+static int bench_parse(int argc, char** argv, bench_opts* opt) {
+    *opt = (bench_opts){1, 0, 10, 22, 16, {true, true, true, true, true}, 2, 5, 50, 0.01, 2000, NULL, NULL};
+    for (int ii = 1; ii < argc; ii++) {
+        const char* key = argv[ii];
+        if (ii + 1 >= argc) {
+            return -1;
+        }
+        const char* val = argv[++ii];
+        if (strcmp(key, "--threads") == 0) {
+            opt->threads = atoi(val);
+        } else if (strcmp(key, "--cpu") == 0) {
+            opt->cpu = atoi(val);
+        } else if (strcmp(key, "--min-log") == 0) {
+            opt->min_log = atoi(val);
+        } else if (strcmp(key, "--max-log") == 0) {
+            opt->max_log = atoi(val);
+        } else if (strcmp(key, "--ratio") == 0) {
+            opt->ratio = strtoull(val, NULL, 10);
+        } else if (strcmp(key, "--cases") == 0) {
+            for (int cc = 0; cc < BENCH_CASE_COUNT; cc++) {
+                opt->cases[cc] = (strstr(val, bench_case_name[cc]) != NULL);
+            }
+        } else if (strcmp(key, "--warmup") == 0) {
+            opt->warmup = atoi(val);
+        } else if (strcmp(key, "--reps") == 0) {
+            if (sscanf(val, "%d,%d", &opt->min_reps, &opt->max_reps) != 2) {
+                return -1;
+            }
+        } else if (strcmp(key, "--tol") == 0) {
+            opt->tol = atof(val);
+        } else if (strcmp(key, "--budget") == 0) {
+            opt->budget_ms = atof(val);
+        } else if (strcmp(key, "--csv") == 0) {
+            opt->csv_path = val;
+        } else if (strcmp(key, "--json") == 0) {
+            opt->json_path = val;
+        } else {
+            return -1;
+        }
+    }
+    if (opt->threads < 1 || opt->min_log < 0 || opt->max_log > 40 || opt->min_log > opt->max_log || opt->ratio < 1 ||
+        opt->min_reps < 1 || opt->max_reps < opt->min_reps || (opt->max_log - opt->min_log + 1) * 2 > BENCH_MAX_SIZES) {
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bench_opts opt;
+    if (bench_parse(argc, argv, &opt) != 0) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    if (opt.cpu >= 0 && bench_pin(opt.cpu, opt.threads) != 0) {
+        fprintf(stderr, "warning: failed to pin to cpu %d..%d\n", opt.cpu, opt.cpu + opt.threads - 1);
+    }
+
+    u64 sizes[BENCH_MAX_SIZES];
+    int size_count = 0;
+    for (int kk = opt.min_log; kk <= opt.max_log; kk++) {
+        sizes[size_count++] = 1ull << kk;
+        sizes[size_count++] = (1ull << kk) + 1;
+    }
+
+    static bench_result results[BENCH_CASE_COUNT][BENCH_MAX_SIZES];
+    printf("%-6s %10s %10s %5s %12s %12s %12s\n", "case", "len1", "len2", "reps", "min_us", "median_us", "p95_us");
+    for (int cc = 0; cc < BENCH_CASE_COUNT; cc++) {
+        if (!opt.cases[cc]) {
+            continue;
+        }
+        for (int ss = 0; ss < size_count; ss++) {
+            u64 len1 = sizes[ss], len2 = len1;
+            if (cc == BENCH_UNBAL || cc == BENCH_SLICE || cc == BENCH_AUTO) {
+                len2 = (len1 / opt.ratio > 0) ? len1 / opt.ratio : 1;
+            }
+            bench_result* res = &results[cc][ss];
+            *res = bench_one(&opt, (bench_kind)cc, len1, len2);
+            printf("%-6s %10llu %10llu %5d %12.1f %12.1f %12.1f\n", bench_case_name[cc], res->len1, res->len2,
+                   res->reps, res->min_us, res->median_us, res->p95_us);
+            fflush(stdout);
+        }
+    }
+
+    if (opt.csv_path != NULL) {
+        FILE* fp = fopen(opt.csv_path, "w");
+        if (fp == NULL) {
+            perror(opt.csv_path);
+            return 1;
+        }
+        for (int cc = 0; cc < BENCH_CASE_COUNT; cc++) {
+            if (!opt.cases[cc]) {
+                continue;
+            }
+            for (int ss = 0; ss < size_count; ss++) {
+                fprintf(fp, (ss + 1 < size_count) ? "%lld," : "%lld\n", (long long)results[cc][ss].median_us);
+            }
+        }
+        fclose(fp);
+    }
+    if (opt.json_path != NULL) {
+        FILE* fp = fopen(opt.json_path, "w");
+        if (fp == NULL) {
+            perror(opt.json_path);
+            return 1;
+        }
+        fprintf(fp, "{\"threads\": %d, \"cpu\": %d, \"results\": [", opt.threads, opt.cpu);
+        bool first = true;
+        for (int cc = 0; cc < BENCH_CASE_COUNT; cc++) {
+            if (!opt.cases[cc]) {
+                continue;
+            }
+            for (int ss = 0; ss < size_count; ss++) {
+                const bench_result* res = &results[cc][ss];
+                fprintf(fp,
+                        "%s\n  {\"case\": \"%s\", \"len1\": %llu, \"len2\": %llu, \"reps\": %d, \"min_us\": %.1f, "
+                        "\"median_us\": %.1f, \"p95_us\": %.1f}",
+                        first ? "" : ",", bench_case_name[cc], res->len1, res->len2, res->reps, res->min_us,
+                        res->median_us, res->p95_us);
+                first = false;
+            }
+        }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+    }
+    return 0;
+}
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 
 #include "data.h"
+#include "port.h"
 
 
 typedef u64 u192[3];
@@ -54,6 +55,7 @@ INLINE bool _u192cmp(const u192 i192, const u192 j192) {
     }
 
 define_mont_qpow(global_mod1, 1) define_mont_qpow(global_mod2, 2) define_mont_qpow(global_mod3, 3)
+define_mont_qpow(global_mod4, 4) define_mont_qpow(global_mod5, 5)
 
 
 // 参数 _i 为第几个模数
@@ -70,22 +72,41 @@ define_mont_qpow(global_mod1, 1) define_mont_qpow(global_mod2, 2) define_mont_qp
 // mont64 r = a - b
 #define _raw_sub_func(r, a, b, _i) _raw_sub(r, a, b, g_mod2(_i))
 
-/* 已指定a, b, c的模数为1，2，3，分别为 mod1，mod2，mod3 */
-INLINE void crt3(mont64 a, mont64 b, mont64 c, u192 res) {
-    static const u192 mod123 = {8610882487532388353ull, 1266215182732886016ull, 59403314713853952ull};
-    static const u128 mod12 = {4431542033332568065ull, 262193940805976064ull};
-    static const u128 mod23 = {6124895493223874561ull, 440789813528887296ull};
-    static const u128 mod13 = {6665327448508334081ull, 563231428398022656ull};
-    static const mont64 mont_mod23_inv1 = 84629344487098392ull;
-    static const mont64 mont_mod13_inv2 = 75311807962221426ull;
-    static const mont64 mont_mod12_inv3 = 3875284113674644599ull;
-    _mont_mul_func(a, a, mont_mod23_inv1, 1);
-    _mont_mul_func(b, b, mont_mod13_inv2, 2);
-    _mont_mul_func(c, c, mont_mod12_inv3, 3);
-
-    _mont_toint_func(a, 1);
-    _mont_toint_func(b, 2);
-    _mont_toint_func(c, 3);
+/*
+ * crt3_inv1 = (mod2 * mod3)^-1 mod mod1 等, 为普通整数 (非 Montgomery 形式):
+ * Montgomery 形式的 a 与它做一次 mulinto 即得 crt3 所需的规范普通整数, 省去单独的 toint.
+ */
+static const u64 crt3_inv1 = 1732990254339016397ull;
+static const u64 crt3_inv2 = 304596135511888093ull;
+static const u64 crt3_inv3 = 1340113330676967513ull;
+#define g_crt3_inv(_i) crt3_inv##_i
+
+/*
+ * k 个模数 (取前 k 个) 的 Garner CRT, x_j 为第 j 个模数下 Montgomery 形式的余数, 混合进制数字为
+ * v_j = x_j * garner_inv[j] + sum_{i < j} v_i * garner_coef[j][i] (mod p_j), 结果为 sum_j v_j * p_0 ... p_{j-1}.
+ * garner_inv[j] = (p_0 ... p_{j-1})^-1 mod p_j 为普通整数, garner_coef[j][i] = -(p_0 ... p_{i-1}) * garner_inv[j]
+ * 为 Montgomery 形式, 两者都与 mulinto 配合, 得到的 v_j 为规范的普通整数.
+ * garner_bits[k] = floor(log2(p_0 ... p_{k-1})), 结果不超过 garner_bits[k] 位时 k 个模数足够.
+ */
+static const u64 garner_mod[NTT_MOD_MAX] = {1773292353277132801ull, 1705738358866575361ull, 1587518868648099841ull,
+                                            1165306403582115841ull, 979532918953082881ull};
+static const u64 garner_inv[NTT_MOD_MAX] = {1ull, 426434589716643815ull, 1340113330676967513ull, 240708603989930792ull,
+                                            114893009971016208ull};
+static const u64 garner_coef[NTT_MOD_MAX][NTT_MOD_MAX] = {
+    {0},
+    {113715890591104751ull},
+    {122328293774616819ull, 1421207368123060654ull},
+    {1031684602638033044ull, 829698159350466573ull, 1084511826267089099ull},
+    {258663651145417606ull, 736149169957551963ull, 416878656416396376ull, 112794699758233687ull},
+};
+static const unsigned garner_bits[NTT_MOD_MAX + 1] = {0, 60, 121, 181, 241, 301};
+
+/* a, b, c 为 mulinto crt3_inv 之后的普通整数, res = (mod23 * a + mod13 * b + mod12 * c) mod mod123 */
+INLINE void crt3_combine(u64 a, u64 b, u64 c, u192 res) {
+    static const u192 mod123 = {5066549580791808001ull, 463377149617766400ull, 14111468421120000ull};
+    static const u128 mod12 = {3479030712143708161ull, 163973261426688000ull};
+    static const u128 mod23 = {3293257227514675201ull, 146795110229606400ull};
+    static const u128 mod13 = {3360811221925232641ull, 152608777961472000ull};
     u192 tmp = {0, 0, 0};
     _u128x64to192(res, mod23, a);
     _u128x64to192(tmp, mod13, b);
@@ -100,6 +121,14 @@ INLINE void crt3(mont64 a, mont64 b, mont64 c, u192 res) {
     }
 }
 
+/* 已指定a, b, c的模数为1，2，3，分别为 mod1，mod2，mod3 */
+INLINE void crt3(mont64 a, mont64 b, mont64 c, u192 res) {
+    _mont_mulinto_func(a, g_crt3_inv(1), 1);
+    _mont_mulinto_func(b, g_crt3_inv(2), 2);
+    _mont_mulinto_func(c, g_crt3_inv(3), 3);
+    crt3_combine(a, b, c, res);
+}
+
 #define _transform2(sum, diff, _i)           \
     do {                                     \
         mont64 _t = sum, _u = diff;          \
@@ -138,6 +167,55 @@ INLINE void crt3(mont64 a, mont64 b, mont64 c, u192 res) {
         _raw_sub_func(r3, t1, t3, _i);         \
     } while (0)
 
+/*
+ * 奇数 m 点 DFT (m = 3, 5), 原地: x[r] = sum_j x[j] * w_m^(r * j).
+ * j 与 m - j 配对: cs[k] = (w^k + w^-k) / 2, cs[m + k] = (w^k - w^-k) / 2, 共 (m - 1)^2 / 2 次乘法.
+ * 用 w_m^-1 生成 cs 即为逆变换 (不含 1 / m). 输入输出均为规范值
+ */
+#define NTT_RADIX_MAX 5
+
+#define define_dft_odd(_i)                                                              \
+    INLINE void dft_odd_##_i(mont64 x[], const mont64 cs[], size_t m) {                 \
+        const size_t half = m / 2;                                                      \
+        mont64 sum[NTT_RADIX_MAX / 2 + 1], dif[NTT_RADIX_MAX / 2 + 1], x0 = x[0];       \
+        for (size_t jj = 1; jj <= half; jj++) {                                         \
+            _mont_add(sum[jj], x[jj], x[m - jj], g_mod(_i));                            \
+            _mont_sub(dif[jj], x[jj], x[m - jj], g_mod(_i));                            \
+            _mont_add(x[0], x[0], sum[jj], g_mod(_i));                                  \
+        }                                                                               \
+        for (size_t rr = 1; rr <= half; rr++) {                                         \
+            mont64 a = x0, b = 0;                                                       \
+            for (size_t jj = 1, kk = rr; jj <= half; jj++, kk = (kk + rr) % m) {        \
+                mont64 t = sum[jj], u = dif[jj];                                        \
+                _mont_mulinto_func(t, cs[kk], _i);                                      \
+                _mont_mulinto_func(u, cs[m + kk], _i);                                  \
+                _mont_add(a, a, t, g_mod(_i));                                          \
+                _mont_add(b, b, u, g_mod(_i));                                          \
+            }                                                                           \
+            _mont_add(x[rr], a, b, g_mod(_i));                                          \
+            _mont_sub(x[m - rr], a, b, g_mod(_i));                                      \
+        }                                                                               \
+    }                                                                                   \
+    /* w 为 m 次单位根 (g_w31 / g_w51 或其逆), 生成 dft_odd 的系数 */                       \
+    INLINE void dft_odd_coef_##_i(mont64 cs[], mont64 w, size_t m) {                    \
+        mont64 wk[NTT_RADIX_MAX], half = (g_mod(_i) + 1) / 2;                           \
+        _mont_tomont_func(half, _i);                                                    \
+        wk[0] = g_one(_i);                                                              \
+        for (size_t kk = 1; kk < m; kk++) {                                             \
+            wk[kk] = wk[kk - 1];                                                        \
+            _mont_mulinto_func(wk[kk], w, _i);                                          \
+        }                                                                               \
+        for (size_t kk = 0; kk < m; kk++) {                                             \
+            mont64 wn = wk[(m - kk) % m];                                               \
+            _mont_add(cs[kk], wk[kk], wn, g_mod(_i));                                   \
+            _mont_sub(cs[m + kk], wk[kk], wn, g_mod(_i));                               \
+            _mont_mulinto_func(cs[kk], half, _i);                                       \
+            _mont_mulinto_func(cs[m + kk], half, _i);                                   \
+        }                                                                               \
+    }
+
+define_dft_odd(1) define_dft_odd(2) define_dft_odd(3) define_dft_odd(4) define_dft_odd(5)
+
 #define _dit_butterfly2(r0, r1, o, _i) \
     do {                               \
         mont64 x, y;                   \
@@ -156,6 +234,7 @@ INLINE void crt3(mont64 a, mont64 b, mont64 c, u192 res) {
         _mont_mul_func(r1, y, o, _i);  \
     } while (0)
 
+#include "simd.h"
 
 typedef struct NTTshort {
     size_t ntt_len;
@@ -166,6 +245,33 @@ typedef struct NTTshort {
 
 typedef struct NTTshort intt_short;
 
+// 填充 [from_log, to_log] 层的 omega / iomega, 第 k 层位于 omega + 2^k / 2
+#define define_ntt_short_fill(_i)                                                               \
+    INLINE void fill_nttshort_##_i(ntt_short* in, size_t from_log, size_t to_log) {             \
+        if (from_log == 0) {                                                                    \
+            *(in->omega) = 0;                                                                   \
+            *(in->iomega) = 0;                                                                  \
+        }                                                                                       \
+        for (size_t omega_log_len = from_log; omega_log_len <= to_log; omega_log_len++) {       \
+            size_t omega_len = 1ull << omega_log_len, omega_count = omega_len / 2;              \
+            mont64* it1 = (in->omega) + omega_len / 2;                                          \
+            mont64 root1 = g_mont_root(_i);                                                     \
+            mont64* it2 = (in->iomega) + omega_len / 2;                                         \
+            mont64 root2 = g_mont_rootinv(_i);                                                  \
+            root1 = _mont_qpow_func_name(_i)(root1, (g_mod(_i) - 1) / omega_len);               \
+            root2 = _mont_qpow_func_name(_i)(root2, (g_mod(_i) - 1) / omega_len);               \
+            mont64 omega_one1 = g_one(_i), omega_one2 = g_one(_i);                              \
+            for (size_t ii = 0; ii < omega_count; ii++) {                                       \
+                it1[ii] = omega_one1;                                                           \
+                _mont_mul_func(omega_one1, omega_one1, root1, _i);                              \
+                it2[ii] = omega_one2;                                                           \
+                _mont_mul_func(omega_one2, omega_one2, root2, _i);                              \
+            }                                                                                   \
+        }                                                                                       \
+    }
+
+define_ntt_short_fill(1) define_ntt_short_fill(2) define_ntt_short_fill(3) define_ntt_short_fill(4) define_ntt_short_fill(5)
+
 #define define_ntt_short_create(_i)                                                \
     INLINE void create_nttshort_##_i(const size_t lg_len, ntt_short* in) {         \
         assert(in->log_len == lg_len);                                             \
@@ -188,24 +294,7 @@ typedef struct NTTshort intt_short;
             in = NULL;                                                             \
             return;                                                                \
         }                                                                          \
-        *(in->omega) = 0;                                                          \
-        *(in->iomega) = 0;                                                         \
-        for (size_t omega_log_len = 0; omega_log_len <= lg_len; omega_log_len++) { \
-            size_t omega_len = 1ull << omega_log_len, omega_count = omega_len / 2; \
-            mont64* it1 = (in->omega) + omega_len / 2;                             \
-            mont64 root1 = g_mont_root(_i);                                        \
-            mont64* it2 = (in->iomega) + omega_len / 2;                            \
-            mont64 root2 = g_mont_rootinv(_i);                                     \
-            root1 = _mont_qpow_func_name(_i)(root1, (g_mod(_i) - 1) / omega_len);  \
-            root2 = _mont_qpow_func_name(_i)(root2, (g_mod(_i) - 1) / omega_len);  \
-            mont64 omega_one1 = g_one(_i), omega_one2 = g_one(_i);                 \
-            for (size_t ii = 0; ii < omega_count; ii++) {                          \
-                it1[ii] = omega_one1;                                              \
-                _mont_mul_func(omega_one1, omega_one1, root1, _i);                 \
-                it2[ii] = omega_one2;                                              \
-                _mont_mul_func(omega_one2, omega_one2, root2, _i);                 \
-            }                                                                      \
-        }                                                                          \
+        fill_nttshort_##_i(in, 0, lg_len);                                         \
     }
 
 #define define_ntt_short_cover(_i)                                                 \
@@ -214,24 +303,7 @@ typedef struct NTTshort intt_short;
         assert(in->ntt_len == (1ull << lg_len));                                   \
         assert(in->omega != NULL);                                                 \
         assert(in->iomega != NULL);                                                \
-        *(in->omega) = 0;                                                          \
-        *(in->iomega) = 0;                                                         \
-        for (size_t omega_log_len = 0; omega_log_len <= lg_len; omega_log_len++) { \
-            size_t omega_len = 1ull << omega_log_len, omega_count = omega_len / 2; \
-            mont64* it1 = (in->omega) + omega_len / 2;                             \
-            mont64 root1 = g_mont_root(_i);                                        \
-            mont64* it2 = (in->iomega) + omega_len / 2;                            \
-            mont64 root2 = g_mont_rootinv(_i);                                     \
-            root1 = _mont_qpow_func_name(_i)(root1, (g_mod(_i) - 1) / omega_len);  \
-            root2 = _mont_qpow_func_name(_i)(root2, (g_mod(_i) - 1) / omega_len);  \
-            mont64 omega_one1 = g_one(_i), omega_one2 = g_one(_i);                 \
-            for (size_t ii = 0; ii < omega_count; ii++) {                          \
-                it1[ii] = omega_one1;                                              \
-                _mont_mul_func(omega_one1, omega_one1, root1, _i);                 \
-                it2[ii] = omega_one2;                                              \
-                _mont_mul_func(omega_one2, omega_one2, root2, _i);                 \
-            }                                                                      \
-        }                                                                          \
+        fill_nttshort_##_i(in, 0, lg_len);                                         \
     }
 
 void destroy_nttshort(struct NTTshort** in) {
@@ -270,14 +342,121 @@ void destroy_nttshort_stack(struct NTTshort* in) {
 define_ntt_short_create(1) 
 define_ntt_short_create(2) 
 define_ntt_short_create(3) 
+define_ntt_short_create(4) 
+define_ntt_short_create(5) 
 
 define_ntt_short_cover(1) 
 define_ntt_short_cover(2) 
 define_ntt_short_cover(3) 
+define_ntt_short_cover(4) 
+define_ntt_short_cover(5) 
 
 #define create_nttshort_func(lg_len, in, _i) create_nttshort_##_i(lg_len, in)
 #define cover_nttshort_func(lg_len, in, _i) cover_nttshort_##_i(lg_len, in)
 
+/*
+ * 进程内共享的 twiddle 表, 每个模数一份, 容量为 long_threshold.
+ * 各层互不依赖, 按调用中出现过的最大 log_len 逐层增长, 已填好的层只读.
+ * levels 为已填好的层数 (0 ~ levels - 1 层可用), 读侧只需一次 acquire load.
+ */
+#define NTT_CACHE_LOG 17
+#define NTT_CACHE_LEN (1ULL << NTT_CACHE_LOG)
+
+typedef struct NTTcache {
+    ntt_short table;
+    atomic_size_t levels;
+    pthread_mutex_t lock;
+} ntt_cache;
+
+static _Alignas(64) mont64 ntt_cache_omega[NTT_MOD_MAX][NTT_CACHE_LEN];
+static _Alignas(64) mont64 ntt_cache_iomega[NTT_MOD_MAX][NTT_CACHE_LEN];
+
+static ntt_cache ntt_caches[NTT_MOD_MAX] = {
+    {{NTT_CACHE_LEN, NTT_CACHE_LOG, ntt_cache_omega[0], ntt_cache_iomega[0]}, 0, PTHREAD_MUTEX_INITIALIZER},
+    {{NTT_CACHE_LEN, NTT_CACHE_LOG, ntt_cache_omega[1], ntt_cache_iomega[1]}, 0, PTHREAD_MUTEX_INITIALIZER},
+    {{NTT_CACHE_LEN, NTT_CACHE_LOG, ntt_cache_omega[2], ntt_cache_iomega[2]}, 0, PTHREAD_MUTEX_INITIALIZER},
+    {{NTT_CACHE_LEN, NTT_CACHE_LOG, ntt_cache_omega[3], ntt_cache_iomega[3]}, 0, PTHREAD_MUTEX_INITIALIZER},
+    {{NTT_CACHE_LEN, NTT_CACHE_LOG, ntt_cache_omega[4], ntt_cache_iomega[4]}, 0, PTHREAD_MUTEX_INITIALIZER},
+};
+
+#define define_ntt_cache_get(_i)                                                           \
+    INLINE ntt_short* get_nttshort_##_i(size_t lg_len) {                                   \
+        ntt_cache* cache = ntt_caches + (_i - 1);                                          \
+        assert((1ull << lg_len) <= NTT_CACHE_LEN);                                         \
+        if (atomic_load_explicit(&cache->levels, memory_order_acquire) <= lg_len) {        \
+            pthread_mutex_lock(&cache->lock);                                              \
+            size_t levels = atomic_load_explicit(&cache->levels, memory_order_relaxed);    \
+            if (levels <= lg_len) {                                                        \
+                fill_nttshort_##_i(&cache->table, levels, lg_len);                         \
+                atomic_store_explicit(&cache->levels, lg_len + 1, memory_order_release);   \
+            }                                                                              \
+            pthread_mutex_unlock(&cache->lock);                                            \
+        }                                                                                  \
+        return &cache->table;                                                              \
+    }
+
+define_ntt_cache_get(1) define_ntt_cache_get(2) define_ntt_cache_get(3) define_ntt_cache_get(4) define_ntt_cache_get(5)
+
+// 返回可用于长度 2^lg_len 的共享表, 调用者不得修改或释放
+#define get_nttshort_func(lg_len, _i) get_nttshort_##_i(lg_len)
+
+/*
+ * 大层 (> long_threshold) 用到的每层常量, 下标为 log2(ntt_len):
+ * root / root3 为 w_len, w_len^3, rootinv / rootinv3 为其逆, inv_len 为 1 / len, 均为规范的 Montgomery 形式.
+ * 首次使用时一次算好, 之后只读.
+ */
+#define NTT_LEVEL_MAX 63
+
+typedef struct NTTlevel {
+    mont64 root[NTT_LEVEL_MAX];
+    mont64 root3[NTT_LEVEL_MAX];
+    mont64 rootinv[NTT_LEVEL_MAX];
+    mont64 rootinv3[NTT_LEVEL_MAX];
+    mont64 inv_len[NTT_LEVEL_MAX];
+    atomic_bool ready;
+    pthread_mutex_t lock;
+} ntt_level;
+
+static ntt_level ntt_levels[NTT_MOD_MAX] = {
+    {{0}, {0}, {0}, {0}, {0}, false, PTHREAD_MUTEX_INITIALIZER},
+    {{0}, {0}, {0}, {0}, {0}, false, PTHREAD_MUTEX_INITIALIZER},
+    {{0}, {0}, {0}, {0}, {0}, false, PTHREAD_MUTEX_INITIALIZER},
+    {{0}, {0}, {0}, {0}, {0}, false, PTHREAD_MUTEX_INITIALIZER},
+    {{0}, {0}, {0}, {0}, {0}, false, PTHREAD_MUTEX_INITIALIZER},
+};
+
+#define define_ntt_level_get(_i)                                                                  \
+    INLINE const ntt_level* get_ntt_level_##_i(void) {                                            \
+        ntt_level* level = ntt_levels + (_i - 1);                                                 \
+        if (!atomic_load_explicit(&level->ready, memory_order_acquire)) {                         \
+            pthread_mutex_lock(&level->lock);                                                     \
+            if (!atomic_load_explicit(&level->ready, memory_order_relaxed)) {                     \
+                mont64 root = g_root(_i), rootinv = g_rootinv(_i);                                \
+                _mont_tomont_func(root, _i);                                                      \
+                _mont_tomont_func(rootinv, _i);                                                   \
+                for (size_t lg = 0; lg < NTT_LEVEL_MAX; lg++) {                                   \
+                    u64 len = 1ull << lg;                                                         \
+                    if ((g_mod(_i) - 1) % len == 0) {                                             \
+                        level->root[lg] = _mont_qpow_func_name(_i)(root, (g_mod(_i) - 1) / len);  \
+                        level->rootinv[lg] = _mont_qpow_func_name(_i)(rootinv, (g_mod(_i) - 1) / len); \
+                        level->root3[lg] = _mont_qpow_func_name(_i)(level->root[lg], 3);          \
+                        level->rootinv3[lg] = _mont_qpow_func_name(_i)(level->rootinv[lg], 3);    \
+                    }                                                                             \
+                    mont64 inv_len = len;                                                         \
+                    _mont_tomont_func(inv_len, _i);                                               \
+                    level->inv_len[lg] = _mont_qpow_func_name(_i)(inv_len, g_mod(_i) - 2);        \
+                }                                                                                 \
+                atomic_store_explicit(&level->ready, true, memory_order_release);                 \
+            }                                                                                     \
+            pthread_mutex_unlock(&level->lock);                                                   \
+        }                                                                                         \
+        return level;                                                                             \
+    }
+
+define_ntt_level_get(1) define_ntt_level_get(2) define_ntt_level_get(3) define_ntt_level_get(4) define_ntt_level_get(5)
+
+#define get_ntt_level_func(_i) get_ntt_level_##_i()
+
 #define define_ntt_short_di_0(_i)                                        \
     INLINE void ntt_short_dif_0_##_i(mont64 in_out[]) {}                 \
     INLINE void ntt_short_dif_0_len_##_i(mont64 in_out[], size_t len) {} \
@@ -290,9 +469,9 @@ define_ntt_short_cover(3)
     INLINE void intt_short_dit_1_##_i(mont64 in_out[]) {}                \
     INLINE void intt_short_dit_1_len_##_i(mont64 in_out[], size_t len) {} 
 
-define_ntt_short_di_0(1) define_ntt_short_di_0(2) define_ntt_short_di_0(3)
+define_ntt_short_di_0(1) define_ntt_short_di_0(2) define_ntt_short_di_0(3) define_ntt_short_di_0(4) define_ntt_short_di_0(5)
 
-define_ntt_short_di_1(1) define_ntt_short_di_1(2) define_ntt_short_di_1(3)
+define_ntt_short_di_1(1) define_ntt_short_di_1(2) define_ntt_short_di_1(3) define_ntt_short_di_1(4) define_ntt_short_di_1(5)
 
 #define define_ntt_short_di_2(_i)                                                                 \
     INLINE void ntt_short_dif_2_##_i(mont64 in_out[]) { _transform2(in_out[0], in_out[1], _i); }  \
@@ -308,7 +487,7 @@ define_ntt_short_di_1(1) define_ntt_short_di_1(2) define_ntt_short_di_1(3)
         _transform2(in_out[0], in_out[1], _i);                                                    \
     }                                                                                             
 
-define_ntt_short_di_2(1) define_ntt_short_di_2(2) define_ntt_short_di_2(3)
+define_ntt_short_di_2(1) define_ntt_short_di_2(2) define_ntt_short_di_2(3) define_ntt_short_di_2(4) define_ntt_short_di_2(5)
 
 #define define_ntt_short_di_4(_i)                                              \
     INLINE void ntt_short_dif_4_##_i(mont64 in_out[]) {                        \
@@ -412,9 +591,9 @@ define_ntt_short_di_2(1) define_ntt_short_di_2(2) define_ntt_short_di_2(3)
         intt_short_dit_8_##_i(in_out);                                         \
     }                                                                          
 
-define_ntt_short_di_4(1) define_ntt_short_di_4(2) define_ntt_short_di_4(3)
+define_ntt_short_di_4(1) define_ntt_short_di_4(2) define_ntt_short_di_4(3) define_ntt_short_di_4(4) define_ntt_short_di_4(5)
 
-define_ntt_short_di_8(1) define_ntt_short_di_8(2) define_ntt_short_di_8(3)
+define_ntt_short_di_8(1) define_ntt_short_di_8(2) define_ntt_short_di_8(3) define_ntt_short_di_8(4) define_ntt_short_di_8(5)
 
 #define ntt_short_dif_func(in_out, _N, _i) ntt_short_dif_##_N##_##_i(in_out)
 #define ntt_short_dif_len_func(in_out, len, _N, _i) ntt_short_dif_##_N##_len_##_i(in_out, len)
@@ -426,27 +605,58 @@ define_ntt_short_di_8(1) define_ntt_short_di_8(2) define_ntt_short_di_8(3)
 
 static const u64 long_threshold = L2_BYTES / sizeof(mont64);
 #define long_threshold 131072ULL
+_Static_assert(long_threshold == NTT_CACHE_LEN, "twiddle cache must cover long_threshold");
 
 INLINE u64 log2_64(u64 n) {
     if (n == 0) {
         return 0;
     }
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanReverse64(&idx, n);
+    return idx;
+#else
     return 63 - __builtin_clzll(n);
+#endif
 }
 
 #define get_omega_it(table, len) (((table)->omega) + (len) / 2)
 #define get_iomega_it(table, len) (((table)->iomega) + (len) / 2)
 
+/*
+ * in_out 只有前 nz 项可能非零 (其余为 0) 时的正变换, nz = len 即普通的 dif.
+ * nz <= rank / 2 的层每块只有前两个 gap 非零, 不读后两个 gap; ii >= nz 的位置输入全为 0, 输出 0 已在原处, 整段跳过.
+ * 每层之后每块的非零前缀变为 min(nz, gap).
+ */
 #define define_dif(_i)                                                                                             \
-    INLINE void dif_##_i(mont64 in_out[], ntt_short* table, size_t len) {                                          \
+    INLINE void dif_nz_##_i(mont64 in_out[], ntt_short* table, size_t len, size_t nz) {                           \
         assert(len <= long_threshold);                                                                             \
         size_t rank = len;                                                                                         \
         for (; rank >= 16; rank /= 4) {                                                                            \
             size_t gap = rank / 4;                                                                                 \
             mont64 *omega_it = get_omega_it(table, rank), *last_omega_it = get_omega_it(table, rank / 2);          \
             mont64 *it0 = in_out, *it1 = in_out + gap, *it2 = in_out + gap * 2, *it3 = in_out + gap * 3;           \
+            if (nz <= gap * 2) {                                                                                   \
+                size_t end = (nz < gap) ? nz : gap;                                                                \
+                for (size_t jj = 0; jj < len; jj += rank) {                                                        \
+                    size_t ii = _simd_dif_rank_half(it0 + jj, it1 + jj, it2 + jj, it3 + jj, omega_it, last_omega_it, \
+                                                    gap, end, _i);                                                 \
+                    for (; ii < end; ii++) {                                                                       \
+                        mont64 temp0 = it0[jj + ii], temp1 = it1[jj + ii], temp2 = 0, temp3 = 0,                   \
+                               omega = last_omega_it[ii];                                                          \
+                        _dif_butterfly2(temp0, temp2, omega_it[ii], _i);                                           \
+                        _dif_butterfly2(temp1, temp3, omega_it[gap + ii], _i);                                     \
+                        _dif_butterfly2(temp0, temp1, omega, _i);                                                  \
+                        _dif_butterfly2(temp2, temp3, omega, _i);                                                  \
+                        it0[jj + ii] = temp0, it1[jj + ii] = temp1, it2[jj + ii] = temp2, it3[jj + ii] = temp3;    \
+                    }                                                                                              \
+                }                                                                                                  \
+                nz = end;                                                                                          \
+                continue;                                                                                          \
+            }                                                                                                      \
             for (size_t jj = 0; jj < len; jj += rank) {                                                            \
-                for (size_t ii = 0; ii < gap; ii++) {                                                              \
+                size_t ii = _simd_dif_rank(it0 + jj, it1 + jj, it2 + jj, it3 + jj, omega_it, last_omega_it, gap, _i);  \
+                for (; ii < gap; ii++) {                                                                           \
                     mont64 temp0 = it0[jj + ii], temp1 = it1[jj + ii], temp2 = it2[jj + ii], temp3 = it3[jj + ii], \
                            omega = last_omega_it[ii];                                                              \
                     _dif_butterfly2(temp0, temp2, omega_it[ii], _i);                                               \
@@ -456,33 +666,51 @@ INLINE u64 log2_64(u64 n) {
                     it0[jj + ii] = temp0, it1[jj + ii] = temp1, it2[jj + ii] = temp2, it3[jj + ii] = temp3;        \
                 }                                                                                                  \
             }                                                                                                      \
+            nz = gap;                                                                                              \
         }                                                                                                          \
         if (log2_64(rank) % 2 == 0) {                                                                              \
-            ntt_short_dif_len_func(in_out, len, 4, _i);                                                            \
-            for (size_t ii = 4; ii < len; ii += 4) {                                                               \
+            size_t ii = _simd_ntt_short_dif(in_out, len, 4, _i);                                                  \
+            if (ii == 0) {                                                                                         \
+                ntt_short_dif_len_func(in_out, len, 4, _i);                                                        \
+                ii = 4;                                                                                            \
+            }                                                                                                      \
+            for (; ii < len; ii += 4) {                                                                          \
                 ntt_short_dif_func((in_out + ii), 4, _i);                                                          \
             }                                                                                                      \
         } else {                                                                                                   \
-            ntt_short_dif_len_func(in_out, len, 8, _i);                                                            \
-            for (size_t ii = 8; ii < len; ii += 8) {                                                               \
+            size_t ii = _simd_ntt_short_dif(in_out, len, 8, _i);                                                  \
+            if (ii == 0) {                                                                                         \
+                ntt_short_dif_len_func(in_out, len, 8, _i);                                                        \
+                ii = 8;                                                                                            \
+            }                                                                                                      \
+            for (; ii < len; ii += 8) {                                                                          \
                 ntt_short_dif_func((in_out + ii), 8, _i);                                                          \
             }                                                                                                      \
         }                                                                                                          \
-    }
+    }                                                                                                              \
+    INLINE void dif_##_i(mont64 in_out[], ntt_short* table, size_t len) { dif_nz_##_i(in_out, table, len, len); }
 
 #define define_idit(_i)                                                                                            \
     INLINE void idit_##_i(mont64 in_out[], intt_short* table, size_t len) {                                        \
         assert(len <= long_threshold);                                                                             \
         size_t rank = len;                                                                                         \
         if (log2_64(len) % 2 == 0) {                                                                               \
-            intt_short_dit_len_func(in_out, len, 4, _i);                                                           \
-            for (size_t ii = 4; ii < len; ii += 4) {                                                               \
+            size_t ii = _simd_intt_short_dit(in_out, len, 4, _i);                                                 \
+            if (ii == 0) {                                                                                         \
+                intt_short_dit_len_func(in_out, len, 4, _i);                                                       \
+                ii = 4;                                                                                            \
+            }                                                                                                      \
+            for (; ii < len; ii += 4) {                                                                          \
                 intt_short_dit_func((in_out + ii), 4, _i);                                                         \
             }                                                                                                      \
             rank = 16;                                                                                             \
         } else {                                                                                                   \
-            intt_short_dit_len_func(in_out, len, 8, _i);                                                           \
-            for (size_t ii = 8; ii < len; ii += 8) {                                                               \
+            size_t ii = _simd_intt_short_dit(in_out, len, 8, _i);                                                 \
+            if (ii == 0) {                                                                                         \
+                intt_short_dit_len_func(in_out, len, 8, _i);                                                       \
+                ii = 8;                                                                                            \
+            }                                                                                                      \
+            for (; ii < len; ii += 8) {                                                                          \
                 intt_short_dit_func((in_out + ii), 8, _i);                                                         \
             }                                                                                                      \
             rank = 32;                                                                                             \
@@ -492,7 +720,8 @@ INLINE u64 log2_64(u64 n) {
             mont64 *omega_it = get_iomega_it(table, rank), *last_omega_it = get_iomega_it(table, rank / 2);        \
             mont64 *it0 = in_out, *it1 = in_out + gap, *it2 = in_out + gap * 2, *it3 = in_out + gap * 3;           \
             for (size_t jj = 0; jj < len; jj += rank) {                                                            \
-                for (size_t ii = 0; ii < gap; ii++) {                                                              \
+                size_t ii = _simd_idit_rank(it0 + jj, it1 + jj, it2 + jj, it3 + jj, omega_it, last_omega_it, gap, _i); \
+                for (; ii < gap; ii++) {                                                                           \
                     mont64 temp0 = it0[jj + ii], temp1 = it1[jj + ii], temp2 = it2[jj + ii], temp3 = it3[jj + ii], \
                            omega = last_omega_it[ii];                                                              \
                     _dit_butterfly2(temp0, temp1, omega, _i);                                                      \
@@ -505,10 +734,28 @@ INLINE u64 log2_64(u64 n) {
         }                                                                                                          \
     }
 
-define_dif(1) define_dif(2) define_dif(3)
+define_dif(1) define_dif(2) define_dif(3) define_dif(4) define_dif(5)
 
-define_idit(1) define_idit(2) define_idit(3)
+define_idit(1) define_idit(2) define_idit(3) define_idit(4) define_idit(5)
 
 
 #define dif_func(in_out, table, len, _i) dif_##_i(in_out, table, len)
+#define dif_nz_func(in_out, table, len, nz, _i) dif_nz_##_i(in_out, table, len, nz)
 #define idit_func(in_out, table, len, _i) idit_##_i(in_out, table, len)
+
+// out = in1 * in2, norm 时再乘 inv_len
+#define define_pointwise_mul(_i)                                                                                  \
+    INLINE void pointwise_mul_##_i(mont64 out[], const mont64 in1[], const mont64 in2[], size_t len, bool norm,  \
+                                   mont64 inv_len) {                                                              \
+        size_t ii = _simd_pointwise(out, in1, in2, len, norm, inv_len, _i);                                       \
+        for (; ii < len; ii++) {                                                                                  \
+            _mont_mul_func(out[ii], in1[ii], in2[ii], _i);                                                        \
+            if (norm) {                                                                                           \
+                _mont_mulinto_func(out[ii], inv_len, _i);                                                         \
+            }                                                                                                     \
+        }                                                                                                         \
+    }
+
+define_pointwise_mul(1) define_pointwise_mul(2) define_pointwise_mul(3) define_pointwise_mul(4) define_pointwise_mul(5)
+
+#define pointwise_mul_func(out, in1, in2, len, norm, inv_len, _i) pointwise_mul_##_i(out, in1, in2, len, norm, inv_len)
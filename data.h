@@ -47,6 +47,14 @@
 #define g_w41(i) (global_w41_##i)
 /* internal global const */
 #define g_w41inv(i) (global_w41_inv##i)
+/* internal global const, 3 次单位根 */
+#define g_w31(i) (global_w31_##i)
+/* internal global const */
+#define g_w31inv(i) (global_w31_inv##i)
+/* internal global const, 5 次单位根 */
+#define g_w51(i) (global_w51_##i)
+/* internal global const */
+#define g_w51inv(i) (global_w51_inv##i)
 /* internal global const */
 #define g_w1(i) (global_w1_##i)
 /* internal global const */
@@ -60,95 +68,164 @@
 /* internal global const */
 #define g_w3inv(i) (global_w3_inv##i)
 
+/* 模数个数上限: 三模数乘法只用 1 ~ 3, 4 ~ 5 用于系数更大的卷积 */
+#define NTT_MOD_MAX 5
+
 /* R = 2^64 */
 
+/* 五个模数均满足 15 * 2^50 | mod - 1, 可做 2^k, 3 * 2^k, 5 * 2^k 长度的变换; 4, 5 只用于多于三个模数的卷积 */
+
 /* 原根 */
-const u32 global_ROOT1 = 5u;
-const u32 global_ROOT2 = 5u;
-const u32 global_ROOT3 = 3u;
+const u32 global_ROOT1 = 17u;
+const u32 global_ROOT2 = 21u;
+const u32 global_ROOT3 = 7u;
+const u32 global_ROOT4 = 11u;
+const u32 global_ROOT5 = 11u;
 
 /* 原根关于对应模数的逆 */
-const u64 global_root_inv1 = 1491592196585108276ull;
-const u64 global_root_inv2 = 1167333023414432564ull;
-const u64 global_root_inv3 = 1393113484733273430ull;
+const u64 global_root_inv1 = 312933944695964612ull;
+const u64 global_root_inv2 = 649805089092028709ull;
+const u64 global_root_inv3 = 226788409806871406ull;
+const u64 global_root_inv4 = 529684728900961746ull;
+const u64 global_root_inv5 = 445242235887764946ull;
 
 /* 模数 */
-const u64 global_mod1 = 2485986994308513793ull;
-const u64 global_mod2 = 1945555039024054273ull;
-const u64 global_mod3 = 4179340454199820289ull;
+const u64 global_mod1 = 1773292353277132801ull;
+const u64 global_mod2 = 1705738358866575361ull;
+const u64 global_mod3 = 1587518868648099841ull;
+const u64 global_mod4 = 1165306403582115841ull;
+const u64 global_mod5 = 979532918953082881ull;
 
 /* R^2 mod 模数 */
-const u64 global_r21 = 1974795801822054070ull;
-const u64 global_r22 = 269548777697434221ull;
-const u64 global_r23 = 1878466934230121386ull;
+const u64 global_r21 = 403961448861794246ull;
+const u64 global_r22 = 1012049502797302252ull;
+const u64 global_r23 = 1389635172680644863ull;
+const u64 global_r24 = 198238882728076330ull;
+const u64 global_r25 = 379989924421561998ull;
 
 /* 模数的平方 */
-const u64 global_mod21 = 4971973988617027586ull;
-const u64 global_mod22 = 3891110078048108546ull;
-const u64 global_mod23 = 8358680908399640578ull;
+const u64 global_mod21 = 3546584706554265602ull;
+const u64 global_mod22 = 3411476717733150722ull;
+const u64 global_mod23 = 3175037737296199682ull;
+const u64 global_mod24 = 2330612807164231682ull;
+const u64 global_mod25 = 1959065837906165762ull;
 
 /* mont64(ROOT) */
-const mont64 global_mont_ROOT1 = 252201579132747739ull;
-const mont64 global_mont_ROOT2 = 792633534417207249ull;
-const mont64 global_mont_ROOT3 = 1008806316530991091ull;
+const mont64 global_mont_ROOT1 = 1495195076287004496ull;
+const mont64 global_mont_ROOT2 = 179018085187976989ull;
+const mont64 global_mont_ROOT3 = 538180155470774191ull;
+const mont64 global_mont_ROOT4 = 150870587516911442ull;
+const mont64 global_mont_ROOT5 = 150870587516911409ull;
 
 /* ROOTinv = ROOT^-1 % mod */
 /* mont64(ROOTinv)         */
-const mont64 global_mont_ROOT_inv1 = 208967022709991013ull;
-const mont64 global_mont_ROOT_inv2 = 965571760108234341ull;
-const mont64 global_mont_ROOT_inv3 = 3362687721769970346ull;
+const mont64 global_mont_ROOT_inv1 = 1398036537267114707ull;
+const mont64 global_mont_ROOT_inv2 = 1040867656735366778ull;
+const mont64 global_mont_ROOT_inv3 = 1501307104352721773ull;
+const mont64 global_mont_ROOT_inv4 = 829481167732056808ull;
+const mont64 global_mont_ROOT_inv5 = 964589156553171688ull;
 
 /* (mod_inv * mod) % R = 1         */
 /* (mod_inv_neg + mod_inv) % R = 0 */
-const u64 global_modInvNeg1 = 2485986994308513791ull;
-const u64 global_modInvNeg2 = 1945555039024054271ull;
-const u64 global_modInvNeg3 = 4179340454199820287ull;
+const u64 global_modInvNeg1 = 1773292353277132799ull;
+const u64 global_modInvNeg2 = 1705738358866575359ull;
+const u64 global_modInvNeg3 = 1587518868648099839ull;
+const u64 global_modInvNeg4 = 1165306403582115839ull;
+const u64 global_modInvNeg5 = 979532918953082879ull;
 
 /*  W_4_1 = qpow(mont64(ROOT), (mod - 1) / 4);  */
-const mont64 global_w41_1 = 1114193638674092305ull;
-const mont64 global_w41_2 = 1227753429952047858ull;
-const mont64 global_w41_3 = 2751416685589087298ull;
+const mont64 global_w41_1 = 1136597855876651040ull;
+const mont64 global_w41_2 = 1361863041939655711ull;
+const mont64 global_w41_3 = 1469816250646244281ull;
+const mont64 global_w41_4 = 124927866258958271ull;
+const mont64 global_w41_5 = 193543448927128221ull;
 
 /*  W_4_1 = qpow(mont64(ROOTinv), (mod - 1) / 4);  */
-const mont64 global_w41_inv1 = 1371793355634421488ull;
-const mont64 global_w41_inv2 = 717801609072006415ull;
-const mont64 global_w41_inv3 = 1427923768610732991ull;
+const mont64 global_w41_inv1 = 636694497400481761ull;
+const mont64 global_w41_inv2 = 343875316926919650ull;
+const mont64 global_w41_inv3 = 117702618001855560ull;
+const mont64 global_w41_inv4 = 1040378537323157570ull;
+const mont64 global_w41_inv5 = 785989470025954660ull;
+
+/*  W_3_1 = qpow(mont64(ROOT), (mod - 1) / 3), W_5_1 = qpow(mont64(ROOT), (mod - 1) / 5)  */
+const mont64 global_w31_1 = 1183309323272244526ull;
+const mont64 global_w31_2 = 1643451328308110820ull;
+const mont64 global_w31_3 = 56031329550346980ull;
+const mont64 global_w31_4 = 64236352939877027ull;
+const mont64 global_w31_5 = 209156456180347727ull;
+
+const mont64 global_w51_1 = 1673919553996418078ull;
+const mont64 global_w51_2 = 1385699187479512550ull;
+const mont64 global_w51_3 = 1506877581976415865ull;
+const mont64 global_w51_4 = 710623552931896297ull;
+const mont64 global_w51_5 = 814333466705041612ull;
+
+/*  W_3_1 = qpow(mont64(ROOTinv), (mod - 1) / 3), W_5_1 = qpow(mont64(ROOTinv), (mod - 1) / 5)  */
+const mont64 global_w31_inv1 = 1649454842343797470ull;
+const mont64 global_w31_inv2 = 378664904381241896ull;
+const mont64 global_w31_inv3 = 547451020517299496ull;
+const mont64 global_w31_inv4 = 133922030664424813ull;
+const mont64 global_w31_inv5 = 934757849171758277ull;
+
+const mont64 global_w51_inv1 = 1388307460589532820ull;
+const mont64 global_w51_inv2 = 1366793508021462728ull;
+const mont64 global_w51_inv3 = 369473750254507010ull;
+const mont64 global_w51_inv4 = 400681818025195047ull;
+const mont64 global_w51_inv5 = 759625541057406124ull;
 
 /*
  mont64 w1 = qpow(mont64(ROOT), (mod() - 1) / 8);
  mont64 w2 = qpow(w1, 2);
  mont64 w3 = qpow(w1, 3);
 */
-const mont64 global_w1_1 = 1397546744561501820ull;
-const mont64 global_w2_1 = 1114193638674092305ull;
-const mont64 global_w3_1 = 1540210943987252404ull;
+const mont64 global_w1_1 = 594011686274983657ull;
+const mont64 global_w2_1 = 1136597855876651040ull;
+const mont64 global_w3_1 = 325630615940470503ull;
 
-const mont64 global_w1_2 = 352122307744000116ull;
-const mont64 global_w2_2 = 1227753429952047858ull;
-const mont64 global_w3_2 = 1132446406557179953ull;
+const mont64 global_w1_2 = 215317199866117572ull;
+const mont64 global_w2_2 = 1361863041939655711ull;
+const mont64 global_w3_2 = 241931935251813759ull;
 
-const mont64 global_w1_3 = 457531513967587773ull;
-const mont64 global_w2_3 = 2751416685589087298ull;
-const mont64 global_w3_3 = 2098898615074297118ull;
+const mont64 global_w1_3 = 1249567906537179835ull;
+const mont64 global_w2_3 = 1469816250646244281ull;
+const mont64 global_w3_3 = 895068596140936687ull;
+
+const mont64 global_w1_4 = 1117040521128644292ull;
+const mont64 global_w2_4 = 124927866258958271ull;
+const mont64 global_w3_4 = 1018605033229891251ull;
+
+const mont64 global_w1_5 = 478540707895929434ull;
+const mont64 global_w2_5 = 193543448927128221ull;
+const mont64 global_w3_5 = 335277179230337605ull;
 
 /*
  mont64 w1 = qpow(mont64(ROOTinv), (mod() - 1) / 8);
  mont64 w2 = qpow(w1, 2);
  mont64 w3 = qpow(w1, 3);
 */
-const mont64 global_w1_inv1 = 945776050321261389ull;
-const mont64 global_w2_inv1 = 1371793355634421488ull;
-const mont64 global_w3_inv1 = 1088440249747011973ull;
+const mont64 global_w1_inv1 = 1447661737336662298ull;
+const mont64 global_w2_inv1 = 636694497400481761ull;
+const mont64 global_w3_inv1 = 1179280667002149144ull;
+
+const mont64 global_w1_inv2 = 1463806423614761602ull;
+const mont64 global_w2_inv2 = 343875316926919650ull;
+const mont64 global_w3_inv2 = 1490421159000457789ull;
+
+const mont64 global_w1_inv3 = 692450272507163154ull;
+const mont64 global_w2_inv3 = 117702618001855560ull;
+const mont64 global_w3_inv3 = 337950962110920006ull;
 
-const mont64 global_w1_inv2 = 813108632466874320ull;
-const mont64 global_w2_inv2 = 717801609072006415ull;
-const mont64 global_w3_inv2 = 1593432731280054157ull;
+const mont64 global_w1_inv4 = 146701370352224590ull;
+const mont64 global_w2_inv4 = 1040378537323157570ull;
+const mont64 global_w3_inv4 = 48265882453471549ull;
 
-const mont64 global_w1_inv3 = 2080441839125523171ull;
-const mont64 global_w2_inv3 = 1427923768610732991ull;
-const mont64 global_w3_inv3 = 3721808940232232516ull;
+const mont64 global_w1_inv5 = 644255739722745276ull;
+const mont64 global_w2_inv5 = 785989470025954660ull;
+const mont64 global_w3_inv5 = 500992211057153447ull;
 
 /* mont64(1) */
-const mont64 global_one1 = 1044835113549955065ull;
-const mont64 global_one2 = 936748722493063159ull;
-const mont64 global_one3 = 1729382256910270460ull;
\ No newline at end of file
+const mont64 global_one1 = 713820540938223606ull;
+const mont64 global_one2 = 1389360485043798006ull;
+const mont64 global_one3 = 984036518580453365ull;
+const mont64 global_one4 = 967148019977814001ull;
+const mont64 global_one5 = 815151532554059758ull;
\ No newline at end of file
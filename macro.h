@@ -21,9 +21,15 @@
 // SOFTWARE.
 #include <stdint.h>
 #include <stddef.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
 
 #define INLINE static inline
 
+#if defined(_MSC_VER) && !defined(__clang__)
+INLINE void mul64x64to128(uint64_t a, uint64_t b, uint64_t* low, uint64_t* high) { *low = _umul128(a, b, high); }
+#else
 INLINE void mul64x64to128(uint64_t a, uint64_t b, uint64_t* low, uint64_t* high) {
     __asm__("mul %[b]"  // 执行 RDX:RAX = RAX * b（a已在RAX中）
             : "=a"(*low),
@@ -32,6 +38,7 @@ INLINE void mul64x64to128(uint64_t a, uint64_t b, uint64_t* low, uint64_t* high)
             :                     // 无额外寄存器被修改
     );
 }
+#endif
 
 typedef unsigned long long u64;
 typedef unsigned long long mont64;
@@ -22,487 +22,3311 @@
 
 #include <time.h>
 #include "core.h"
+#include "task.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#define ALIGNED_MALLOC(_ptr, _type, _len)                                                             \
+    do {                                                                                              \
+        size_t elem_size__ = sizeof(_type);                                                           \
+        size_t total_size__ = (_len) * elem_size__;                                                   \
+        (_ptr) = (total_size__ == 0) ? NULL : (_type*)_aligned_malloc(total_size__, CACHE_LINE_SIZE); \
+    } while (0)
+
+#define ALIGNED_FREE(_ptr)       \
+    do {                         \
+        if ((_ptr) != NULL) {    \
+            _aligned_free(_ptr); \
+            (_ptr) = NULL;       \
+        }                        \
+    } while (0)
+
+/*
+ * 可选的分阶段统计, 编译时定义 NTT_STATS=1 启用; 未启用时下列 NTT_STATS_* 宏全部展开为空.
+ * abs_mul64 / abs_sqr64 及多线程, 计划, 工作区版本每次调用结束时, 把本次调用的统计交给
+ * ntt_stats_set_callback 设置的回调. 时间为墙钟毫秒, 同一阶段多次进入时累加.
+ * 融合路径中第三个模数的逆变换与 crt3 + 进位交错进行, 合计记入 NTT_PHASE_CONV3.
+ * 多线程时三个卷积并行, 各自记录本任务的时间 (含该模数的输入转换), 互有重叠.
+ */
+#ifndef NTT_STATS
+#define NTT_STATS 0
+#endif
+
+#if NTT_STATS
+typedef enum {
+    NTT_PHASE_LOAD,  // 输入转为 Montgomery 形式并补零
+    NTT_PHASE_TABLE, // 取得 twiddle 表 (首次使用时生成)
+    NTT_PHASE_CONV1,
+    NTT_PHASE_CONV2,
+    NTT_PHASE_CONV3,
+    NTT_PHASE_CRT, // crt3 + 进位
+    NTT_PHASE_COUNT
+} ntt_phase;
+
+typedef struct NttStats {
+    double phase_ms[NTT_PHASE_COUNT];
+    size_t bytes_allocated; // 本次调用分配的工作区字节数, 计划与工作区版本为 0
+    u64 ntt_len;
+    size_t radix;
+    double mark; // 当前阶段的开始时间
+    int phase;   // 当前阶段, -1 为不在任何阶段
+} ntt_stats;
+
+typedef void (*ntt_stats_callback)(const ntt_stats* stats, void* ctx);
+
+static ntt_stats_callback ntt_stats_cb = NULL;
+static void* ntt_stats_ctx = NULL;
+
+/* cb 为 NULL 时关闭. 应在发起乘法之前设置, 回调可能在多个调用线程中同时执行 */
+void ntt_stats_set_callback(ntt_stats_callback cb, void* ctx) {
+    ntt_stats_cb = cb;
+    ntt_stats_ctx = ctx;
+}
+
+INLINE double ntt_stats_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+INLINE void ntt_stats_begin(ntt_stats* st, u64 ntt_len, size_t radix) {
+    memset(st, 0, sizeof(*st));
+    st->ntt_len = ntt_len;
+    st->radix = radix;
+    st->phase = -1;
+}
+
+/* 结束当前阶段并进入 phase (-1 为只结束) */
+INLINE void ntt_stats_phase(ntt_stats* st, int phase) {
+    double now = ntt_stats_now();
+    if (st->phase >= 0) {
+        st->phase_ms[st->phase] += now - st->mark;
+    }
+    st->phase = phase;
+    st->mark = now;
+}
+
+INLINE void ntt_stats_end(ntt_stats* st) {
+    ntt_stats_phase(st, -1);
+    if (ntt_stats_cb != NULL) {
+        ntt_stats_cb(st, ntt_stats_ctx);
+    }
+}
+
+#define NTT_STATS_BEGIN(_st, _ntt_len, _radix) \
+    ntt_stats _st;                             \
+    ntt_stats_begin(&_st, _ntt_len, _radix)
+#define NTT_STATS_PHASE(_st, _phase) ntt_stats_phase(&_st, _phase)
+#define NTT_STATS_ALLOC(_st, _bytes) ((_st).bytes_allocated += (_bytes))
+#define NTT_STATS_ADD(_st, _phase, _ms) ((_st).phase_ms[_phase] += (_ms))
+#define NTT_STATS_NOW() ntt_stats_now()
+#define NTT_STATS_END(_st) ntt_stats_end(&_st)
+#else
+#define NTT_STATS_BEGIN(_st, _ntt_len, _radix) ((void)0)
+#define NTT_STATS_PHASE(_st, _phase) ((void)0)
+#define NTT_STATS_ALLOC(_st, _bytes) ((void)0)
+#define NTT_STATS_ADD(_st, _phase, _ms) ((void)0)
+#define NTT_STATS_NOW() 0.0
+#define NTT_STATS_END(_st) ((void)0)
+#endif
+
+/*
+ * 大层 radix-4 循环的 twiddle 按 CONV_TWIDDLE_BLOCK 分块生成:
+ * 块内 omega = base * unit^k, k 来自小表 pw, 块间 base 乘 unit^CONV_TWIDDLE_BLOCK 跳跃.
+ * 每个 omega 只依赖 base, 没有逐元素的乘法链; mulinto 的结果是规范值, 与链式相乘逐位相同.
+ */
+#define CONV_TWIDDLE_BLOCK 64
+
+#define define_conv_pass(_i)                                                                                      \
+    /* pw[k] = unit^k, 返回 unit^CONV_TWIDDLE_BLOCK */                                                                 \
+    INLINE mont64 twiddle_block_##_i(mont64 pw[], mont64 unit) {                                                  \
+        mont64 omega = g_one(_i);                                                                                 \
+        for (size_t kk = 0; kk < CONV_TWIDDLE_BLOCK; kk++) {                                                      \
+            pw[kk] = omega;                                                                                       \
+            _mont_mulinto_func(omega, unit, _i);                                                                  \
+        }                                                                                                         \
+        return omega;                                                                                             \
+    }                                                                                                             \
+    /* 一个 twiddle 块 [blk, blk_end) 的 dif244, half 时后两个 quarter 为 0 且前两个 quarter 不写回 (输入须 < 2p) */    \
+    INLINE void dif244_block_##_i(mont64* in, size_t quarter_len, size_t blk, size_t blk_end, mont64 base1,       \
+                                  mont64 base3, const mont64* pw1, const mont64* pw3, bool half) {                \
+        size_t ii = half ? _simd_dif244_half(in, quarter_len, blk, blk_end, base1, base3, pw1, pw3, _i)           \
+                         : _simd_dif244(in, quarter_len, blk, blk_end, base1, base3, pw1, pw3, _i);               \
+        for (; ii < blk_end; ii++) {                                                                              \
+            mont64 omega1 = base1, omega3 = base3;                                                                \
+            _mont_mulinto_func(omega1, pw1[ii - blk], _i);                                                        \
+            _mont_mulinto_func(omega3, pw3[ii - blk], _i);                                                        \
+            mont64 temp0 = in[ii], temp1 = in[quarter_len + ii], temp2 = 0, temp3 = 0;                            \
+            if (!half) {                                                                                          \
+                temp2 = in[quarter_len * 2 + ii], temp3 = in[quarter_len * 3 + ii];                               \
+            }                                                                                                     \
+            _dif_butterfly244(temp0, temp1, temp2, temp3, _i);                                                    \
+            if (!half) {                                                                                          \
+                in[ii] = temp0, in[quarter_len + ii] = temp1;                                                     \
+            }                                                                                                     \
+            _mont_mul_func(in[quarter_len * 2 + ii], temp2, omega1, _i);                                          \
+            _mont_mul_func(in[quarter_len * 3 + ii], temp3, omega3, _i);                                          \
+        }                                                                                                         \
+    }                                                                                                             \
+    INLINE void idit244_block_##_i(mont64* out, size_t quarter_len, size_t blk, size_t blk_end, mont64 base1,     \
+                                   mont64 base3, const mont64* pw1, const mont64* pw3, mont64 inv_len, bool norm) { \
+        size_t ii = _simd_idit244(out, quarter_len, blk, blk_end, base1, base3, pw1, pw3, inv_len, norm, _i);     \
+        for (; ii < blk_end; ii++) {                                                                              \
+            mont64 omega1 = base1, omega3 = base3;                                                                \
+            _mont_mulinto_func(omega1, pw1[ii - blk], _i);                                                        \
+            _mont_mulinto_func(omega3, pw3[ii - blk], _i);                                                        \
+            mont64 temp0 = out[ii], temp1 = out[quarter_len + ii], temp2, temp3;                                  \
+            if (norm) {                                                                                           \
+                _mont_mul_func(temp0, temp0, inv_len, _i);                                                        \
+                _mont_mul_func(temp1, temp1, inv_len, _i);                                                        \
+            }                                                                                                     \
+            _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                                         \
+            _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                                         \
+            _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                                                   \
+            out[ii] = temp0, out[quarter_len + ii] = temp1;                                                       \
+            out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;                                 \
+        }                                                                                                         \
+    }                                                                                                             \
+    INLINE void dif244_pass_##_i(mont64* in, size_t quarter_len, size_t begin, size_t end, mont64 unit_omega1,    \
+                                 mont64 unit_omega3) {                                                            \
+        _Alignas(64) mont64 pw1[CONV_TWIDDLE_BLOCK];                                                              \
+        _Alignas(64) mont64 pw3[CONV_TWIDDLE_BLOCK];                                                              \
+        mont64 jump1 = twiddle_block_##_i(pw1, unit_omega1), jump3 = twiddle_block_##_i(pw3, unit_omega3);        \
+        mont64 base1 = _mont_qpow_func_name(_i)(unit_omega1, begin);                                              \
+        mont64 base3 = _mont_qpow_func_name(_i)(unit_omega3, begin);                                              \
+        for (size_t blk = begin; blk < end; blk += CONV_TWIDDLE_BLOCK) {                                          \
+            size_t blk_end = (end - blk < CONV_TWIDDLE_BLOCK) ? end : blk + CONV_TWIDDLE_BLOCK;                   \
+            dif244_block_##_i(in, quarter_len, blk, blk_end, base1, base3, pw1, pw3, false);                      \
+            _mont_mulinto_func(base1, jump1, _i);                                                                 \
+            _mont_mulinto_func(base3, jump3, _i);                                                                 \
+        }                                                                                                         \
+    }                                                                                                             \
+    /* in 的后两个 quarter 为 0 时的 dif244_pass, 只处理 [0, end); 前两个 quarter 不变 (输入须 < 2p) */             \
+    INLINE void dif244_half_pass_##_i(mont64* in, size_t quarter_len, size_t end, mont64 unit_omega1,             \
+                                      mont64 unit_omega3) {                                                       \
+        _Alignas(64) mont64 pw1[CONV_TWIDDLE_BLOCK];                                                              \
+        _Alignas(64) mont64 pw3[CONV_TWIDDLE_BLOCK];                                                              \
+        mont64 jump1 = twiddle_block_##_i(pw1, unit_omega1), jump3 = twiddle_block_##_i(pw3, unit_omega3);        \
+        mont64 base1 = g_one(_i), base3 = g_one(_i);                                                              \
+        for (size_t blk = 0; blk < end; blk += CONV_TWIDDLE_BLOCK) {                                              \
+            size_t blk_end = (end - blk < CONV_TWIDDLE_BLOCK) ? end : blk + CONV_TWIDDLE_BLOCK;                   \
+            dif244_block_##_i(in, quarter_len, blk, blk_end, base1, base3, pw1, pw3, true);                       \
+            _mont_mulinto_func(base1, jump1, _i);                                                                 \
+            _mont_mulinto_func(base3, jump3, _i);                                                                 \
+        }                                                                                                         \
+    }                                                                                                             \
+    /*                                                                                                            \
+     * 长变换的顶层正变换, in 只有前 nz 项可能非零. nz <= ntt_len / 2 时后两个 quarter 不读,                             \
+     * ii >= nz 的位置输出为 0 (已在原处). 返回前半子问题的 nz, 后两个 quarter 子问题为 min(返回值, quarter_len)      \
+     */                                                                                                           \
+    INLINE size_t dif244_top_##_i(mont64* in, size_t ntt_len, size_t nz) {                                        \
+        const size_t quarter_len = ntt_len / 4;                                                                   \
+        const ntt_level* level = get_ntt_level_func(_i);                                                          \
+        const size_t lg = log2_64(ntt_len);                                                                       \
+        if (nz <= quarter_len * 2) {                                                                              \
+            size_t end = (nz < quarter_len) ? nz : quarter_len;                                                   \
+            dif244_half_pass_##_i(in, quarter_len, end, level->root[lg], level->root3[lg]);                       \
+            return nz;                                                                                            \
+        }                                                                                                         \
+        dif244_pass_##_i(in, quarter_len, 0, quarter_len, level->root[lg], level->root3[lg]);                     \
+        return ntt_len / 2;                                                                                       \
+    }                                                                                                             \
+    INLINE void idit244_pass_##_i(mont64* out, size_t quarter_len, size_t begin, size_t end, mont64 unit_omega1,  \
+                                  mont64 unit_omega3, mont64 inv_len, bool norm) {                                \
+        _Alignas(64) mont64 pw1[CONV_TWIDDLE_BLOCK];                                                              \
+        _Alignas(64) mont64 pw3[CONV_TWIDDLE_BLOCK];                                                              \
+        mont64 jump1 = twiddle_block_##_i(pw1, unit_omega1), jump3 = twiddle_block_##_i(pw3, unit_omega3);        \
+        mont64 base1 = _mont_qpow_func_name(_i)(unit_omega1, begin);                                              \
+        mont64 base3 = _mont_qpow_func_name(_i)(unit_omega3, begin);                                              \
+        if (norm) {                                                                                               \
+            _mont_mulinto_func(base1, inv_len, _i);                                                               \
+            _mont_mulinto_func(base3, inv_len, _i);                                                               \
+        }                                                                                                         \
+        for (size_t blk = begin; blk < end; blk += CONV_TWIDDLE_BLOCK) {                                          \
+            size_t blk_end = (end - blk < CONV_TWIDDLE_BLOCK) ? end : blk + CONV_TWIDDLE_BLOCK;                   \
+            idit244_block_##_i(out, quarter_len, blk, blk_end, base1, base3, pw1, pw3, inv_len, norm);            \
+            _mont_mulinto_func(base1, jump1, _i);                                                                 \
+            _mont_mulinto_func(base3, jump3, _i);                                                                 \
+        }                                                                                                         \
+    }
+
+define_conv_pass(1) define_conv_pass(2) define_conv_pass(3) define_conv_pass(4) define_conv_pass(5)
+
+/*
+ * Bailey 四步法: 长度 N >= ntt_four_step_threshold 的循环卷积把数组看作 N1 行 N2 列的矩阵 (行连续, n = n1 * N2 + n2).
+ * 每 FOUR_STEP_COL_BLOCK 列拷到连续的缓冲区做长 N1 的 dif, 第 j 个输出 (频率 bitrev(j)) 乘 w_N^(n2 * bitrev(j))
+ * 后写回第 j 行; 然后逐行做长 N2 的 dif, 逐点相乘后立即 idit; 最后按列乘 w_N^(-n2 * bitrev(j)) 再 idit.
+ * 旋转因子每行保存一个当前列的幂, 每过一列乘一次 w_N^bitrev(j). 一块的每行读写 FOUR_STEP_COL_BLOCK 个字
+ * (整数条缓存行), 行距为 2 的幂也不会在块内把同一行读两遍.
+ * 列和行都在 L2 内完成, 每个数组只被整体读写约三遍, 不像递归那样每层一遍. 输出与 conv_rec 相同 (自然顺序).
+ * N1 <= 2^FOUR_STEP_COL_LOG 且 N2 <= long_threshold, 超出时仍先用 dif244 递归.
+ * 缓冲区为 (FOUR_STEP_COL_BLOCK + 2) * N1 个字, 每次 conv_four_step 从堆上分配一次, 分配失败时退回递归.
+ * 四步法多了列的转置和旋转因子乘法, 只在数组远超末级缓存时划算. 在 300 MiB L3 的机器上直到 2^26 仍慢约 12%,
+ * 默认从 2^27 (每个数组 1 GiB) 开始使用; 缓存较小的机器可用 ntt_four_step_tune 测出更低的阈值.
+ */
+size_t ntt_four_step_threshold = (size_t)1 << 27;
+#define FOUR_STEP_COL_LOG 10
+#define FOUR_STEP_COL_BLOCK 32 // 列变换每次拷贝的列数, 32 列为四条缓存行
+
+/* 只按长度返回四步法的列长 log2, 不适用时返回 0 */
+INLINE size_t four_step_split(size_t ntt_len) {
+    if (ntt_len <= long_threshold) {
+        return 0;
+    }
+    const size_t lg = log2_64(ntt_len), row_max = log2_64(long_threshold);
+    size_t lg1 = (lg / 2 < FOUR_STEP_COL_LOG) ? lg / 2 : FOUR_STEP_COL_LOG;
+    if (lg - lg1 > row_max) {
+        lg1 = lg - row_max;
+    }
+    return (lg1 <= FOUR_STEP_COL_LOG) ? lg1 : 0;
+}
+
+/* 返回列长的 log2, 长度低于 ntt_four_step_threshold 或不适用四步法时返回 0 */
+INLINE size_t four_step_col_log(size_t ntt_len) {
+    return (ntt_len < ntt_four_step_threshold) ? 0 : four_step_split(ntt_len);
+}
+
+#define define_four_step(_i)                                                                                      \
+    /* tw[j] = b^bitrev(j), j < 2^lg: tw[2^t + j] = tw[j] * b^(2^(lg - 1 - t)) */                                 \
+    static void four_step_twiddle_##_i(mont64* tw, mont64 b, size_t lg) {                                         \
+        mont64 pw[NTT_LEVEL_MAX];                                                                                 \
+        pw[0] = b;                                                                                                \
+        for (size_t ss = 1; ss < lg; ss++) {                                                                      \
+            pw[ss] = pw[ss - 1];                                                                                  \
+            _mont_mulinto_func(pw[ss], pw[ss - 1], _i);                                                           \
+        }                                                                                                         \
+        tw[0] = g_one(_i);                                                                                        \
+        for (size_t tt = 0; tt < lg; tt++) {                                                                      \
+            const size_t half = 1ull << tt;                                                                       \
+            const mont64 mul = pw[lg - 1 - tt];                                                                   \
+            size_t ii = _simd_mulc(tw, tw + half, mul, half, _i);                                                 \
+            for (; ii < half; ii++) {                                                                             \
+                tw[half + ii] = tw[ii];                                                                           \
+                _mont_mulinto_func(tw[half + ii], mul, _i);                                                       \
+            }                                                                                                     \
+        }                                                                                                         \
+    }                                                                                                             \
+    /*                                                                                                            \
+     * 四步法第 [c_begin, c_end) 列的列变换. 正变换: dif 后乘 root^(n2 * bitrev(j)), 只有前 nz 项可能非零;        \
+     * 逆变换 (inverse): 先乘 root^(n2 * bitrev(j)) (root 为逆元) 再 idit. 输入须 < 2p.                           \
+     * ws 为 ws_len (>= 3 * N1) 个字: 前 2 * N1 个为每行当前列的旋转因子与每过一列的乘数,                         \
+     * 其余每次拷贝 ws_len / N1 - 2 列                                                                            \
+     */                                                                                                           \
+    static void four_step_cols_##_i(mont64* in, mont64* ws, size_t ws_len, ntt_short* table, size_t lg1,          \
+                                    size_t lg2, size_t c_begin, size_t c_end, size_t nz, mont64 root,             \
+                                    bool inverse) {                                                               \
+        const size_t n1 = 1ull << lg1, n2 = 1ull << lg2;                                                          \
+        const size_t block = ws_len / n1 - 2, rows = (nz + n2 - 1) / n2;                                          \
+        mont64 *tw = ws, *step = ws + n1, *col = ws + n1 * 2;                                                     \
+        four_step_twiddle_##_i(tw, _mont_qpow_func_name(_i)(root, c_begin), lg1);                                 \
+        four_step_twiddle_##_i(step, root, lg1);                                                                  \
+        for (size_t c0 = c_begin; c0 < c_end; c0 += block) {                                                      \
+            const size_t cols = (c_end - c0 < block) ? c_end - c0 : block;                                        \
+            for (size_t rr = 0; rr < rows; rr++) {                                                                \
+                const mont64* src = in + rr * n2 + c0;                                                            \
+                for (size_t cc = 0; cc < cols; cc++) {                                                            \
+                    col[cc * n1 + rr] = src[cc];                                                                  \
+                }                                                                                                 \
+            }                                                                                                     \
+            for (size_t cc = 0; cc < cols; cc++) {                                                                \
+                mont64* cur = col + cc * n1;                                                                      \
+                if (inverse) {                                                                                    \
+                    pointwise_mul_func(cur, cur, tw, n1, false, g_one(_i), _i);                                   \
+                    idit_func(cur, table, n1, _i);                                                                \
+                } else {                                                                                          \
+                    memset(cur + rows, 0, (n1 - rows) * sizeof(mont64));                                          \
+                    dif_nz_func(cur, table, n1, rows, _i);                                                        \
+                    pointwise_mul_func(cur, cur, tw, n1, false, g_one(_i), _i);                                   \
+                }                                                                                                 \
+                pointwise_mul_func(tw, tw, step, n1, false, g_one(_i), _i);                                       \
+            }                                                                                                     \
+            for (size_t rr = 0; rr < n1; rr++) {                                                                  \
+                mont64* dst = in + rr * n2 + c0;                                                                  \
+                for (size_t cc = 0; cc < cols; cc++) {                                                            \
+                    dst[cc] = col[cc * n1 + rr];                                                                  \
+                }                                                                                                 \
+            }                                                                                                     \
+        }                                                                                                         \
+    }                                                                                                             \
+    /* 四步法第 [r_begin, r_end) 行: 两方做 dif, 逐点相乘后 idit 到 out; in2 == NULL 时为平方 */                  \
+    static void four_step_rows_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t lg2,          \
+                                    size_t r_begin, size_t r_end, bool norm, mont64 inv_len) {                    \
+        const size_t n2 = 1ull << lg2;                                                                            \
+        for (size_t rr = r_begin; rr < r_end; rr++) {                                                             \
+            mont64 *row1 = in1 + rr * n2, *row2 = row1, *dst = out + rr * n2;                                     \
+            dif_nz_func(row1, table, n2, n2, _i);                                                                 \
+            if (in2 != NULL) {                                                                                    \
+                row2 = in2 + rr * n2;                                                                             \
+                dif_nz_func(row2, table, n2, n2, _i);                                                             \
+            }                                                                                                     \
+            pointwise_mul_func(dst, row1, row2, n2, norm, inv_len, _i);                                           \
+            idit_func(dst, table, n2, _i);                                                                        \
+        }                                                                                                         \
+    }                                                                                                             \
+    /* 四步法卷积, in2 == NULL 时为平方. 与 conv_rec_nz / conv_sqr_nz 的约定相同; 分配失败返回 false */           \
+    bool conv_four_step_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len,             \
+                             size_t lg1, size_t nz1, size_t nz2, bool norm) {                                     \
+        const ntt_level* level = get_ntt_level_func(_i);                                                          \
+        const size_t lg = log2_64(ntt_len), lg2 = lg - lg1;                                                       \
+        const size_t n1 = 1ull << lg1, n2 = 1ull << lg2, ws_len = (FOUR_STEP_COL_BLOCK + 2) * n1;                 \
+        mont64* ws;                                                                                               \
+        ALIGNED_MALLOC(ws, mont64, ws_len);                                                                       \
+        if (ws == NULL) {                                                                                         \
+            return false;                                                                                         \
+        }                                                                                                         \
+        four_step_cols_##_i(in1, ws, ws_len, table, lg1, lg2, 0, n2, nz1, level->root[lg], false);                \
+        if (in2 != NULL) {                                                                                        \
+            four_step_cols_##_i(in2, ws, ws_len, table, lg1, lg2, 0, n2, nz2, level->root[lg], false);            \
+        }                                                                                                         \
+        mont64 inv_len = norm ? level->inv_len[lg] : g_one(_i);                                                   \
+        four_step_rows_##_i(in1, in2, out, table, lg2, 0, n1, norm, inv_len);                                     \
+        four_step_cols_##_i(out, ws, ws_len, table, lg1, lg2, 0, n2, ntt_len, level->rootinv[lg], true);          \
+        ALIGNED_FREE(ws);                                                                                         \
+        return true;                                                                                              \
+    }
+
+define_four_step(1) define_four_step(2) define_four_step(3) define_four_step(4) define_four_step(5)
+
+/* 以下 *_nz 版本中 nz1 / nz2 为输入的非零前缀长度 (其余为 0), 只用于裁剪正变换; 不带 nz 的版本取 nz = ntt_len */
+#define _nz_quarter(nz, quarter_len) (((nz) < (quarter_len)) ? (nz) : (quarter_len))
+
+#define define_conv_rec(_i)                                                                                             \
+    void conv_rec_nz_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, size_t nz1,          \
+                          size_t nz2, bool norm) {                                                                      \
+        assert(in1 != NULL && in2 != NULL && out != NULL && table != NULL);                                             \
+        assert(in1 != in2);                                                                                             \
+        size_t lg1 = four_step_col_log(ntt_len);                                                                        \
+        if (lg1 != 0 && conv_four_step_##_i(in1, in2, out, table, ntt_len, lg1, nz1, nz2, norm)) {                      \
+            return;                                                                                                     \
+        }                                                                                                               \
+        if (ntt_len <= long_threshold) {                                                                                \
+            dif_nz_func(in1, table, ntt_len, nz1, _i);                                                                  \
+            dif_nz_func(in2, table, ntt_len, nz2, _i);                                                                  \
+            mont64 inv_len = norm ? get_ntt_level_func(_i)->inv_len[log2_64(ntt_len)] : g_one(_i);                      \
+            pointwise_mul_func(out, in1, in2, ntt_len, norm, inv_len, _i);                                              \
+            idit_func(out, table, ntt_len, _i);                                                                         \
+            return;                                                                                                     \
+        }                                                                                                               \
+        const size_t quarter_len = ntt_len / 4;                                                                         \
+        const ntt_level* level = get_ntt_level_func(_i);                                                                \
+        const size_t lg = log2_64(ntt_len);                                                                             \
+        nz1 = dif244_top_##_i(in1, ntt_len, nz1);                                                                       \
+        nz2 = dif244_top_##_i(in2, ntt_len, nz2);                                                                       \
+        conv_rec_nz_##_i(in1, in2, out, table, ntt_len / 2, nz1, nz2, false);                                           \
+        nz1 = _nz_quarter(nz1, quarter_len), nz2 = _nz_quarter(nz2, quarter_len);                                       \
+        conv_rec_nz_##_i(in1 + quarter_len * 2, in2 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4, nz1,  \
+                         nz2, false);                                                                                   \
+        conv_rec_nz_##_i(in1 + quarter_len * 3, in2 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4, nz1,  \
+                         nz2, false);                                                                                   \
+        mont64 inv_len = norm ? level->inv_len[lg] : g_one(_i);                                                         \
+        idit244_pass_##_i(out, quarter_len, 0, quarter_len, level->rootinv[lg], level->rootinv3[lg], inv_len, norm);    \
+    }                                                                                                                   \
+    void conv_rec_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, bool norm) {            \
+        conv_rec_nz_##_i(in1, in2, out, table, ntt_len, ntt_len, ntt_len, norm);                                        \
+    }
+
+#define define_conv_single(_i)                                                                                          \
+    void conv_single_nz_##_i(const mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, size_t nz2, \
+                             bool norm) {                                                                               \
+        assert(in1 != NULL && in2 != NULL && out != NULL && table != NULL);                                             \
+        assert(in1 != in2);                                                                                             \
+        if (ntt_len <= long_threshold) {                                                                                \
+            dif_nz_func(in2, table, ntt_len, nz2, _i);                                                                  \
+            mont64 inv_len = norm ? get_ntt_level_func(_i)->inv_len[log2_64(ntt_len)] : g_one(_i);                      \
+            pointwise_mul_func(out, in1, in2, ntt_len, norm, inv_len, _i);                                              \
+            idit_func(out, table, ntt_len, _i);                                                                         \
+            return;                                                                                                     \
+        }                                                                                                               \
+        const size_t quarter_len = ntt_len / 4;                                                                         \
+        const ntt_level* level = get_ntt_level_func(_i);                                                                \
+        const size_t lg = log2_64(ntt_len);                                                                             \
+        nz2 = dif244_top_##_i(in2, ntt_len, nz2);                                                                       \
+        conv_single_nz_##_i(in1, in2, out, table, ntt_len / 2, nz2, false);                                             \
+        nz2 = _nz_quarter(nz2, quarter_len);                                                                            \
+        conv_single_nz_##_i(in1 + quarter_len * 2, in2 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4,    \
+                            nz2, false);                                                                                \
+        conv_single_nz_##_i(in1 + quarter_len * 3, in2 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4,    \
+                            nz2, false);                                                                                \
+        mont64 inv_len = norm ? level->inv_len[lg] : g_one(_i);                                                         \
+        idit244_pass_##_i(out, quarter_len, 0, quarter_len, level->rootinv[lg], level->rootinv3[lg], inv_len, norm);    \
+    }                                                                                                                   \
+    void conv_single_##_i(const mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, bool norm) {   \
+        conv_single_nz_##_i(in1, in2, out, table, ntt_len, ntt_len, norm);                                              \
+    }
+
+/* conv_rec 的正变换部分, 输出顺序与 conv_single 的 in1 一致 */
+#define define_ntt_rec(_i)                                                                                              \
+    void ntt_rec_nz_##_i(mont64* in, ntt_short* table, size_t ntt_len, size_t nz) {                                     \
+        assert(in != NULL && table != NULL);                                                                            \
+        if (ntt_len <= long_threshold) {                                                                                \
+            dif_nz_func(in, table, ntt_len, nz, _i);                                                                    \
+            return;                                                                                                     \
+        }                                                                                                               \
+        const size_t quarter_len = ntt_len / 4;                                                                         \
+        nz = dif244_top_##_i(in, ntt_len, nz);                                                                          \
+        ntt_rec_nz_##_i(in, table, ntt_len / 2, nz);                                                                    \
+        nz = _nz_quarter(nz, quarter_len);                                                                              \
+        ntt_rec_nz_##_i(in + quarter_len * 2, table, ntt_len / 4, nz);                                                  \
+        ntt_rec_nz_##_i(in + quarter_len * 3, table, ntt_len / 4, nz);                                                  \
+    }
+
+#define define_conv_sqr(_i)                                                                                             \
+    void conv_sqr_nz_##_i(mont64* in1, mont64* out, ntt_short* table, size_t ntt_len, size_t nz1, bool norm) {          \
+        assert(in1 != NULL && out != NULL && table != NULL);                                                            \
+        size_t lg1 = four_step_col_log(ntt_len);                                                                        \
+        if (lg1 != 0 && conv_four_step_##_i(in1, NULL, out, table, ntt_len, lg1, nz1, 0, norm)) {                       \
+            return;                                                                                                     \
+        }                                                                                                               \
+        if (ntt_len <= long_threshold) {                                                                                \
+            dif_nz_func(in1, table, ntt_len, nz1, _i);                                                                  \
+            mont64 inv_len = norm ? get_ntt_level_func(_i)->inv_len[log2_64(ntt_len)] : g_one(_i);                      \
+            pointwise_mul_func(out, in1, in1, ntt_len, norm, inv_len, _i);                                              \
+            idit_func(out, table, ntt_len, _i);                                                                         \
+            return;                                                                                                     \
+        }                                                                                                               \
+        const size_t quarter_len = ntt_len / 4;                                                                         \
+        const ntt_level* level = get_ntt_level_func(_i);                                                                \
+        const size_t lg = log2_64(ntt_len);                                                                             \
+        nz1 = dif244_top_##_i(in1, ntt_len, nz1);                                                                       \
+        conv_sqr_nz_##_i(in1, out, table, ntt_len / 2, nz1, false);                                                     \
+        nz1 = _nz_quarter(nz1, quarter_len);                                                                            \
+        conv_sqr_nz_##_i(in1 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4, nz1, false);                 \
+        conv_sqr_nz_##_i(in1 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4, nz1, false);                 \
+        mont64 inv_len = norm ? level->inv_len[lg] : g_one(_i);                                                         \
+        idit244_pass_##_i(out, quarter_len, 0, quarter_len, level->rootinv[lg], level->rootinv3[lg], inv_len, norm);    \
+    }                                                                                                                   \
+    void conv_sqr_##_i(mont64* in1, mont64* out, ntt_short* table, size_t ntt_len, bool norm) {                         \
+        conv_sqr_nz_##_i(in1, out, table, ntt_len, ntt_len, norm);                                                      \
+    }
+
+define_conv_rec(1) define_conv_rec(2) define_conv_rec(3) define_conv_rec(4) define_conv_rec(5)
+define_conv_single(1) define_conv_single(2) define_conv_single(3) define_conv_single(4) define_conv_single(5)
+define_ntt_rec(1) define_ntt_rec(2) define_ntt_rec(3) define_ntt_rec(4) define_ntt_rec(5)
+define_conv_sqr(1) define_conv_sqr(2) define_conv_sqr(3) define_conv_sqr(4) define_conv_sqr(5)
+
+#define conv_rec_func(in1, in2, out, table, ntt_len, _i) conv_rec_##_i(in1, in2, out, table, ntt_len, true)
+#define conv_sqr_func(in1, out, table, ntt_len, _i) conv_sqr_##_i(in1, out, table, ntt_len, true)
+
+/*
+ * 长度 radix * K 的循环卷积 (radix = 3, 5, K 为 2 的幂):
+ * x^(radix * K) - 1 = prod_r (x^K - w_radix^r), 顶层做一次 radix 点 DFT 并乘 unit^(r * ii) (unit = w_(radix * K)),
+ * 把每段变成长度 K 的循环卷积交给 conv_rec, 最后逆向合并.
+ */
+/* conv_head 留下的顶层逆变换: radix == 1 时为 radix-4 遍 (unit1, unit3), 否则为 radix 遍 (unit1, cs). seg == 0 表示已全部完成 */
+typedef struct ConvTail {
+    size_t radix;
+    size_t seg;
+    size_t parts; // radix == 1 时为 4, 否则为 radix, 不超过 CONV_TAIL_PARTS_MAX
+    mont64 unit1;
+    mont64 unit3;
+    mont64 scale;
+    bool norm;
+    mont64 cs[2 * NTT_RADIX_MAX];
+} conv_tail;
+
+#define CONV_TAIL_PARTS_MAX NTT_RADIX_MAX
+_Static_assert(CONV_TAIL_PARTS_MAX >= 4, "conv_tail parts of the radix-4 top pass");
+
+#define define_conv_head(_i)                                                                                      \
+    /* 只处理 [0, end): ii >= end 的各段输入全为 0 时输出也全为 0 */                                                    \
+    INLINE void dif_radix_pass_##_i(mont64* in, size_t K, size_t radix, size_t end, mont64 unit,                  \
+                                    const mont64 cs[]) {                                                          \
+        _Alignas(64) mont64 pw[CONV_TWIDDLE_BLOCK];                                                               \
+        mont64 jump = twiddle_block_##_i(pw, unit), base = g_one(_i);                                             \
+        for (size_t blk = 0; blk < end; blk += CONV_TWIDDLE_BLOCK) {                                              \
+            size_t blk_end = (end - blk < CONV_TWIDDLE_BLOCK) ? end : blk + CONV_TWIDDLE_BLOCK;                   \
+            size_t ii = _simd_dif_radix(in, K, radix, blk, blk_end, base, pw, cs, _i);                            \
+            for (; ii < blk_end; ii++) {                                                                          \
+                mont64 x[NTT_RADIX_MAX] = {0}, omega = base, w;                                                   \
+                _mont_mulinto_func(omega, pw[ii - blk], _i);                                                      \
+                for (size_t rr = 0; rr < radix; rr++) {                                                           \
+                    x[rr] = in[rr * K + ii];                                                                      \
+                }                                                                                                 \
+                dft_odd_##_i(x, cs, radix);                                                                       \
+                in[ii] = x[0], w = omega;                                                                         \
+                for (size_t rr = 1; rr < radix; rr++) {                                                           \
+                    _mont_mul_func(in[rr * K + ii], x[rr], w, _i);                                                \
+                    _mont_mulinto_func(w, omega, _i);                                                             \
+                }                                                                                                 \
+            }                                                                                                     \
+            _mont_mulinto_func(base, jump, _i);                                                                   \
+        }                                                                                                         \
+    }                                                                                                             \
+    INLINE void idit_radix_pass_##_i(mont64* out, size_t K, size_t radix, size_t begin, size_t end, mont64 unit,  \
+                                     const mont64 cs[], mont64 scale) {                                           \
+        _Alignas(64) mont64 pw[CONV_TWIDDLE_BLOCK];                                                               \
+        mont64 jump = twiddle_block_##_i(pw, unit), base = _mont_qpow_func_name(_i)(unit, begin);                 \
+        for (size_t blk = begin; blk < end; blk += CONV_TWIDDLE_BLOCK) {                                          \
+            size_t blk_end = (end - blk < CONV_TWIDDLE_BLOCK) ? end : blk + CONV_TWIDDLE_BLOCK;                   \
+            size_t ii = _simd_idit_radix(out, K, radix, blk, blk_end, base, pw, cs, scale, _i);                   \
+            for (; ii < blk_end; ii++) {                                                                          \
+                mont64 x[NTT_RADIX_MAX] = {0}, omega = base, w = scale;                                           \
+                _mont_mulinto_func(omega, pw[ii - blk], _i);                                                      \
+                for (size_t rr = 0; rr < radix; rr++) {                                                           \
+                    x[rr] = out[rr * K + ii];                                                                     \
+                    _mont_mulinto_func(x[rr], w, _i);                                                             \
+                    _mont_mulinto_func(w, omega, _i);                                                             \
+                }                                                                                                 \
+                dft_odd_##_i(x, cs, radix);                                                                       \
+                for (size_t rr = 0; rr < radix; rr++) {                                                           \
+                    out[rr * K + ii] = x[rr];                                                                     \
+                }                                                                                                 \
+            }                                                                                                     \
+            _mont_mulinto_func(base, jump, _i);                                                                   \
+        }                                                                                                         \
+    }                                                                                                             \
+    /*                                                                                                             \
+     * radix 为 1 的长变换 (ntt_len > long_threshold): lg1 != 0 时整个长度用四步法, 没有 tail;                     \
+     * 否则做 dif244 顶层与三个子卷积, 顶层逆变换的参数填入 tail. ntt_four_step_tune 按此计时                      \
+     */                                                                                                            \
+    static void conv_head244_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len,         \
+                                  size_t nz1, size_t nz2, bool norm, size_t lg1, conv_tail* tail) {                \
+        tail->radix = 1, tail->norm = norm, tail->seg = 0;                                                         \
+        if (lg1 != 0 && conv_four_step_##_i(in1, in2, out, table, ntt_len, lg1, nz1, nz2, norm)) {                 \
+            return;                                                                                                \
+        }                                                                                                          \
+        const size_t quarter_len = ntt_len / 4;                                                                    \
+        const ntt_level* level = get_ntt_level_func(_i);                                                           \
+        const size_t lg = log2_64(ntt_len);                                                                        \
+        nz1 = dif244_top_##_i(in1, ntt_len, nz1);                                                                  \
+        size_t nzq1 = _nz_quarter(nz1, quarter_len);                                                               \
+        if (in2 != NULL) {                                                                                         \
+            nz2 = dif244_top_##_i(in2, ntt_len, nz2);                                                              \
+            size_t nzq2 = _nz_quarter(nz2, quarter_len);                                                           \
+            conv_rec_nz_##_i(in1, in2, out, table, ntt_len / 2, nz1, nz2, false);                                  \
+            conv_rec_nz_##_i(in1 + quarter_len * 2, in2 + quarter_len * 2, out + quarter_len * 2, table,           \
+                             ntt_len / 4, nzq1, nzq2, false);                                                      \
+            conv_rec_nz_##_i(in1 + quarter_len * 3, in2 + quarter_len * 3, out + quarter_len * 3, table,           \
+                             ntt_len / 4, nzq1, nzq2, false);                                                      \
+        } else {                                                                                                   \
+            conv_sqr_nz_##_i(in1, out, table, ntt_len / 2, nz1, false);                                            \
+            conv_sqr_nz_##_i(in1 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4, nzq1, false);       \
+            conv_sqr_nz_##_i(in1 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4, nzq1, false);       \
+        }                                                                                                          \
+        tail->seg = quarter_len, tail->parts = 4;                                                                  \
+        tail->unit1 = level->rootinv[lg], tail->unit3 = level->rootinv3[lg];                                       \
+        tail->scale = norm ? level->inv_len[lg] : g_one(_i);                                                       \
+    }                                                                                                              \
+    /*                                                                                                             \
+     * radix 为 1, 3 或 5, in2 == NULL 时为平方; 输入须为规范值, 只有前 nz1 / nz2 项可能非零.                      \
+     * 做完除顶层逆变换以外的部分, 顶层参数填入 tail                                                               \
+     */                                                                                                            \
+    static void conv_head_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t radix,              \
+                               size_t ntt_len, size_t nz1, size_t nz2, bool norm, conv_tail* tail) {               \
+        tail->radix = radix, tail->norm = norm, tail->seg = 0;                                                     \
+        if (radix == 1 && ntt_len <= long_threshold) {                                                             \
+            if (in2 != NULL) {                                                                                     \
+                conv_rec_nz_##_i(in1, in2, out, table, ntt_len, nz1, nz2, norm);                                   \
+            } else {                                                                                               \
+                conv_sqr_nz_##_i(in1, out, table, ntt_len, nz1, norm);                                             \
+            }                                                                                                      \
+            return;                                                                                                \
+        }                                                                                                          \
+        if (radix == 1) {                                                                                          \
+            conv_head244_##_i(in1, in2, out, table, ntt_len, nz1, nz2, norm, four_step_col_log(ntt_len), tail);    \
+            return;                                                                                                \
+        }                                                                                                          \
+        assert(radix == 3 || radix == 5);                                                                         \
+        const size_t K = ntt_len / radix;                                                                         \
+        mont64 cs[2 * NTT_RADIX_MAX];                                                                             \
+        dft_odd_coef_##_i(cs, (radix == 3) ? g_w31(_i) : g_w51(_i), radix);                                       \
+        dft_odd_coef_##_i(tail->cs, (radix == 3) ? g_w31inv(_i) : g_w51inv(_i), radix);                           \
+        mont64 unit = _mont_qpow_func_name(_i)(g_mont_root(_i), (g_mod(_i) - 1) / ntt_len);                       \
+        nz1 = _nz_quarter(nz1, K), nz2 = _nz_quarter(nz2, K);                                                     \
+        dif_radix_pass_##_i(in1, K, radix, nz1, unit, cs);                                                        \
+        if (in2 != NULL) {                                                                                        \
+            dif_radix_pass_##_i(in2, K, radix, nz2, unit, cs);                                                    \
+        }                                                                                                         \
+        for (size_t rr = 0; rr < radix; rr++) {                                                                   \
+            if (in2 != NULL) {                                                                                    \
+                conv_rec_nz_##_i(in1 + rr * K, in2 + rr * K, out + rr * K, table, K, nz1, nz2, norm);             \
+            } else {                                                                                              \
+                conv_sqr_nz_##_i(in1 + rr * K, out + rr * K, table, K, nz1, norm);                                \
+            }                                                                                                     \
+        }                                                                                                         \
+        tail->seg = K, tail->parts = radix;                                                                       \
+        tail->unit1 = _mont_qpow_func_name(_i)(g_mont_rootinv(_i), (g_mod(_i) - 1) / ntt_len);                    \
+        tail->scale = g_one(_i);                                                                                  \
+        if (norm) {                                                                                               \
+            tail->scale = radix;                                                                                  \
+            _mont_tomont_func(tail->scale, _i);                                                                   \
+            tail->scale = _mont_qpow_func_name(_i)(tail->scale, g_mod(_i) - 2);                                   \
+        }                                                                                                         \
+    }                                                                                                             \
+    /* 顶层逆变换的 [begin, end) 部分, 输出在 out[rr * seg + ii] (rr < parts) */                                        \
+    INLINE void conv_tail_##_i(mont64* out, const conv_tail* tail, size_t begin, size_t end) {                    \
+        if (tail->radix == 1) {                                                                                   \
+            idit244_pass_##_i(out, tail->seg, begin, end, tail->unit1, tail->unit3, tail->scale, tail->norm);     \
+        } else {                                                                                                  \
+            idit_radix_pass_##_i(out, tail->seg, tail->radix, begin, end, tail->unit1, tail->cs, tail->scale);    \
+        }                                                                                                         \
+    }
+
+define_conv_head(1) define_conv_head(2) define_conv_head(3)
+
+/* 第三个模数由 conv_crt3_carry 直接调用 conv_head / conv_tail, 只有前两个模数需要 conv_radix */
+#define define_conv_radix(_i)                                                                                     \
+    static void conv_radix_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t radix,            \
+                                size_t ntt_len, size_t nz1, size_t nz2, bool norm) {                              \
+        conv_tail tail;                                                                                           \
+        conv_head_##_i(in1, in2, out, table, radix, ntt_len, nz1, nz2, norm, &tail);                              \
+        if (tail.seg != 0) {                                                                                      \
+            conv_tail_##_i(out, &tail, 0, tail.seg);                                                              \
+        }                                                                                                         \
+    }
+
+define_conv_radix(1) define_conv_radix(2)
+
+#define conv_radix_func(in1, in2, out, table, radix, ntt_len, nz1, nz2, _i) \
+    conv_radix_##_i(in1, in2, out, table, radix, ntt_len, nz1, nz2, true)
+#define conv_single_func(in1, in2, out, table, ntt_len, _i) conv_single_##_i(in1, in2, out, table, ntt_len, true)
+
+/*
+ * conv_rec / conv_single / conv_sqr 的并行版本.
+ * 大于 grain 的层把 radix-4 的 quarter_len 循环按 chunk 切块, 三个递归子调用作为任务 spawn.
+ * 每块的起始 omega 用 qpow 直接求出, 与串行链式乘法得到的值相同, 所以结果逐位一致.
+ */
+typedef struct ConvPar {
+    task_pool* pool;
+    size_t grain;  // ntt_len <= grain 时转为串行
+    size_t chunk;  // quarter_len 循环每块的最小长度
+} conv_par;
+
+size_t conv_task_grain = 2 * long_threshold;
+size_t conv_task_chunk = 16384;
+
+#define CONV_PAR_MAX_CHUNKS 64
+
+enum { CONV_REC = 0, CONV_SINGLE = 1, CONV_SQR = 2 };
+
+typedef struct PassTask {
+    mont64* in1;
+    mont64* in2;
+    size_t quarter_len;
+    size_t begin;
+    size_t end;
+    mont64 unit_omega1;
+    mont64 unit_omega3;
+    mont64 inv_len;
+    bool norm;
+} pass_task;
+
+typedef struct ConvTask {
+    const conv_par* par;
+    int kind;
+    mont64* in1;
+    mont64* in2;
+    mont64* out;
+    ntt_short* table;
+    size_t ntt_len;
+} conv_task;
+
+#define define_conv_pass_task(_i)                                                                                   \
+    static void dif244_task_##_i(void* arg) {                                                                       \
+        pass_task* tk = (pass_task*)arg;                                                                            \
+        if (tk->in1 != NULL) {                                                                                      \
+            dif244_pass_##_i(tk->in1, tk->quarter_len, tk->begin, tk->end, tk->unit_omega1, tk->unit_omega3);       \
+        }                                                                                                           \
+        if (tk->in2 != NULL) {                                                                                      \
+            dif244_pass_##_i(tk->in2, tk->quarter_len, tk->begin, tk->end, tk->unit_omega1, tk->unit_omega3);       \
+        }                                                                                                           \
+    }                                                                                                               \
+    static void idit244_task_##_i(void* arg) {                                                                      \
+        pass_task* tk = (pass_task*)arg;                                                                            \
+        idit244_pass_##_i(tk->in1, tk->quarter_len, tk->begin, tk->end, tk->unit_omega1, tk->unit_omega3,           \
+                          tk->inv_len, tk->norm);                                                                   \
+    }
+
+define_conv_pass_task(1) define_conv_pass_task(2) define_conv_pass_task(3) define_conv_pass_task(4) define_conv_pass_task(5)
+
+/* 把 [0, quarter_len) 切块后并行执行 func, 所有块结束后返回 */
+static void conv_par_pass(const conv_par* par, task_func func, pass_task proto) {
+    size_t chunk = par->chunk > 0 ? par->chunk : 1;
+    size_t count = (proto.quarter_len + chunk - 1) / chunk;
+    size_t max_count = (size_t)par->pool->threads * 4;
+    max_count = max_count < CONV_PAR_MAX_CHUNKS ? max_count : CONV_PAR_MAX_CHUNKS;
+    if (count > max_count) {
+        count = max_count;
+    }
+    chunk = (proto.quarter_len + count - 1) / count;
+    pass_task tasks[CONV_PAR_MAX_CHUNKS];
+    task_group group;
+    task_group_init(&group);
+    for (size_t cc = 0; cc < count; cc++) {
+        tasks[cc] = proto;
+        tasks[cc].begin = cc * chunk;
+        tasks[cc].end = (cc + 1) * chunk < proto.quarter_len ? (cc + 1) * chunk : proto.quarter_len;
+        if (cc + 1 < count) {
+            task_spawn(par->pool, &group, func, tasks + cc);
+        }
+    }
+    func(tasks + count - 1);
+    task_wait(par->pool, &group);
+}
+
+#define define_conv_par(_i)                                                                                         \
+    void conv_par_##_i(const conv_par* par, int kind, mont64* in1, mont64* in2, mont64* out, ntt_short* table,      \
+                       size_t ntt_len, size_t nz1, size_t nz2, bool norm);                                          \
+    static void conv_task_##_i(void* arg) {                                                                         \
+        conv_task* tk = (conv_task*)arg;                                                                            \
+        conv_par_##_i(tk->par, tk->kind, tk->in1, tk->in2, tk->out, tk->table, tk->ntt_len, tk->ntt_len,            \
+                      tk->ntt_len, false);                                                                          \
+    }                                                                                                               \
+    /* 串行时按 nz1 / nz2 裁剪正变换; 并行的顶层各遍按完整长度切块 */                                                    \
+    void conv_par_##_i(const conv_par* par, int kind, mont64* in1, mont64* in2, mont64* out, ntt_short* table,      \
+                       size_t ntt_len, size_t nz1, size_t nz2, bool norm) {                                         \
+        if (par == NULL || par->pool == NULL || par->pool->threads <= 1 || ntt_len <= par->grain ||                 \
+            ntt_len <= long_threshold) {                                                                            \
+            if (kind == CONV_SQR) {                                                                                 \
+                conv_sqr_nz_##_i(in1, out, table, ntt_len, nz1, norm);                                              \
+            } else if (kind == CONV_SINGLE) {                                                                       \
+                conv_single_nz_##_i(in1, in2, out, table, ntt_len, nz2, norm);                                      \
+            } else {                                                                                                \
+                conv_rec_nz_##_i(in1, in2, out, table, ntt_len, nz1, nz2, norm);                                    \
+            }                                                                                                       \
+            return;                                                                                                 \
+        }                                                                                                           \
+        const size_t quarter_len = ntt_len / 4;                                                                     \
+        pass_task proto;                                                                                            \
+        proto.quarter_len = quarter_len;                                                                            \
+        proto.in1 = (kind == CONV_SINGLE) ? NULL : in1;                                                             \
+        proto.in2 = (kind == CONV_SQR) ? NULL : in2;                                                                \
+        const ntt_level* level = get_ntt_level_func(_i);                                                            \
+        const size_t lg = log2_64(ntt_len);                                                                         \
+        proto.unit_omega1 = level->root[lg];                                                                        \
+        proto.unit_omega3 = level->root3[lg];                                                                       \
+        proto.inv_len = g_one(_i);                                                                                  \
+        proto.norm = false;                                                                                         \
+        conv_par_pass(par, dif244_task_##_i, proto);                                                                \
+        conv_task sub[3];                                                                                           \
+        const size_t offset[3] = {0, quarter_len * 2, quarter_len * 3};                                             \
+        for (int ss = 0; ss < 3; ss++) {                                                                            \
+            sub[ss].par = par;                                                                                      \
+            sub[ss].kind = kind;                                                                                    \
+            sub[ss].in1 = in1 + offset[ss];                                                                         \
+            sub[ss].in2 = (kind == CONV_SQR) ? NULL : in2 + offset[ss];                                             \
+            sub[ss].out = out + offset[ss];                                                                         \
+            sub[ss].table = table;                                                                                  \
+            sub[ss].ntt_len = (ss == 0) ? ntt_len / 2 : ntt_len / 4;                                                \
+        }                                                                                                           \
+        task_group group;                                                                                           \
+        task_group_init(&group);                                                                                    \
+        task_spawn(par->pool, &group, conv_task_##_i, sub + 2);                                                     \
+        task_spawn(par->pool, &group, conv_task_##_i, sub + 1);                                                     \
+        conv_task_##_i(sub);                                                                                        \
+        task_wait(par->pool, &group);                                                                               \
+        proto.in1 = out;                                                                                            \
+        proto.in2 = NULL;                                                                                           \
+        proto.unit_omega1 = level->rootinv[lg];                                                                     \
+        proto.unit_omega3 = level->rootinv3[lg];                                                                    \
+        proto.norm = norm;                                                                                          \
+        proto.inv_len = norm ? level->inv_len[lg] : g_one(_i);                                                      \
+        conv_par_pass(par, idit244_task_##_i, proto);                                                               \
+    }
+
+define_conv_par(1) define_conv_par(2) define_conv_par(3) define_conv_par(4) define_conv_par(5)
+
+#define conv_rec_par_func(par, in1, in2, out, table, ntt_len, nz1, nz2, _i) \
+    conv_par_##_i(par, CONV_REC, in1, in2, out, table, ntt_len, nz1, nz2, true)
+#define conv_sqr_par_func(par, in1, out, table, ntt_len, nz1, _i) \
+    conv_par_##_i(par, CONV_SQR, in1, NULL, out, table, ntt_len, nz1, nz1, true)
+#define conv_single_par_func(par, in1, in2, out, table, ntt_len, nz2, _i) \
+    conv_par_##_i(par, CONV_SINGLE, (mont64*)(in1), in2, out, table, ntt_len, ntt_len, nz2, true)
+
+
+u64 int_ceil2(u64 n) {
+    const int bits = 64;
+    n--;
+    for (int i = 1; i < bits; i *= 2) {
+        n |= (n >> i);
+    }
+    return n + 1;
+}
+
+/*
+ * 在 2^k, 3 * 2^k, 5 * 2^k 中取估计开销最小的变换长度, *radix 返回奇数因子.
+ * 开销按 len * (log2(len / radix) + 顶层 radix 遍的折算层数) 估计
+ */
+size_t ntt_radix_cost[NTT_RADIX_MAX + 1] = {0, 0, 0, 3, 0, 5};
+
+u64 ntt_len_select(u64 conv_len, size_t* radix) {
+    u64 best_len = int_ceil2(conv_len);
+    double best = (double)best_len * log2_64(best_len);
+    *radix = 1;
+    for (size_t rr = 3; rr <= NTT_RADIX_MAX; rr += 2) {
+        u64 K = int_ceil2((conv_len + rr - 1) / rr), len = rr * K;
+        double cost = (double)len * (log2_64(K) + ntt_radix_cost[rr]);
+        if (len < best_len && cost < best) {
+            best = cost, best_len = len, *radix = rr;
+        }
+    }
+    return best_len;
+}
+
+/* out[ii] = in[ii] * c (mulinto, 规范值) */
+#define define_mulc(_i)                                                                          \
+    INLINE void mulc_##_i(const mont64* in, u64* out, u64 c, size_t len) {                       \
+        size_t ii = _simd_mulc(in, out, c, len, _i);                                             \
+        for (; ii < len; ii++) {                                                                 \
+            out[ii] = in[ii];                                                                    \
+            _mont_mulinto_func(out[ii], c, _i);                                                  \
+        }                                                                                        \
+    }
+
+define_mulc(1) define_mulc(2) define_mulc(3) define_mulc(4) define_mulc(5)
+
+/*
+ * crt3 + 进位的一段 [begin, end): out[ii] 为低 64 位, carry 为进入本段的进位, 返回时为段尾剩余的进位.
+ * 三个模数的 mulinto 按 CRT_CHUNK 个一组 (simd) 算出, 192 位合并与进位为标量.
+ */
+#define CRT_CHUNK 256
+
+static void crt3_block(const mont64* buf1, const mont64* buf2, const mont64* buf3, size_t begin, size_t end, u64* out,
+                       u192 carry) {
+    _Alignas(64) u64 r1[CRT_CHUNK];
+    _Alignas(64) u64 r2[CRT_CHUNK];
+    _Alignas(64) u64 r3[CRT_CHUNK];
+    for (size_t blk = begin; blk < end; blk += CRT_CHUNK) {
+        size_t len = (end - blk < CRT_CHUNK) ? end - blk : CRT_CHUNK;
+        mulc_1(buf1 + blk, r1, g_crt3_inv(1), len);
+        mulc_2(buf2 + blk, r2, g_crt3_inv(2), len);
+        mulc_3(buf3 + blk, r3, g_crt3_inv(3), len);
+        for (size_t kk = 0; kk < len; kk++) {
+            u192 temp = {0, 0, 0};
+            crt3_combine(r1[kk], r2[kk], r3[kk], temp);
+            _u192add(carry, temp);
+            out[blk + kk] = carry[0];
+            carry[0] = carry[1];
+            carry[1] = carry[2];
+            carry[2] = 0;
+        }
+    }
+}
+
+/* out[pos, end) += carry (按字对齐), 超出 end 的部分留在 carry 中 */
+INLINE void carry_ripple(u64* out, size_t pos, size_t end, u192 carry) {
+    for (size_t ii = pos; ii < end && (carry[0] | carry[1] | carry[2]) != 0; ii++) {
+        u64 sum = out[ii] + carry[0];
+        u64 cy = (sum < carry[0]) ? 1 : 0;
+        out[ii] = sum;
+        carry[0] = carry[1] + cy;
+        cy = (carry[0] < cy) ? 1 : 0;
+        carry[1] = carry[2] + cy;
+        carry[2] = 0;
+    }
+}
+
+/* 三个模数的结果逐项 crt3 并传播进位, 写出 out[0, conv_len] */
+void crt3_carry(const mont64* buf1, const mont64* buf2, const mont64* buf3, u64 conv_len, u64* out) {
+    u192 carry = {0, 0, 0};
+    crt3_block(buf1, buf2, buf3, 0, conv_len, out, carry);
+    out[conv_len] = carry[0];
+}
+
+/*
+ * 多线程的 crt3_carry: 按块并行做 crt3, 每块的进位从 0 开始, 块尾剩余的进位单独保存;
+ * 最后按顺序把前一块的进位加到下一块开头 (通常只影响 1 ~ 3 个字), 溢出块尾的部分并入下一块的进位.
+ */
+#define CRT_PAR_MIN_BLOCK 16384
+
+typedef struct CrtTask {
+    const mont64* buf1;
+    const mont64* buf2;
+    const mont64* buf3;
+    u64* out;
+    size_t begin;
+    size_t end;
+    u192 carry;
+} crt_task;
+
+static void crt3_task(void* arg) {
+    crt_task* tk = (crt_task*)arg;
+    tk->carry[0] = tk->carry[1] = tk->carry[2] = 0;
+    crt3_block(tk->buf1, tk->buf2, tk->buf3, tk->begin, tk->end, tk->out, tk->carry);
+}
+
+void crt3_carry_par(const conv_par* par, const mont64* buf1, const mont64* buf2, const mont64* buf3, u64 conv_len,
+                    u64* out) {
+    if (par == NULL || par->pool == NULL || par->pool->threads <= 1 || conv_len < 2 * CRT_PAR_MIN_BLOCK) {
+        crt3_carry(buf1, buf2, buf3, conv_len, out);
+        return;
+    }
+    size_t count = (size_t)par->pool->threads * 4;
+    count = count < CONV_PAR_MAX_CHUNKS ? count : CONV_PAR_MAX_CHUNKS;
+    count = count < conv_len / CRT_PAR_MIN_BLOCK ? count : conv_len / CRT_PAR_MIN_BLOCK;
+    size_t chunk = (conv_len + count - 1) / count;
+    crt_task tasks[CONV_PAR_MAX_CHUNKS];
+    task_group group;
+    task_group_init(&group);
+    for (size_t cc = 0; cc < count; cc++) {
+        tasks[cc].buf1 = buf1, tasks[cc].buf2 = buf2, tasks[cc].buf3 = buf3, tasks[cc].out = out;
+        tasks[cc].begin = cc * chunk;
+        tasks[cc].end = (cc + 1) * chunk < conv_len ? (cc + 1) * chunk : conv_len;
+        if (cc + 1 < count) {
+            task_spawn(par->pool, &group, crt3_task, tasks + cc);
+        }
+    }
+    crt3_task(tasks + count - 1);
+    task_wait(par->pool, &group);
+    u192 carry = {0, 0, 0};
+    for (size_t cc = 0; cc < count; cc++) {
+        carry_ripple(out, tasks[cc].begin, tasks[cc].end, carry);
+        _u192add(carry, tasks[cc].carry);
+    }
+    out[conv_len] = carry[0];
+}
+
+/*
+ * 第 3 个模数的卷积, 顶层逆变换与 crt3 + 进位融合 (buf1, buf2 为前两个模数的结果, in2 == NULL 时为平方).
+ * conv_tail 每次只做 CRT_FUSE_BLOCK 个下标, 趁 parts 段的结果还在缓存里直接做 crt3, 不再整遍写回后重读.
+ * 每段各自一条进位链, 最后把段尾剩余的进位加到下一段开头. 没有顶层遍的短变换退化为 crt3_carry.
+ */
+#define CRT_FUSE_BLOCK 1024
+
+void conv_crt3_carry(mont64* in1, mont64* in2, ntt_short* table, size_t radix, size_t ntt_len, size_t nz1, size_t nz2,
+                     const mont64* buf1, const mont64* buf2, u64 conv_len, u64* out) {
+    conv_tail tail;
+    conv_head_3(in1, in2, in1, table, radix, ntt_len, nz1, nz2, true, &tail);
+    if (tail.seg == 0) {
+        crt3_carry(buf1, buf2, in1, conv_len, out);
+        return;
+    }
+    assert(tail.parts <= CONV_TAIL_PARTS_MAX);
+    const size_t parts = (tail.parts < CONV_TAIL_PARTS_MAX) ? tail.parts : CONV_TAIL_PARTS_MAX; // 给编译器一个上界
+    u192 carry[CONV_TAIL_PARTS_MAX];
+    for (size_t part = 0; part < parts; part++) {
+        carry[part][0] = carry[part][1] = carry[part][2] = 0;
+    }
+    out[conv_len] = 0;
+    for (size_t blk = 0; blk < tail.seg; blk += CRT_FUSE_BLOCK) {
+        size_t blk_end = (tail.seg - blk < CRT_FUSE_BLOCK) ? tail.seg : blk + CRT_FUSE_BLOCK;
+        conv_tail_3(in1, &tail, blk, blk_end);
+        for (size_t part = 0; part < parts; part++) {
+            size_t begin = part * tail.seg + blk, end = part * tail.seg + blk_end;
+            end = (end < conv_len) ? end : conv_len;
+            if (begin < end) {
+                crt3_block(buf1, buf2, in1, begin, end, out, carry[part]);
+            }
+        }
+    }
+    for (size_t part = 0; part < parts; part++) {
+        size_t pos = (part + 1) * tail.seg;
+        carry_ripple(out, (pos < conv_len) ? pos : conv_len, conv_len + 1, carry[part]);
+    }
+}
+
+/* out[0, ntt_len) = in * R mod p 并补零, 转换与补零在同一遍内完成 */
+#define define_mont_load(_i)                                                                     \
+    void mont_load_##_i(const u64* in, u64 len, u64 ntt_len, mont64* out) {                      \
+        size_t ii = _simd_tomont(in, out, len, _i);                                              \
+        for (; ii < len; ii++) {                                                                 \
+            out[ii] = in[ii];                                                                    \
+            _mont_tomont_func(out[ii], _i);                                                      \
+        }                                                                                        \
+        for (; ii < ntt_len; ii++) {                                                             \
+            out[ii] = 0;                                                                         \
+        }                                                                                        \
+    }
+
+define_mont_load(1) define_mont_load(2) define_mont_load(3) define_mont_load(4) define_mont_load(5)
+
+#define mont_load_func(in, len, ntt_len, out, _i) mont_load_##_i(in, len, ntt_len, out)
+
+/* 同 mont_load, 但 in 每个字只读一次, 同时写出三个模数下的结果 */
+void mont_load3(const u64* in, u64 len, u64 ntt_len, mont64* out1, mont64* out2, mont64* out3) {
+    size_t ii = _simd_tomont3(in, out1, out2, out3, len);
+    for (; ii < len; ii++) {
+        out1[ii] = out2[ii] = out3[ii] = in[ii];
+        _mont_tomont_func(out1[ii], 1);
+        _mont_tomont_func(out2[ii], 2);
+        _mont_tomont_func(out3[ii], 3);
+    }
+    for (; ii < ntt_len; ii++) {
+        out1[ii] = out2[ii] = out3[ii] = 0;
+    }
+}
+
+/* 输入只读, in1 与 in2 可以重叠 (例如 x 乘 x 的前缀) */
+void abs_mul64(u64* in1, u64 len1, u64* in2, u64 len2, u64* out) {
+    assert(in1 != NULL && in2 != NULL && out != NULL);
+    u64 out_len = len1 + len2, conv_len = out_len - 1;
+    size_t radix = 1;
+    u64 ntt_len = ntt_len_select(conv_len, &radix);
+    NTT_STATS_BEGIN(stats, ntt_len, radix);
+
+    mont64* buf1_mont, *buf2_mont, *buf3_mont, *tmp_mont;
+    ALIGNED_MALLOC(buf1_mont, mont64, ntt_len);
+    ALIGNED_MALLOC(buf2_mont, mont64, ntt_len);
+    ALIGNED_MALLOC(buf3_mont, mont64, ntt_len);
+    ALIGNED_MALLOC(tmp_mont, mont64, ntt_len);
+
+    if (buf1_mont == NULL || buf2_mont == NULL || buf3_mont == NULL || tmp_mont == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    NTT_STATS_ALLOC(stats, ntt_len * 4 * sizeof(mont64));
+
+    const size_t table_log = log2_64((ntt_len / radix < long_threshold) ? ntt_len / radix : long_threshold);
+    NTT_STATS_PHASE(stats, NTT_PHASE_TABLE);
+    ntt_short* table1 = get_nttshort_func(table_log, 1);
+    ntt_short* table2 = get_nttshort_func(table_log, 2);
+    ntt_short* table3 = get_nttshort_func(table_log, 3);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mont_load3(in1, len1, ntt_len, buf1_mont, buf2_mont, buf3_mont);
+    mont_load_func(in2, len2, ntt_len, tmp_mont, 1);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV1);
+    conv_radix_func(buf1_mont, tmp_mont, buf1_mont, table1, radix, ntt_len, len1, len2, 1);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mont_load_func(in2, len2, ntt_len, tmp_mont, 2);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV2);
+    conv_radix_func(buf2_mont, tmp_mont, buf2_mont, table2, radix, ntt_len, len1, len2, 2);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mont_load_func(in2, len2, ntt_len, tmp_mont, 3);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV3);
+    conv_crt3_carry(buf3_mont, tmp_mont, table3, radix, ntt_len, len1, len2, buf1_mont, buf2_mont, conv_len, out);
+    NTT_STATS_END(stats);
+
+    ALIGNED_FREE(tmp_mont);
+
+    ALIGNED_FREE(buf1_mont);
+    ALIGNED_FREE(buf2_mont);
+    ALIGNED_FREE(buf3_mont);
+}
+
+void abs_sqr64(u64* in1, u64 len1, u64* out) {
+    assert(in1 != NULL && out != NULL);
+    u64 out_len = len1 * 2, conv_len = out_len - 1;
+    size_t radix = 1;
+    u64 ntt_len = ntt_len_select(conv_len, &radix);
+    NTT_STATS_BEGIN(stats, ntt_len, radix);
+
+    mont64 *buf1_mont, *buf2_mont, *buf3_mont;
+    ALIGNED_MALLOC(buf1_mont, mont64, ntt_len);
+    ALIGNED_MALLOC(buf2_mont, mont64, ntt_len);
+    ALIGNED_MALLOC(buf3_mont, mont64, ntt_len);
+
+    if (buf1_mont == NULL || buf2_mont == NULL || buf3_mont == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    NTT_STATS_ALLOC(stats, ntt_len * 3 * sizeof(mont64));
+
+    const size_t table_log = log2_64((ntt_len / radix < long_threshold) ? ntt_len / radix : long_threshold);
+    NTT_STATS_PHASE(stats, NTT_PHASE_TABLE);
+    ntt_short* table1 = get_nttshort_func(table_log, 1);
+    ntt_short* table2 = get_nttshort_func(table_log, 2);
+    ntt_short* table3 = get_nttshort_func(table_log, 3);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mont_load3(in1, len1, ntt_len, buf1_mont, buf2_mont, buf3_mont);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV1);
+    conv_radix_func(buf1_mont, NULL, buf1_mont, table1, radix, ntt_len, len1, len1, 1);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV2);
+    conv_radix_func(buf2_mont, NULL, buf2_mont, table2, radix, ntt_len, len1, len1, 2);
+
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV3);
+    conv_crt3_carry(buf3_mont, NULL, table3, radix, ntt_len, len1, len1, buf1_mont, buf2_mont, conv_len, out);
+    NTT_STATS_END(stats);
+
+    ALIGNED_FREE(buf1_mont);
+    ALIGNED_FREE(buf2_mont);
+    ALIGNED_FREE(buf3_mont);
+}
+
+/*
+ * 多线程模式: 三个模数的卷积互不依赖, 各自拥有 buf / tmp, twiddle 表取自共享缓存,
+ * 作为三个任务提交到 work-stealing 池, 每个卷积内部再按 conv_par 拆分.
+ * 全部结束后再做 crt3. in2 == NULL 时为平方.
+ */
+typedef struct ModJob {
+    const u64* in1;
+    u64 len1;
+    const u64* in2;
+    u64 len2;
+    mont64* buf;
+    mont64* tmp;
+    u64 ntt_len;
+    size_t table_log;
+    const conv_par* par;
+    bool in1_ready; // buf 已由 mont_load3 填好
+    bool in2_ready; // tmp 已由 mont_load3 填好
+    double ms;      // 本任务的耗时, 只在 NTT_STATS 时记录
+} mod_job;
+
+#define define_mod_job(_i)                                                      \
+    /* in1 / in2 转为 Montgomery 形式并补零到 ntt_len */                                  \
+    static void mod_job_load_##_i(const mod_job* job) {                         \
+        if (!job->in1_ready) {                                                  \
+            mont_load_func(job->in1, job->len1, job->ntt_len, job->buf, _i);    \
+        }                                                                       \
+        if (job->in2 != NULL && !job->in2_ready) {                              \
+            mont_load_func(job->in2, job->len2, job->ntt_len, job->tmp, _i);    \
+        }                                                                       \
+    }                                                                           \
+    static void mod_job_##_i(void* arg) {                                       \
+        mod_job* job = (mod_job*)arg;                                           \
+        double start = NTT_STATS_NOW();                                         \
+        mod_job_load_##_i(job);                                                 \
+        ntt_short* table = get_nttshort_func(job->table_log, _i);              \
+        if (job->in2 == NULL) {                                                 \
+            conv_sqr_par_func(job->par, job->buf, job->buf, table, job->ntt_len, job->len1, _i); \
+        } else {                                                                \
+            conv_rec_par_func(job->par, job->buf, job->tmp, job->buf, table, job->ntt_len, job->len1, job->len2, _i); \
+        }                                                                       \
+        job->ms = NTT_STATS_NOW() - start;                                      \
+    }
+
+define_mod_job(1) define_mod_job(2) define_mod_job(3) define_mod_job(4) define_mod_job(5)
+
+static const task_func mod_job_funcs[NTT_MOD_MAX] = {mod_job_1, mod_job_2, mod_job_3, mod_job_4, mod_job_5};
+
+/*
+ * 三个模数的卷积 + crt3. buf[jj] 为各模数的结果, tmp[jj] 为 in2 的转换缓冲,
+ * 串行时 (par 为 NULL 或单线程) 三个 tmp 可以指向同一块内存. in2 == NULL 时为平方.
+ * alloc_bytes 为调用者为本次调用分配的字节数, 只用于统计.
+ */
+static void abs_conv64_run(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out, mont64* const buf[3],
+                           mont64* const tmp[3], const conv_par* par, size_t alloc_bytes) {
+    u64 conv_len = len1 + len2 - 1;
+    u64 ntt_len = int_ceil2(conv_len);
+    NTT_STATS_BEGIN(stats, ntt_len, 1);
+    NTT_STATS_ALLOC(stats, alloc_bytes);
+    (void)alloc_bytes;
+
+    mod_job jobs[3];
+    for (int jj = 0; jj < 3; jj++) {
+        jobs[jj].in1 = in1;
+        jobs[jj].len1 = len1;
+        jobs[jj].in2 = in2;
+        jobs[jj].len2 = len2;
+        jobs[jj].ntt_len = ntt_len;
+        jobs[jj].par = par;
+        jobs[jj].table_log = log2_64((ntt_len < long_threshold) ? ntt_len : long_threshold);
+        jobs[jj].buf = buf[jj];
+        jobs[jj].tmp = tmp[jj];
+        jobs[jj].in1_ready = false;
+        jobs[jj].in2_ready = false;
+        jobs[jj].ms = 0;
+    }
+    NTT_STATS_PHASE(stats, NTT_PHASE_TABLE);
+    ntt_short* table3 = get_nttshort_func(jobs[2].table_log, 3);
+    (void)get_nttshort_func(jobs[0].table_log, 1);
+    (void)get_nttshort_func(jobs[1].table_log, 2);
+    NTT_STATS_PHASE(stats, -1);
+
+    if (par != NULL && par->pool != NULL && par->pool->threads > 1) {
+        task_group group;
+        task_group_init(&group);
+        task_spawn(par->pool, &group, mod_job_funcs[2], jobs + 2);
+        task_spawn(par->pool, &group, mod_job_funcs[1], jobs + 1);
+        mod_job_funcs[0](jobs);
+        task_wait(par->pool, &group);
+        for (int jj = 0; jj < 3; jj++) {
+            NTT_STATS_ADD(stats, NTT_PHASE_CONV1 + jj, jobs[jj].ms);
+        }
+        NTT_STATS_PHASE(stats, NTT_PHASE_CRT);
+        crt3_carry_par(par, buf[0], buf[1], buf[2], conv_len, out);
+        NTT_STATS_END(stats);
+        return;
+    }
+    /* 串行时输入一次读入转为三个模数; tmp 共用一块内存时 in2 只能在各模数卷积前分别转换 */
+    bool tmp3 = (in2 != NULL && tmp[0] != tmp[1] && tmp[1] != tmp[2] && tmp[0] != tmp[2]);
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mont_load3(in1, len1, ntt_len, buf[0], buf[1], buf[2]);
+    if (tmp3) {
+        mont_load3(in2, len2, ntt_len, tmp[0], tmp[1], tmp[2]);
+    }
+    for (int jj = 0; jj < 3; jj++) {
+        jobs[jj].in1_ready = true;
+        jobs[jj].in2_ready = tmp3;
+    }
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV1);
+    mod_job_funcs[0](jobs);
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV2);
+    mod_job_funcs[1](jobs + 1);
+    NTT_STATS_PHASE(stats, NTT_PHASE_LOAD);
+    mod_job_load_3(jobs + 2);
+    NTT_STATS_PHASE(stats, NTT_PHASE_CONV3);
+    conv_crt3_carry(buf[2], (in2 == NULL) ? NULL : tmp[2], table3, 1, ntt_len, len1, len2, buf[0], buf[1], conv_len,
+                    out);
+    NTT_STATS_END(stats);
+}
+
+static void abs_conv64_mt(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out, int threads) {
+    u64 ntt_len = int_ceil2(len1 + len2 - 1);
+
+    conv_par par;
+    par.pool = task_pool_create(threads);
+    par.grain = conv_task_grain;
+    par.chunk = conv_task_chunk;
+
+    mont64 *buf[3] = {NULL, NULL, NULL}, *tmp[3] = {NULL, NULL, NULL};
+    bool failed = (par.pool == NULL);
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_MALLOC(buf[jj], mont64, ntt_len);
+        if (in2 != NULL) {
+            ALIGNED_MALLOC(tmp[jj], mont64, ntt_len);
+            failed = failed || (tmp[jj] == NULL);
+        }
+        failed = failed || (buf[jj] == NULL);
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+
+    abs_conv64_run(in1, len1, in2, len2, out, buf, tmp, &par, ntt_len * ((in2 != NULL) ? 6 : 3) * sizeof(mont64));
+    task_pool_destroy(&par.pool);
+
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE(tmp[jj]);
+        ALIGNED_FREE(buf[jj]);
+    }
+}
+
+/* threads <= 1 时与 abs_mul64 相同 */
+void abs_mul64_mt(u64* in1, u64 len1, u64* in2, u64 len2, u64* out, int threads) {
+    assert(in1 != NULL && in2 != NULL && out != NULL);
+    if (threads <= 1) {
+        abs_mul64(in1, len1, in2, len2, out);
+        return;
+    }
+    abs_conv64_mt(in1, len1, in2, len2, out, threads);
+}
+
+/* threads <= 1 时与 abs_sqr64 相同 */
+void abs_sqr64_mt(u64* in1, u64 len1, u64* out, int threads) {
+    assert(in1 != NULL && out != NULL);
+    if (threads <= 1) {
+        abs_sqr64(in1, len1, out);
+        return;
+    }
+    abs_conv64_mt(in1, len1, NULL, len1, out, threads);
+}
+
+/*
+ * 可复用的乘法计划: 按 (max_len1, max_len2) 一次性分配并预先触碰工作区,
+ * 同时预热三个模数的 twiddle 表, 之后 mul_plan_execute 除四步法的列缓冲区外不再分配内存.
+ * 任何 len1 + len2 <= max_len1 + max_len2 的乘法都可以使用同一个计划.
+ * 同一个计划不能被多个线程同时执行.
+ */
+#define MUL_PLAN_DEFAULT 0u
+#define MUL_PLAN_NO_PREFAULT 1u // 不预先触碰工作区页面
+
+typedef struct MulPlan {
+    u64 max_ntt_len;
+    unsigned flags;
+    mont64* buf[3];
+    mont64* tmp[3];
+    conv_par par;
+} mul_plan;
+
+void mul_plan_destroy(mul_plan** plan) {
+    if (plan == NULL || *plan == NULL) {
+        return;
+    }
+    mul_plan* pl = *plan;
+    mont64* shared = pl->tmp[0]; // 单线程时三个模数共用 tmp[0]
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE(pl->buf[jj]);
+        if (jj == 0 || pl->tmp[jj] != shared) {
+            ALIGNED_FREE(pl->tmp[jj]);
+        }
+    }
+    task_pool_destroy(&pl->par.pool);
+    free(pl);
+    *plan = NULL;
+}
+
+/* threads > 1 时计划持有一个 work-stealing 池, 三个模数各自一块 tmp. 失败返回 NULL */
+mul_plan* mul_plan_create_mt(u64 max_len1, u64 max_len2, unsigned flags, int threads) {
+    if (max_len1 == 0 || max_len2 == 0) {
+        return NULL;
+    }
+    mul_plan* plan = (mul_plan*)calloc(1, sizeof(mul_plan));
+    if (plan == NULL) {
+        return NULL;
+    }
+    plan->max_ntt_len = int_ceil2(max_len1 + max_len2 - 1);
+    plan->flags = flags;
+    plan->par.grain = conv_task_grain;
+    plan->par.chunk = conv_task_chunk;
+    bool failed = false;
+    if (threads > 1) {
+        plan->par.pool = task_pool_create(threads);
+        failed = (plan->par.pool == NULL);
+    }
+    for (int jj = 0; jj < 3 && !failed; jj++) {
+        ALIGNED_MALLOC(plan->buf[jj], mont64, plan->max_ntt_len);
+        if (jj == 0 || threads > 1) {
+            ALIGNED_MALLOC(plan->tmp[jj], mont64, plan->max_ntt_len);
+        } else {
+            plan->tmp[jj] = plan->tmp[0];
+        }
+        failed = (plan->buf[jj] == NULL || plan->tmp[jj] == NULL);
+    }
+    if (failed) {
+        mul_plan_destroy(&plan);
+        return NULL;
+    }
+    if ((flags & MUL_PLAN_NO_PREFAULT) == 0) {
+        for (int jj = 0; jj < 3; jj++) {
+            memset(plan->buf[jj], 0, plan->max_ntt_len * sizeof(mont64));
+            if (jj == 0 || plan->tmp[jj] != plan->tmp[0]) {
+                memset(plan->tmp[jj], 0, plan->max_ntt_len * sizeof(mont64));
+            }
+        }
+    }
+    size_t table_log = log2_64((plan->max_ntt_len < long_threshold) ? plan->max_ntt_len : long_threshold);
+    get_nttshort_func(table_log, 1), get_nttshort_func(table_log, 2), get_nttshort_func(table_log, 3);
+    get_ntt_level_func(1), get_ntt_level_func(2), get_ntt_level_func(3);
+    return plan;
+}
+
+mul_plan* mul_plan_create(u64 max_len1, u64 max_len2, unsigned flags) {
+    return mul_plan_create_mt(max_len1, max_len2, flags, 1);
+}
+
+/* out[0, len1 + len2) = in1 * in2, in1 == in2 且 len1 == len2 时走平方. 超出计划容量返回 -1 */
+int mul_plan_execute(mul_plan* plan, const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    assert(plan != NULL && in1 != NULL && in2 != NULL && out != NULL);
+    if (len1 == 0 || len2 == 0 || int_ceil2(len1 + len2 - 1) > plan->max_ntt_len) {
+        return -1;
+    }
+    bool sqr = (in1 == in2 && len1 == len2);
+    abs_conv64_run(in1, len1, sqr ? NULL : in2, len2, out, plan->buf, plan->tmp, &plan->par, 0);
+    return 0;
+}
+
+/*
+ * 调用者提供工作区的乘法, 内部不 abort; 只有四步法分配几百 KiB 的列缓冲区, 分配失败时退回递归.
+ * 工作区为三个模数的结果缓冲和一个 in2 转换缓冲, 各 ntt_len 个 mont64, 另加对齐余量;
+ * twiddle 表来自进程内共享缓存 (静态存储), 不占用工作区.
+ */
+size_t abs_mul64_workspace_size(u64 len1, u64 len2) {
+    if (len1 == 0 || len2 == 0) {
+        return 0;
+    }
+    u64 ntt_len = int_ceil2(len1 + len2 - 1);
+    return 4 * ntt_len * sizeof(mont64) + CACHE_LINE_SIZE;
+}
+
+/* 成功返回 0, 参数非法或工作区不足返回 -1 (此时 out 未被修改) */
+int abs_mul64_ws(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out, void* workspace,
+                 size_t workspace_bytes) {
+    if (in1 == NULL || in2 == NULL || out == NULL || workspace == NULL || len1 == 0 || len2 == 0) {
+        return -1;
+    }
+    if (workspace_bytes < abs_mul64_workspace_size(len1, len2)) {
+        return -1;
+    }
+    u64 ntt_len = int_ceil2(len1 + len2 - 1);
+    uintptr_t base = ((uintptr_t)workspace + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    mont64* ws = (mont64*)base;
+    mont64* buf[3] = {ws, ws + ntt_len, ws + ntt_len * 2};
+    mont64* tmp[3] = {ws + ntt_len * 3, ws + ntt_len * 3, ws + ntt_len * 3};
+    bool sqr = (in1 == in2 && len1 == len2);
+    abs_conv64_run(in1, len1, sqr ? NULL : in2, len2, out, buf, tmp, NULL, 0);
+    return 0;
+}
+
+/*
+ * 预变换的乘数: 同一个 in 与多个 in2 相乘时 (Newton 迭代, 进制转换等), 三个模数下 in 的正变换只做一次,
+ * 之后每次乘法只变换 in2 (conv_single), 省去约 1/3 的 NTT.
+ */
+typedef struct MulOperand {
+    u64 len;
+    u64 ntt_len;
+    mont64* ntt[3];
+} mul_operand;
+
+void mul_operand_destroy(mul_operand** op) {
+    if (op == NULL || *op == NULL) {
+        return;
+    }
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE((*op)->ntt[jj]);
+    }
+    free(*op);
+    *op = NULL;
+}
+
+
+/* target_ntt_len 向上取 2 的幂, 须 >= len; 之后只能与 len + len2 - 1 <= ntt_len 的 in2 相乘. 失败返回 NULL */
+mul_operand* mul_operand_precompute(const u64* in, u64 len, u64 target_ntt_len) {
+    if (in == NULL || len == 0 || target_ntt_len < len) {
+        return NULL;
+    }
+    mul_operand* op = (mul_operand*)calloc(1, sizeof(mul_operand));
+    if (op == NULL) {
+        return NULL;
+    }
+    op->len = len;
+    op->ntt_len = int_ceil2(target_ntt_len);
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_MALLOC(op->ntt[jj], mont64, op->ntt_len);
+        if (op->ntt[jj] == NULL) {
+            mul_operand_destroy(&op);
+            return NULL;
+        }
+    }
+    mont_load3(in, len, op->ntt_len, op->ntt[0], op->ntt[1], op->ntt[2]);
+    size_t table_log = log2_64((op->ntt_len < long_threshold) ? op->ntt_len : long_threshold);
+    ntt_rec_nz_1(op->ntt[0], get_nttshort_func(table_log, 1), op->ntt_len, len);
+    ntt_rec_nz_2(op->ntt[1], get_nttshort_func(table_log, 2), op->ntt_len, len);
+    ntt_rec_nz_3(op->ntt[2], get_nttshort_func(table_log, 3), op->ntt_len, len);
+    return op;
+}
+
+#define define_operand_mul(_i)                                                                   \
+    static void operand_mul_##_i(const mul_operand* op, mont64* buf, u64 len2) {                 \
+        size_t table_log = log2_64((op->ntt_len < long_threshold) ? op->ntt_len : long_threshold); \
+        conv_single_nz_##_i(op->ntt[_i - 1], buf, buf, get_nttshort_func(table_log, _i), op->ntt_len, len2, true); \
+    }
+
+define_operand_mul(1) define_operand_mul(2) define_operand_mul(3)
+
+/* abs_mul64_pre 的主体, buf 为三个 ntt_len 长的缓冲区 */
+static void operand_mul_run(const mul_operand* op, const u64* in2, u64 len2, mont64* const buf[3], u64* out) {
+    mont_load3(in2, len2, op->ntt_len, buf[0], buf[1], buf[2]);
+    operand_mul_1(op, buf[0], len2);
+    operand_mul_2(op, buf[1], len2);
+    operand_mul_3(op, buf[2], len2);
+    crt3_carry(buf[0], buf[1], buf[2], op->len + len2 - 1, out);
+}
+
+/* out[0, op->len + len2) = in * in2. len + len2 - 1 超出 ntt_len 或分配失败返回 -1 */
+int abs_mul64_pre(const mul_operand* op, const u64* in2, u64 len2, u64* out) {
+    if (op == NULL || in2 == NULL || out == NULL || len2 == 0 || op->len + len2 - 1 > op->ntt_len) {
+        return -1;
+    }
+    mont64* buf[3] = {NULL, NULL, NULL};
+    bool failed = false;
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_MALLOC(buf[jj], mont64, op->ntt_len);
+        failed = failed || (buf[jj] == NULL);
+    }
+    if (!failed) {
+        operand_mul_run(op, in2, len2, buf, out);
+    }
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE(buf[jj]);
+    }
+    return failed ? -1 : 0;
+}
+
+/*
+ * 截断卷积: 避免把 conv_len 补到 2 的幂.
+ * 设 N = ceil2(conv_len) / 2, 取 x^(2N) - 1 的两两互素的因子
+ *   x^N - 1,  x^(N / 2^j) - zeta_j  (zeta_j = t_j^(N / 2^j), t_j = w_2N^(2^j - 1), 1 <= j <= ntt_trunc_pieces)
+ * 中总次数 >= conv_len 的一组, 每个因子上的乘积用 x = t_j * y 变成长度 N / 2^j 的循环卷积 (conv_rec),
+ * 最后在模 p 下逐个因子做 CRT 拼回 c mod p. 变换总长度按 N / 2^ntt_trunc_pieces 的粒度增长.
+ */
+#define NTT_TRUNC_MAX_PIECES 8
+
+size_t ntt_trunc_pieces = 3;
+
+typedef struct TruncPlan {
+    u64 conv_len;
+    u64 total;
+    int count;
+    u64 size[NTT_TRUNC_MAX_PIECES];
+    int level[NTT_TRUNC_MAX_PIECES];
+} trunc_plan;
+
+/* 估计开销: 每段循环卷积约 K * (1.5 * log2(K) + 4), 每段折叠输入 + CRT 合并按每元素 3 计 */
+static double trunc_plan_cost(const trunc_plan* tp) {
+    double cost = 0, deg = 0, terms = 2;
+    for (int pp = 0; pp < tp->count; pp++) {
+        double K = (double)tp->size[pp];
+        cost += K * (1.5 * log2_64(tp->size[pp]) + 4);
+        if (pp > 0) {
+            cost += 3 * (deg + (terms - 1) * K + (double)tp->conv_len);
+            terms *= 2;
+        }
+        deg += K;
+    }
+    return cost;
+}
+
+/* size[0] 为 x^size[0] - 1 的循环部分, 其余为 level[pp] = j 的扭曲部分. 在不超过 ntt_trunc_pieces 段中取估计开销最小的分解 */
+static void trunc_plan_init(trunc_plan* tp, u64 conv_len) {
+    u64 ntt_len = int_ceil2(conv_len);
+    tp->conv_len = conv_len;
+    tp->count = 1;
+    tp->size[0] = ntt_len;
+    tp->level[0] = 0;
+    tp->total = ntt_len;
+    if (ntt_len == conv_len || ntt_len < 4) {
+        return;
+    }
+    u64 half = ntt_len / 2;
+    size_t max_pieces = ntt_trunc_pieces < NTT_TRUNC_MAX_PIECES - 1 ? ntt_trunc_pieces : NTT_TRUNC_MAX_PIECES - 1;
+    double best = trunc_plan_cost(tp);
+    for (size_t pieces = 1; pieces <= max_pieces && (half >> pieces) != 0; pieces++) {
+        u64 grain = half >> pieces;
+        u64 q = (conv_len - half + grain - 1) / grain;
+        if (q >= (1ull << pieces)) {
+            continue;
+        }
+        trunc_plan cand = {conv_len, half, 1, {half}, {0}};
+        for (size_t jj = 1; jj <= pieces; jj++) {
+            if (((q >> (pieces - jj)) & 1) != 0) {
+                cand.size[cand.count] = half >> jj;
+                cand.level[cand.count] = (int)jj;
+                cand.count++;
+                cand.total += half >> jj;
+            }
+        }
+        double cost = trunc_plan_cost(&cand);
+        if (cost < best) {
+            best = cost;
+            *tp = cand;
+        }
+    }
+}
+
+#define define_trunc_conv(_i)                                                                                   \
+    /* out[ii] = sum_k in[ii + k * K] * zeta^k, 结果为规范值 */                                                   \
+    INLINE void trunc_fold_##_i(const u64* in, u64 len, mont64* out, u64 K, mont64 zeta) {                       \
+        mont64 z = g_one(_i);                                                                                    \
+        for (size_t base = 0; base < K || base < len; base += K) {                                               \
+            size_t n = (base >= len) ? 0 : (len - base < K ? len - base : K);                                    \
+            mont64 zr = z;                                                                                       \
+            _mont_tomont_func(zr, _i);                                                                           \
+            if (base == 0) {                                                                                     \
+                for (size_t ii = 0; ii < n; ii++) {                                                              \
+                    out[ii] = in[ii];                                                                            \
+                    _mont_mulinto_func(out[ii], zr, _i);                                                         \
+                }                                                                                                \
+                for (size_t ii = n; ii < K; ii++) {                                                              \
+                    out[ii] = 0;                                                                                 \
+                }                                                                                                \
+            }                                                                                                    \
+            for (size_t ii = 0; base > 0 && ii < n; ii++) {                                                      \
+                mont64 x = in[base + ii];                                                                        \
+                _mont_mulinto_func(x, zr, _i);                                                                   \
+                _mont_add(out[ii], out[ii], x, g_mod(_i));                                                       \
+            }                                                                                                    \
+            _mont_mulinto_func(z, zeta, _i);                                                                     \
+        }                                                                                                        \
+    }                                                                                                            \
+    /* in[ii] *= t^ii, 4 条独立的幂链 */                                                                            \
+    INLINE void trunc_twist_##_i(mont64* in, u64 K, mont64 t) {                                                  \
+        mont64 w[4] = {g_one(_i), t, t, t}, t4 = t;                                                              \
+        _mont_mulinto_func(w[2], t, _i);                                                                         \
+        w[3] = w[2];                                                                                             \
+        _mont_mulinto_func(w[3], t, _i);                                                                         \
+        _mont_mulinto_func(t4, w[3], _i);                                                                        \
+        for (size_t ii = 0; ii < K; ii += 4) {                                                                   \
+            for (size_t kk = 0; kk < 4 && ii + kk < K; kk++) {                                                   \
+                _mont_mulinto_func(in[ii + kk], w[kk], _i);                                                      \
+                _mont_mulinto_func(w[kk], t4, _i);                                                               \
+            }                                                                                                    \
+        }                                                                                                        \
+    }                                                                                                            \
+    /* bufa[0, conv_len) = in1 * in2 mod p, in2 == NULL 时为平方; bufa / bufb 至少 tp->total 长 */                \
+    static void trunc_conv_##_i(const trunc_plan* tp, const u64* in1, u64 len1, const u64* in2, u64 len2,        \
+                                mont64* bufa, mont64* bufb) {                                                    \
+        const u64 size0 = tp->size[0];                                                                           \
+        const ntt_level* level = get_ntt_level_func(_i);                                                         \
+        ntt_short* table = get_nttshort_func(log2_64(size0 < long_threshold ? size0 : long_threshold), _i);      \
+        mont64 root = g_one(_i), rootinv = g_one(_i);                                                            \
+        if (tp->count > 1) {                                                                                     \
+            root = level->root[log2_64(size0) + 1];                                                              \
+            rootinv = level->rootinv[log2_64(size0) + 1];                                                        \
+        }                                                                                                        \
+        mont64 zeta[NTT_TRUNC_MAX_PIECES];                                                                       \
+        size_t off = 0;                                                                                          \
+        for (int pp = 0; pp < tp->count; pp++) {                                                                 \
+            const u64 K = tp->size[pp];                                                                          \
+            const u64 e = (1ull << tp->level[pp]) - 1;                                                           \
+            mont64 t = _mont_qpow_func_name(_i)(root, e), tinv = _mont_qpow_func_name(_i)(rootinv, e);           \
+            zeta[pp] = _mont_qpow_func_name(_i)(t, K);                                                           \
+            trunc_fold_##_i(in1, len1, bufa + off, K, zeta[pp]);                                                 \
+            if (pp > 0) {                                                                                        \
+                trunc_twist_##_i(bufa + off, K, t);                                                              \
+            }                                                                                                    \
+            if (in2 != NULL) {                                                                                   \
+                trunc_fold_##_i(in2, len2, bufb + off, K, zeta[pp]);                                             \
+                if (pp > 0) {                                                                                    \
+                    trunc_twist_##_i(bufb + off, K, t);                                                          \
+                }                                                                                                \
+                conv_rec_##_i(bufa + off, bufb + off, bufa + off, table, K, true);                               \
+            } else {                                                                                             \
+                conv_sqr_##_i(bufa + off, bufa + off, table, K, true);                                           \
+            }                                                                                                    \
+            if (tp->count > 1) {                                                                                 \
+                trunc_twist_##_i(bufa + off, K, tinv);                                                           \
+            }                                                                                                    \
+            off += K;                                                                                            \
+        }                                                                                                        \
+        /* CRT: c = r + M * u, M = 已合并因子之积 (稀疏, 首一), u = (s - r mod Q) / (M mod Q) mod Q */             \
+        u64 m_exp[1 << NTT_TRUNC_MAX_PIECES];                                                                    \
+        mont64 m_coef[1 << NTT_TRUNC_MAX_PIECES];                                                                \
+        mont64 zeta_pow[2 << NTT_TRUNC_MAX_PIECES];                                                              \
+        size_t terms = 2;                                                                                        \
+        m_exp[0] = 0, m_coef[0] = g_mod(_i) - g_one(_i);                                                         \
+        m_exp[1] = size0, m_coef[1] = g_one(_i);                                                                 \
+        u64 deg = size0;                                                                                         \
+        for (int pp = 1; pp < tp->count; pp++) {                                                                 \
+            const u64 K = tp->size[pp];                                                                          \
+            mont64* u = bufa + deg;                                                                              \
+            zeta_pow[0] = g_one(_i);                                                                             \
+            for (size_t kk = 1; kk <= deg / K; kk++) {                                                           \
+                zeta_pow[kk] = zeta_pow[kk - 1];                                                                 \
+                _mont_mulinto_func(zeta_pow[kk], zeta[pp], _i);                                                  \
+            }                                                                                                    \
+            mont64 mu = 0;                                                                                       \
+            for (size_t tt = 0; tt < terms; tt++) {                                                              \
+                mont64 x = m_coef[tt];                                                                           \
+                _mont_mulinto_func(x, zeta_pow[m_exp[tt] / K], _i);                                              \
+                _mont_add(mu, mu, x, g_mod(_i));                                                                 \
+            }                                                                                                    \
+            mont64 mu_inv = _mont_qpow_func_name(_i)(mu, g_mod(_i) - 2);                                         \
+            for (size_t ii = 0; ii < K; ii++) {                                                                  \
+                mont64 rq = 0;                                                                                   \
+                for (size_t ee = ii, kk = 0; ee < deg; ee += K, kk++) {                                          \
+                    mont64 x = bufa[ee];                                                                         \
+                    _mont_mulinto_func(x, zeta_pow[kk], _i);                                                     \
+                    _mont_add(rq, rq, x, g_mod(_i));                                                             \
+                }                                                                                                \
+                _mont_sub(u[ii], u[ii], rq, g_mod(_i));                                                          \
+                _mont_mulinto_func(u[ii], mu_inv, _i);                                                           \
+            }                                                                                                    \
+            for (size_t tt = 0; tt + 1 < terms; tt++) {                                                          \
+                mont64* c = bufa + m_exp[tt];                                                                    \
+                for (size_t ii = 0; ii < K; ii++) {                                                              \
+                    mont64 x = u[ii];                                                                            \
+                    _mont_mulinto_func(x, m_coef[tt], _i);                                                       \
+                    _mont_add(c[ii], c[ii], x, g_mod(_i));                                                       \
+                }                                                                                                \
+            }                                                                                                    \
+            for (size_t tt = 0; tt < terms; tt++) {                                                              \
+                m_exp[terms + tt] = m_exp[tt] + K;                                                               \
+                m_coef[terms + tt] = m_coef[tt];                                                                 \
+                _mont_mulinto_func(m_coef[tt], zeta[pp], _i);                                                    \
+                m_coef[tt] = (m_coef[tt] == 0) ? 0 : g_mod(_i) - m_coef[tt];                                     \
+            }                                                                                                    \
+            terms *= 2;                                                                                          \
+            deg += K;                                                                                            \
+        }                                                                                                        \
+    }
+
+define_trunc_conv(1) define_trunc_conv(2) define_trunc_conv(3)
+
+/* 与 abs_mul64 结果相同, 变换长度与内存随 len1 + len2 平滑增长. in1 == in2 且 len1 == len2 时走平方 */
+void abs_mul64_trunc(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    assert(in1 != NULL && in2 != NULL && out != NULL);
+    u64 conv_len = len1 + len2 - 1;
+    bool sqr = (in1 == in2 && len1 == len2);
+    trunc_plan tp;
+    trunc_plan_init(&tp, conv_len);
+
+    mont64 *bufa[3] = {NULL, NULL, NULL}, *bufb = NULL;
+    bool failed = false;
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_MALLOC(bufa[jj], mont64, tp.total);
+        failed = failed || (bufa[jj] == NULL);
+    }
+    if (!sqr) {
+        ALIGNED_MALLOC(bufb, mont64, tp.total);
+        failed = failed || (bufb == NULL);
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    trunc_conv_1(&tp, in1, len1, sqr ? NULL : in2, len2, bufa[0], bufb);
+    trunc_conv_2(&tp, in1, len1, sqr ? NULL : in2, len2, bufa[1], bufb);
+    trunc_conv_3(&tp, in1, len1, sqr ? NULL : in2, len2, bufa[2], bufb);
+    ALIGNED_FREE(bufb);
+    crt3_carry(bufa[0], bufa[1], bufa[2], conv_len, out);
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE(bufa[jj]);
+    }
+}
+
+/*
+ * 交错 (AoSoA) 布局: 每 NTT_AOS_W 个下标为一块, 块内依次存放三个模数下的余数,
+ * 即下标 ii 在模数 k (0..2) 下的余数位于 (ii / W) * 3W + k * W + ii % W.
+ * 长变换的顶层 dif244 / idit244 一遍扫过同一片内存完成三个模数, crt3 顺序读一条流;
+ * 规模降到 NTT_AOS_LEAF 后按模数收集到连续缓冲区, 用原有的 conv_rec / conv_sqr 完成.
+ */
+#define NTT_AOS_W CONV_TWIDDLE_BLOCK
+#define NTT_AOS_LEAF (long_threshold / 8) // 三个模数两个输入的叶子合计放得进 L2
+
+/* (ptr + aos_shift(blk, k))[ii] 为 blk 所在块中模数 k 下标 ii 的余数 */
+#define aos_shift(blk, k) ((blk) / NTT_AOS_W * 2 * NTT_AOS_W + (k) * NTT_AOS_W)
+
+typedef struct {
+    _Alignas(64) mont64 pw1[CONV_TWIDDLE_BLOCK];
+    _Alignas(64) mont64 pw3[CONV_TWIDDLE_BLOCK];
+    mont64 jump1, jump3, base1, base3;
+} aos_twiddle;
+
+#define define_aos_twiddle(_i)                                                                   \
+    INLINE void aos_twiddle_init_##_i(aos_twiddle* tw, size_t ntt_len, bool inv, mont64 scale) { \
+        const ntt_level* level = get_ntt_level_func(_i);                                         \
+        const size_t lg = log2_64(ntt_len);                                                      \
+        tw->jump1 = twiddle_block_##_i(tw->pw1, inv ? level->rootinv[lg] : level->root[lg]);     \
+        tw->jump3 = twiddle_block_##_i(tw->pw3, inv ? level->rootinv3[lg] : level->root3[lg]);   \
+        tw->base1 = tw->base3 = scale;                                                           \
+    }                                                                                            \
+    INLINE void aos_twiddle_next_##_i(aos_twiddle* tw) {                                         \
+        _mont_mulinto_func(tw->base1, tw->jump1, _i);                                            \
+        _mont_mulinto_func(tw->base3, tw->jump3, _i);                                            \
+    }
+
+define_aos_twiddle(1) define_aos_twiddle(2) define_aos_twiddle(3)
+
+/* 三个模数共用一遍的 dif244_top, 返回值含义相同 */
+static size_t dif244_aos_pass(mont64* in, size_t ntt_len, size_t nz) {
+    const size_t quarter_len = ntt_len / 4, stride = quarter_len * 3;
+    const bool half = (nz <= quarter_len * 2);
+    const size_t end = (half && nz < quarter_len) ? nz : quarter_len;
+    aos_twiddle tw[3];
+    aos_twiddle_init_1(&tw[0], ntt_len, false, g_one(1));
+    aos_twiddle_init_2(&tw[1], ntt_len, false, g_one(2));
+    aos_twiddle_init_3(&tw[2], ntt_len, false, g_one(3));
+    for (size_t blk = 0; blk < end; blk += NTT_AOS_W) {
+        size_t blk_end = (end - blk < NTT_AOS_W) ? end : blk + NTT_AOS_W;
+        dif244_block_1(in + aos_shift(blk, 0), stride, blk, blk_end, tw[0].base1, tw[0].base3, tw[0].pw1, tw[0].pw3,
+                       half);
+        dif244_block_2(in + aos_shift(blk, 1), stride, blk, blk_end, tw[1].base1, tw[1].base3, tw[1].pw1, tw[1].pw3,
+                       half);
+        dif244_block_3(in + aos_shift(blk, 2), stride, blk, blk_end, tw[2].base1, tw[2].base3, tw[2].pw1, tw[2].pw3,
+                       half);
+        aos_twiddle_next_1(&tw[0]);
+        aos_twiddle_next_2(&tw[1]);
+        aos_twiddle_next_3(&tw[2]);
+    }
+    return half ? nz : ntt_len / 2;
+}
+
+static void idit244_aos_pass(mont64* out, size_t ntt_len, bool norm) {
+    const size_t quarter_len = ntt_len / 4, stride = quarter_len * 3;
+    const size_t lg = log2_64(ntt_len);
+    mont64 inv_len[3] = {g_one(1), g_one(2), g_one(3)};
+    if (norm) {
+        inv_len[0] = get_ntt_level_func(1)->inv_len[lg];
+        inv_len[1] = get_ntt_level_func(2)->inv_len[lg];
+        inv_len[2] = get_ntt_level_func(3)->inv_len[lg];
+    }
+    aos_twiddle tw[3];
+    aos_twiddle_init_1(&tw[0], ntt_len, true, inv_len[0]);
+    aos_twiddle_init_2(&tw[1], ntt_len, true, inv_len[1]);
+    aos_twiddle_init_3(&tw[2], ntt_len, true, inv_len[2]);
+    for (size_t blk = 0; blk < quarter_len; blk += NTT_AOS_W) {
+        size_t blk_end = blk + NTT_AOS_W;
+        idit244_block_1(out + aos_shift(blk, 0), stride, blk, blk_end, tw[0].base1, tw[0].base3, tw[0].pw1, tw[0].pw3,
+                        inv_len[0], norm);
+        idit244_block_2(out + aos_shift(blk, 1), stride, blk, blk_end, tw[1].base1, tw[1].base3, tw[1].pw1, tw[1].pw3,
+                        inv_len[1], norm);
+        idit244_block_3(out + aos_shift(blk, 2), stride, blk, blk_end, tw[2].base1, tw[2].base3, tw[2].pw1, tw[2].pw3,
+                        inv_len[2], norm);
+        aos_twiddle_next_1(&tw[0]);
+        aos_twiddle_next_2(&tw[1]);
+        aos_twiddle_next_3(&tw[2]);
+    }
+}
+
+/* out[0, len) = 模数 k 下的 in[0, len) (交错 -> 连续), aos_scatter 为其逆 */
+INLINE void aos_gather(const mont64* in, size_t len, int k, mont64* out) {
+    for (size_t blk = 0; blk < len; blk += NTT_AOS_W) {
+        size_t n = (len - blk < NTT_AOS_W) ? len - blk : NTT_AOS_W;
+        memcpy(out + blk, in + aos_shift(blk, k) + blk, n * sizeof(mont64));
+    }
+}
+
+INLINE void aos_scatter(const mont64* in, size_t len, int k, mont64* out) {
+    for (size_t blk = 0; blk < len; blk += NTT_AOS_W) {
+        size_t n = (len - blk < NTT_AOS_W) ? len - blk : NTT_AOS_W;
+        memcpy(out + aos_shift(blk, k) + blk, in + blk, n * sizeof(mont64));
+    }
+}
+
+/* 叶子: 收集模数 _i 的余数到 scratch, 用连续布局的卷积算完再写回 */
+#define define_aos_leaf(_i)                                                                                    \
+    INLINE void conv_aos_leaf_##_i(mont64* in1, mont64* in2, size_t ntt_len, size_t nz1, size_t nz2, bool norm, \
+                                   mont64* scratch, size_t table_log) {                                        \
+        mont64 *s1 = scratch, *s2 = scratch + ntt_len;                                                         \
+        ntt_short* table = get_nttshort_func(table_log, _i);                                                   \
+        aos_gather(in1, ntt_len, _i - 1, s1);                                                                  \
+        if (in2 != NULL) {                                                                                     \
+            aos_gather(in2, ntt_len, _i - 1, s2);                                                              \
+            conv_rec_nz_##_i(s1, s2, s1, table, ntt_len, nz1, nz2, norm);                                      \
+        } else {                                                                                               \
+            conv_sqr_nz_##_i(s1, s1, table, ntt_len, nz1, norm);                                               \
+        }                                                                                                      \
+        aos_scatter(s1, ntt_len, _i - 1, in1);                                                                 \
+    }
+
+define_aos_leaf(1) define_aos_leaf(2) define_aos_leaf(3)
+
+/*
+ * 交错布局下的三模数卷积, 结果写回 in1; in2 == NULL 时为平方.
+ * scratch 至少 2 * min(ntt_len, NTT_AOS_LEAF) 个元素
+ */
+static void conv_aos(mont64* in1, mont64* in2, size_t ntt_len, size_t nz1, size_t nz2, bool norm, mont64* scratch,
+                     size_t table_log) {
+    if (ntt_len <= NTT_AOS_LEAF) {
+        conv_aos_leaf_1(in1, in2, ntt_len, nz1, nz2, norm, scratch, table_log);
+        conv_aos_leaf_2(in1, in2, ntt_len, nz1, nz2, norm, scratch, table_log);
+        conv_aos_leaf_3(in1, in2, ntt_len, nz1, nz2, norm, scratch, table_log);
+        return;
+    }
+    const size_t quarter_len = ntt_len / 4;
+    nz1 = dif244_aos_pass(in1, ntt_len, nz1);
+    if (in2 != NULL) {
+        nz2 = dif244_aos_pass(in2, ntt_len, nz2);
+    }
+    conv_aos(in1, in2, ntt_len / 2, nz1, nz2, false, scratch, table_log);
+    nz1 = _nz_quarter(nz1, quarter_len), nz2 = _nz_quarter(nz2, quarter_len);
+    for (size_t qq = 2; qq < 4; qq++) {
+        conv_aos(in1 + quarter_len * 3 * qq, (in2 != NULL) ? in2 + quarter_len * 3 * qq : NULL, quarter_len, nz1, nz2,
+                 false, scratch, table_log);
+    }
+    idit244_aos_pass(in1, ntt_len, norm);
+}
+
+/* out 为交错布局, 前 len 项为 in 的三个模数下的 Montgomery 形式, [len, ntt_len) 为 0 */
+static void mont_load_aos(const u64* in, u64 len, u64 ntt_len, mont64* out) {
+    size_t blk = 0;
+    for (; blk < len; blk += NTT_AOS_W) {
+        size_t n = (len - blk < NTT_AOS_W) ? len - blk : NTT_AOS_W;
+        size_t fill = (ntt_len - blk < NTT_AOS_W) ? ntt_len - blk : NTT_AOS_W;
+        mont64* p = out + blk * 3;
+        mont_load3(in + blk, n, fill, p, p + NTT_AOS_W, p + NTT_AOS_W * 2);
+    }
+    if (blk < ntt_len) {
+        memset(out + blk * 3, 0, (ntt_len - blk) * 3 * sizeof(mont64));
+    }
+}
+
+/* 交错布局的 crt3_carry, 每块三个模数的余数相邻 */
+static void crt3_carry_aos(const mont64* buf, u64 conv_len, u64* out) {
+    u192 carry = {0, 0, 0};
+    for (size_t blk = 0; blk < conv_len; blk += NTT_AOS_W) {
+        size_t blk_end = (conv_len - blk < NTT_AOS_W) ? conv_len : blk + NTT_AOS_W;
+        crt3_block(buf + aos_shift(blk, 0), buf + aos_shift(blk, 1), buf + aos_shift(blk, 2), blk, blk_end, out,
+                   carry);
+    }
+    out[conv_len] = carry[0];
+}
+
+/* 与 abs_mul64 结果相同, 使用交错布局 (变换长度为 2 的幂, 单线程). in1 == in2 且 len1 == len2 时走平方 */
+void abs_mul64_aos(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    assert(in1 != NULL && in2 != NULL && out != NULL);
+    u64 conv_len = len1 + len2 - 1;
+    bool sqr = (in1 == in2 && len1 == len2);
+    u64 ntt_len = int_ceil2(conv_len);
+    u64 aos_len = (ntt_len < NTT_AOS_W) ? NTT_AOS_W : ntt_len;
+    u64 leaf_len = (ntt_len < NTT_AOS_LEAF) ? ntt_len : NTT_AOS_LEAF;
+
+    mont64 *buf1, *buf2 = NULL, *scratch;
+    ALIGNED_MALLOC(buf1, mont64, aos_len * 3);
+    ALIGNED_MALLOC(scratch, mont64, leaf_len * 2);
+    if (!sqr) {
+        ALIGNED_MALLOC(buf2, mont64, aos_len * 3);
+    }
+    if (buf1 == NULL || scratch == NULL || (!sqr && buf2 == NULL)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    const size_t table_log = log2_64((ntt_len < long_threshold) ? ntt_len : long_threshold);
+
+    mont_load_aos(in1, len1, aos_len, buf1);
+    if (!sqr) {
+        mont_load_aos(in2, len2, aos_len, buf2);
+    }
+    conv_aos(buf1, buf2, ntt_len, len1, sqr ? len1 : len2, true, scratch, table_log);
+    crt3_carry_aos(buf1, conv_len, out);
+
+    ALIGNED_FREE(buf1);
+    ALIGNED_FREE(buf2);
+    ALIGNED_FREE(scratch);
+}
+
+/*
+ * 按长度分派的乘法: 较短一方小于 mul_ntt_threshold 时在 64 位字上直接做 schoolbook / Karatsuba / Toom-3,
+ * 否则交给 abs_mul64 / abs_sqr64. 结果格式与 abs_mul64 相同. 阈值可用 mul_dispatch_tune 在本机测出.
+ */
+size_t mul_karatsuba_threshold = 24; // 均衡乘法长度 >= 此值时用 Karatsuba (至少 2)
+size_t mul_toom3_threshold = 192;    // >= 此值时用 Toom-3 (至少 9)
+size_t mul_ntt_threshold = 1024;     // 较短一方 >= 此值时用三模数 NTT
+
+/* 一次乘法所用的阈值: 入口处从上面的全局值取一份, 递归与工作区长度都按这一份计算 */
+typedef struct MulDispatch {
+    size_t kara;
+    size_t toom3;
+    size_t ntt;
+} mul_dispatch;
+
+/* r[0, n) = a + b, 返回进位; r 可与 a 或 b 相同 */
+static u64 limb_add_n(u64* r, const u64* a, const u64* b, size_t n) {
+    u64 cy = 0;
+    for (size_t ii = 0; ii < n; ii++) {
+        u64 sum = a[ii] + cy;
+        cy = (sum < cy);
+        r[ii] = sum + b[ii];
+        cy += (r[ii] < sum);
+    }
+    return cy;
+}
+
+/* r[0, n) = a - b, 返回借位; r 可与 a 或 b 相同 */
+static u64 limb_sub_n(u64* r, const u64* a, const u64* b, size_t n) {
+    u64 bw = 0;
+    for (size_t ii = 0; ii < n; ii++) {
+        u64 diff = a[ii] - b[ii], bw1 = (a[ii] < b[ii]);
+        r[ii] = diff - bw;
+        bw = bw1 + (diff < bw);
+    }
+    return bw;
+}
+
+/* r[0, n) += cy, 返回溢出 */
+static u64 limb_add_1(u64* r, size_t n, u64 cy) {
+    for (size_t ii = 0; ii < n && cy != 0; ii++) {
+        r[ii] += cy;
+        cy = (r[ii] < cy);
+    }
+    return cy;
+}
+
+/* r[0, an) = a[0, an) +- b[0, bn), an >= bn, r 可与 a 相同 */
+static u64 limb_add(u64* r, const u64* a, size_t an, const u64* b, size_t bn) {
+    u64 cy = limb_add_n(r, a, b, bn);
+    if (r != a) {
+        memcpy(r + bn, a + bn, (an - bn) * sizeof(u64));
+    }
+    return limb_add_1(r + bn, an - bn, cy);
+}
+
+static u64 limb_sub(u64* r, const u64* a, size_t an, const u64* b, size_t bn) {
+    u64 bw = limb_sub_n(r, a, b, bn);
+    for (size_t ii = bn; ii < an; ii++) {
+        u64 val = a[ii];
+        r[ii] = val - bw;
+        bw = (val < bw);
+    }
+    return bw;
+}
+
+/* r[0, an) = |a - b|, an >= bn, 返回 a < b */
+static bool limb_absdiff(u64* r, const u64* a, size_t an, const u64* b, size_t bn) {
+    size_t top = an;
+    while (top > bn && a[top - 1] == 0) {
+        top--;
+    }
+    bool less = false;
+    if (top == bn) {
+        while (top > 0 && a[top - 1] == b[top - 1]) {
+            top--;
+        }
+        less = (top > 0 && a[top - 1] < b[top - 1]);
+    }
+    if (!less) {
+        limb_sub(r, a, an, b, bn);
+        return false;
+    }
+    limb_sub_n(r, b, a, bn);
+    memset(r + bn, 0, (an - bn) * sizeof(u64));
+    return true;
+}
+
+/* r[0, n) 左移 / 右移 cnt (1 ~ 63) 位, 返回移出的部分 */
+static u64 limb_lshift(u64* r, size_t n, unsigned cnt) {
+    u64 out = 0;
+    for (size_t ii = 0; ii < n; ii++) {
+        u64 val = r[ii];
+        r[ii] = (val << cnt) | out;
+        out = val >> (64 - cnt);
+    }
+    return out;
+}
+
+static void limb_rshift(u64* r, size_t n, unsigned cnt) {
+    for (size_t ii = 0; ii + 1 < n; ii++) {
+        r[ii] = (r[ii] >> cnt) | (r[ii + 1] << (64 - cnt));
+    }
+    r[n - 1] >>= cnt;
+}
+
+/* r[0, n) = a / 3, a 必须能被 3 整除 (按 2^64 进制的 Hensel 除法) */
+static void limb_divexact_by3(u64* r, const u64* a, size_t n) {
+    u64 bw = 0;
+    for (size_t ii = 0; ii < n; ii++) {
+        u64 val = a[ii], low = val - bw;
+        bw = (low > val);
+        u64 q = low * 0xAAAAAAAAAAAAAAABull;
+        r[ii] = q;
+        bw += (q >= 0x5555555555555556ull) + (q >= 0xAAAAAAAAAAAAAAABull);
+    }
+}
+
+/* r[0, n) += a[0, n) * b, 返回最高字 */
+static u64 limb_addmul_1(u64* r, const u64* a, size_t n, u64 b) {
+    u64 cy = 0;
+    for (size_t ii = 0; ii < n; ii++) {
+        u128 prod = {0, 0};
+        _u128mul(prod, a[ii], b);
+        _u128add64(prod, prod, cy);
+        _u128add64(prod, prod, r[ii]);
+        r[ii] = prod[0];
+        cy = prod[1];
+    }
+    return cy;
+}
+
+/* r[0, an + bn) = a * b, r 不与输入重叠 */
+static void limb_mul_basecase(u64* r, const u64* a, size_t an, const u64* b, size_t bn) {
+    memset(r, 0, an * sizeof(u64));
+    for (size_t jj = 0; jj < bn; jj++) {
+        r[an + jj] = limb_addmul_1(r + jj, a, an, b[jj]);
+    }
+}
+
+/* limb_mul_n 需要的 ws 长度, 与下面的递归一一对应 */
+static size_t limb_mul_n_scratch(const mul_dispatch* md, size_t n) {
+    if (n < md->kara || n < 2) {
+        return 0;
+    }
+    if (n < md->toom3 || n < 9) {
+        size_t l = n - n / 2;
+        return 4 * l + limb_mul_n_scratch(md, l);
+    }
+    size_t k = (n + 2) / 3;
+    return 12 * (k + 1) + limb_mul_n_scratch(md, k + 1);
+}
+
+static void limb_mul_n(const mul_dispatch* md, u64* r, const u64* a, const u64* b, size_t n, u64* ws);
+
+/*
+ * Karatsuba: a = a0 + a1 * B^l, a0 为 l 个字, a1 为 h = n - l 个字.
+ * mid = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1), 由 |a0 - a1| |b0 - b1| 与符号得到
+ */
+static void limb_kara(const mul_dispatch* md, u64* r, const u64* a, const u64* b, size_t n, u64* ws) {
+    const size_t h = n / 2, l = n - h;
+    u64 *da = ws, *db = ws + l, *zm = ws + 2 * l, *next = ws + 4 * l;
+    bool neg = limb_absdiff(da, a, l, a + l, h);
+    neg ^= limb_absdiff(db, b, l, b + l, h);
+    limb_mul_n(md, zm, da, db, l, next);
+    limb_mul_n(md, r, a, b, l, next);
+    limb_mul_n(md, r + 2 * l, a + l, b + l, h, next);
+
+    u64* mid = ws; // da / db 已用完
+    u64 top = limb_add(mid, r, 2 * l, r + 2 * l, 2 * h);
+    if (neg) {
+        top += limb_add_n(mid, mid, zm, 2 * l);
+    } else {
+        top -= limb_sub_n(mid, mid, zm, 2 * l);
+    }
+    top += limb_add_n(r + l, r + l, mid, 2 * l);
+    limb_add_1(r + 3 * l, 2 * n - 3 * l, top);
+}
 
-#ifndef CACHE_LINE_SIZE
-#define CACHE_LINE_SIZE 64
-#endif
+/*
+ * Toom-3, 取值点 0, 1, -1, 2, inf: a = a0 + a1 X + a2 X^2, X = B^k, a2 为 s = n - 2k 个字.
+ * 求值为 k + 1 个字, 乘积与插值在 w = 2k + 2 个字内进行, 除 -1 处的乘积外所有中间量非负.
+ *   t1 = (r1 - rm) / 2 = c1 + c3,  c2 = r1 - t1 - c0 - c4,
+ *   u = (r2 - c0 - 4 (c2 + 4 c4)) / 2 = c1 + 4 c3,  c3 = (u - t1) / 3,  c1 = t1 - c3
+ */
+static void limb_toom3(const mul_dispatch* md, u64* r, const u64* a, const u64* b, size_t n, u64* ws) {
+    const size_t k = (n + 2) / 3, s = n - 2 * k, k1 = k + 1, w = 2 * k + 2;
+    u64 *ea1 = ws, *eam = ws + k1, *ea2 = ws + 2 * k1;
+    u64 *eb1 = ws + 3 * k1, *ebm = ws + 4 * k1, *eb2 = ws + 5 * k1;
+    u64 *w1 = ws + 6 * k1, *wm = w1 + w, *w2 = wm + w, *next = w2 + w;
+    bool neg = false;
+    for (int side = 0; side < 2; side++) {
+        const u64* x = side ? b : a;
+        u64 *e1 = side ? eb1 : ea1, *em = side ? ebm : eam, *e2 = side ? eb2 : ea2;
+        e1[k] = limb_add(e1, x, k, x + 2 * k, s);          // a0 + a2
+        neg ^= limb_absdiff(em, e1, k1, x + k, k);         // |a0 - a1 + a2|
+        e1[k] += limb_add_n(e1, e1, x + k, k);             // a0 + a1 + a2
+        memcpy(e2, x + 2 * k, s * sizeof(u64));            // (2 a2 + a1) * 2 + a0
+        memset(e2 + s, 0, (k1 - s) * sizeof(u64));
+        limb_lshift(e2, k1, 1);
+        limb_add(e2, e2, k1, x + k, k);
+        limb_lshift(e2, k1, 1);
+        limb_add(e2, e2, k1, x, k);
+    }
+    limb_mul_n(md, w1, ea1, eb1, k1, next);
+    limb_mul_n(md, wm, eam, ebm, k1, next);
+    limb_mul_n(md, w2, ea2, eb2, k1, next);
+    limb_mul_n(md, r, a, b, k, next);                           // c0 -> r[0, 2k)
+    limb_mul_n(md, r + 4 * k, a + 2 * k, b + 2 * k, s, next);   // c4 -> r[4k, 2n)
+    const u64 *c0 = r, *c4 = r + 4 * k;
+
+    if (neg) { // t1 -> wm
+        limb_add_n(wm, w1, wm, w);
+    } else {
+        limb_sub_n(wm, w1, wm, w);
+    }
+    limb_rshift(wm, w, 1);
+    limb_sub_n(w1, w1, wm, w); // c2 -> w1
+    limb_sub(w1, w1, w, c0, 2 * k);
+    limb_sub(w1, w1, w, c4, 2 * s);
+    u64* v = ws; // 求值已用完, 4 (c2 + 4 c4)
+    memcpy(v, c4, 2 * s * sizeof(u64));
+    memset(v + 2 * s, 0, (w - 2 * s) * sizeof(u64));
+    limb_lshift(v, w, 2);
+    limb_add_n(v, v, w1, w);
+    limb_lshift(v, w, 2);
+    limb_sub(w2, w2, w, c0, 2 * k); // u -> w2
+    limb_sub_n(w2, w2, v, w);
+    limb_rshift(w2, w, 1);
+    limb_sub_n(w2, w2, wm, w); // c3 -> w2
+    limb_divexact_by3(w2, w2, w);
+    limb_sub_n(wm, wm, w2, w); // c1 -> wm
+
+    memset(r + 2 * k, 0, 2 * k * sizeof(u64));
+    const u64* mids[3] = {wm, w1, w2};
+    for (size_t jj = 1; jj <= 3; jj++) {
+        size_t off = jj * k, len = (w < 2 * n - off) ? w : 2 * n - off;
+        limb_add(r + off, r + off, 2 * n - off, mids[jj - 1], len);
+    }
+}
 
-#define ALIGNED_MALLOC(_ptr, _type, _len)                                                             \
-    do {                                                                                              \
-        size_t elem_size__ = sizeof(_type);                                                           \
-        size_t total_size__ = (_len) * elem_size__;                                                   \
-        (_ptr) = (total_size__ == 0) ? NULL : (_type*)_aligned_malloc(total_size__, CACHE_LINE_SIZE); \
-    } while (0)
+/* r[0, 2n) = a[0, n) * b[0, n), ws 至少 limb_mul_n_scratch(n) 个字 */
+static void limb_mul_n(const mul_dispatch* md, u64* r, const u64* a, const u64* b, size_t n, u64* ws) {
+    if (n < md->kara || n < 2) {
+        limb_mul_basecase(r, a, n, b, n);
+    } else if (n < md->toom3 || n < 9) {
+        limb_kara(md, r, a, b, n, ws);
+    } else {
+        limb_toom3(md, r, a, b, n, ws);
+    }
+}
 
-#define ALIGNED_FREE(_ptr)       \
-    do {                         \
-        if ((_ptr) != NULL) {    \
-            _aligned_free(_ptr); \
-            (_ptr) = NULL;       \
-        }                        \
-    } while (0)
+/* 不均衡时按 bn 个字切分 a, 余下的一段递归 (余数序列每两步至少减半) */
+static size_t limb_mul_scratch(const mul_dispatch* md, size_t bn) { return 8 * bn + limb_mul_n_scratch(md, bn); }
 
-#define define_conv_rec(_i)                                                                                            \
-    void conv_rec_##_i(mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, bool norm) {           \
-        assert(in1 != NULL && in2 != NULL && out != NULL && table != NULL);                                            \
-        assert(in1 != in2);                                                                                            \
-        if (ntt_len <= long_threshold) {                                                                               \
-            dif_func(in1, table, ntt_len, _i);                                                                         \
-            dif_func(in2, table, ntt_len, _i);                                                                         \
-            if (norm) {                                                                                                \
-                mont64 inv_len = ntt_len;                                                                              \
-                _mont_tomont_func(inv_len, _i);                                                                        \
-                inv_len = _mont_qpow_func_name(_i)(inv_len, ((g_mod(_i)) - 2));                                        \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                                              \
-                    _mont_mul_func(out[ii], in1[ii], in2[ii], _i);                                                     \
-                    _mont_mulinto_func(out[ii], inv_len, _i);                                                          \
-                }                                                                                                      \
-            } else {                                                                                                   \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                                              \
-                    _mont_mul_func(out[ii], in1[ii], in2[ii], _i);                                                     \
-                }                                                                                                      \
-            }                                                                                                          \
-            idit_func(out, table, ntt_len, _i);                                                                        \
-            return;                                                                                                    \
-        }                                                                                                              \
-        const size_t quarter_len = ntt_len / 4;                                                                        \
-        mont64 unit_omega1 = g_root(_i);                                                                               \
-        _mont_tomont_func(unit_omega1, _i);                                                                            \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);                                \
-        mont64 unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                                                 \
-        mont64 omega1 = g_one(_i), omega3 = g_one(_i);                                                                 \
-        for (size_t ii = 0; ii < quarter_len; ii++) {                                                                  \
-            mont64 temp0 = in1[ii], temp1 = in1[quarter_len + ii];                                                     \
-            mont64 temp2 = in1[quarter_len * 2 + ii], temp3 = in1[quarter_len * 3 + ii];                               \
-            _dif_butterfly244(temp0, temp1, temp2, temp3, _i);                                                         \
-            in1[ii] = temp0, in1[quarter_len + ii] = temp1;                                                            \
-            _mont_mul_func(in1[quarter_len * 2 + ii], temp2, omega1, _i);                                              \
-            _mont_mul_func(in1[quarter_len * 3 + ii], temp3, omega3, _i);                                              \
-            temp0 = in2[ii], temp1 = in2[quarter_len + ii];                                                            \
-            temp2 = in2[quarter_len * 2 + ii], temp3 = in2[quarter_len * 3 + ii];                                      \
-            _dif_butterfly244(temp0, temp1, temp2, temp3, _i);                                                         \
-            in2[ii] = temp0, in2[quarter_len + ii] = temp1;                                                            \
-            _mont_mul_func(in2[quarter_len * 2 + ii], temp2, omega1, _i);                                              \
-            _mont_mul_func(in2[quarter_len * 3 + ii], temp3, omega3, _i);                                              \
-            _mont_mulinto_func(omega1, unit_omega1, _i);                                                               \
-            _mont_mulinto_func(omega3, unit_omega3, _i);                                                               \
-        }                                                                                                              \
-        conv_rec_##_i(in1, in2, out, table, ntt_len / 2, false);                                                       \
-        conv_rec_##_i(in1 + quarter_len * 2, in2 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4, false); \
-        conv_rec_##_i(in1 + quarter_len * 3, in2 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4, false); \
-        unit_omega1 = g_rootinv(_i);                                                                                   \
-        _mont_tomont_func(unit_omega1, _i);                                                                            \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);                                \
-        unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                                                        \
-        if (norm) {                                                                                                    \
-            mont64 inv_len = ntt_len;                                                                                  \
-            _mont_tomont_func(inv_len, _i);                                                                            \
-            inv_len = _mont_qpow_func_name(_i)(inv_len, (g_mod(_i) - 2));                                              \
-            omega1 = inv_len, omega3 = inv_len;                                                                        \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                                              \
-                mont64 temp0, temp1, temp2, temp3;                                                                     \
-                _mont_mul_func(temp0, out[ii], inv_len, _i);                                                           \
-                _mont_mul_func(temp1, out[quarter_len + ii], inv_len, _i);                                             \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                                          \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                                          \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                                                    \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                                        \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;                                  \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                                           \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                                           \
-            }                                                                                                          \
-        } else {                                                                                                       \
-            omega1 = g_one(_i), omega3 = g_one(_i);                                                                    \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                                              \
-                mont64 temp0 = out[ii], temp1 = out[quarter_len + ii], temp2, temp3;                                   \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                                          \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                                          \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                                                    \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                                        \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;                                  \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                                           \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                                           \
-            }                                                                                                          \
-        }                                                                                                              \
-    }
-
-#define define_conv_single(_i)                                                                                        \
-    void conv_single_##_i(const mont64* in1, mont64* in2, mont64* out, ntt_short* table, size_t ntt_len, bool norm) { \
-        assert(in1 != NULL && in2 != NULL && out != NULL && table != NULL);                                           \
-        assert(in1 != in2);                                                                                           \
-        if (ntt_len <= long_threshold) {                                                                              \
-            dif_func(in2, table, ntt_len, _i);                                                                        \
-            if (norm) {                                                                                               \
-                mont64 inv_len = ntt_len;                                                                             \
-                _mont_tomont_func(inv_len, _i);                                                                       \
-                inv_len = _mont_qpow_func_name(_i)(inv_len, ((g_mod(_i)) - 2));                                       \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                                             \
-                    _mont_mul_func(out[ii], in1[ii], in2[ii], _i);                                                    \
-                    _mont_mulinto_func(out[ii], inv_len, _i);                                                         \
-                }                                                                                                     \
-            } else {                                                                                                  \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                                             \
-                    _mont_mul_func(out[ii], in1[ii], in2[ii], _i);                                                    \
-                }                                                                                                     \
-            }                                                                                                         \
-            idit_func(out, table, ntt_len, _i);                                                                       \
-            return;                                                                                                   \
-        }                                                                                                             \
-        const size_t quarter_len = ntt_len / 4;                                                                       \
-        mont64 unit_omega1 = g_root(_i);                                                                              \
-        _mont_tomont_func(unit_omega1, _i);                                                                           \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);                               \
-        mont64 unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                                                \
-        mont64 omega1 = g_one(_i), omega3 = g_one(_i);                                                                \
-        for (size_t ii = 0; ii < quarter_len; ii++) {                                                                 \
-            mont64 temp0 = in2[ii], temp1 = in2[quarter_len + ii];                                                    \
-            mont64 temp2 = in2[quarter_len * 2 + ii], temp3 = in2[quarter_len * 3 + ii];                              \
-            _dif_butterfly244(temp0, temp1, temp2, temp3, _i);                                                        \
-            in2[ii] = temp0, in2[quarter_len + ii] = temp1;                                                           \
-            _mont_mul_func(in2[quarter_len * 2 + ii], temp2, omega1, _i);                                             \
-            _mont_mul_func(in2[quarter_len * 3 + ii], temp3, omega3, _i);                                             \
-            _mont_mulinto_func(omega1, unit_omega1, _i);                                                              \
-            _mont_mulinto_func(omega3, unit_omega3, _i);                                                              \
-        }                                                                                                             \
-        conv_single_##_i(in1, in2, out, table, ntt_len / 2, false);                                                   \
-        conv_single_##_i(in1 + quarter_len * 2, in2 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4,     \
-                         false);                                                                                      \
-        conv_single_##_i(in1 + quarter_len * 3, in2 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4,     \
-                         false);                                                                                      \
-        unit_omega1 = g_rootinv(_i);                                                                                  \
-        _mont_tomont_func(unit_omega1, _i);                                                                           \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);                               \
-        unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                                                       \
-        if (norm) {                                                                                                   \
-            mont64 inv_len = ntt_len;                                                                                 \
-            _mont_tomont_func(inv_len, _i);                                                                           \
-            inv_len = _mont_qpow_func_name(_i)(inv_len, (g_mod(_i) - 2));                                             \
-            omega1 = inv_len, omega3 = inv_len;                                                                       \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                                             \
-                mont64 temp0, temp1, temp2, temp3;                                                                    \
-                _mont_mul_func(temp0, out[ii], inv_len, _i);                                                          \
-                _mont_mul_func(temp1, out[quarter_len + ii], inv_len, _i);                                            \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                                         \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                                         \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                                                   \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                                       \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;                                 \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                                          \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                                          \
-            }                                                                                                         \
-        } else {                                                                                                      \
-            omega1 = g_one(_i), omega3 = g_one(_i);                                                                   \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                                             \
-                mont64 temp0 = out[ii], temp1 = out[quarter_len + ii], temp2, temp3;                                  \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                                         \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                                         \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                                                   \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                                       \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;                                 \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                                          \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                                          \
-            }                                                                                                         \
-        }                                                                                                             \
-    }
-
-#define define_conv_sqr(_i)                                                                     \
-    void conv_sqr_##_i(mont64* in1, mont64* out, ntt_short* table, size_t ntt_len, bool norm) { \
-        assert(in1 != NULL && out != NULL && table != NULL);                                    \
-        if (ntt_len <= long_threshold) {                                                        \
-            dif_func(in1, table, ntt_len, _i);                                                  \
-            if (norm) {                                                                         \
-                mont64 inv_len = ntt_len;                                                       \
-                _mont_tomont_func(inv_len, _i);                                                 \
-                inv_len = _mont_qpow_func_name(_i)(inv_len, ((g_mod(_i)) - 2));                 \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                       \
-                    _mont_mul_func(out[ii], in1[ii], in1[ii], _i);                              \
-                    _mont_mulinto_func(out[ii], inv_len, _i);                                   \
-                }                                                                               \
-            } else {                                                                            \
-                for (size_t ii = 0; ii < ntt_len; ii++) {                                       \
-                    _mont_mul_func(out[ii], in1[ii], in1[ii], _i);                              \
-                }                                                                               \
-            }                                                                                   \
-            idit_func(out, table, ntt_len, _i);                                                 \
-            return;                                                                             \
-        }                                                                                       \
-        const size_t quarter_len = ntt_len / 4;                                                 \
-        mont64 unit_omega1 = g_root(_i);                                                        \
-        _mont_tomont_func(unit_omega1, _i);                                                     \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);         \
-        mont64 unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                          \
-        mont64 omega1 = g_one(_i), omega3 = g_one(_i);                                          \
-        for (size_t ii = 0; ii < quarter_len; ii++) {                                           \
-            mont64 temp0 = in1[ii], temp1 = in1[quarter_len + ii];                              \
-            mont64 temp2 = in1[quarter_len * 2 + ii], temp3 = in1[quarter_len * 3 + ii];        \
-            _dif_butterfly244(temp0, temp1, temp2, temp3, _i);                                  \
-            in1[ii] = temp0, in1[quarter_len + ii] = temp1;                                     \
-            _mont_mul_func(in1[quarter_len * 2 + ii], temp2, omega1, _i);                       \
-            _mont_mul_func(in1[quarter_len * 3 + ii], temp3, omega3, _i);                       \
-            _mont_mulinto_func(omega1, unit_omega1, _i);                                        \
-            _mont_mulinto_func(omega3, unit_omega3, _i);                                        \
-        }                                                                                       \
-        conv_sqr_##_i(in1, out, table, ntt_len / 2, false);                                     \
-        conv_sqr_##_i(in1 + quarter_len * 2, out + quarter_len * 2, table, ntt_len / 4, false); \
-        conv_sqr_##_i(in1 + quarter_len * 3, out + quarter_len * 3, table, ntt_len / 4, false); \
-        unit_omega1 = g_rootinv(_i);                                                            \
-        _mont_tomont_func(unit_omega1, _i);                                                     \
-        unit_omega1 = _mont_qpow_func_name(_i)(unit_omega1, (g_mod(_i) - 1) / ntt_len);         \
-        unit_omega3 = _mont_qpow_func_name(_i)(unit_omega1, 3);                                 \
-        if (norm) {                                                                             \
-            mont64 inv_len = ntt_len;                                                           \
-            _mont_tomont_func(inv_len, _i);                                                     \
-            inv_len = _mont_qpow_func_name(_i)(inv_len, (g_mod(_i) - 2));                       \
-            omega1 = inv_len, omega3 = inv_len;                                                 \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                       \
-                mont64 temp0, temp1, temp2, temp3;                                              \
-                _mont_mul_func(temp0, out[ii], inv_len, _i);                                    \
-                _mont_mul_func(temp1, out[quarter_len + ii], inv_len, _i);                      \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                   \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                   \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                             \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                 \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;           \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                    \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                    \
-            }                                                                                   \
-        } else {                                                                                \
-            omega1 = g_one(_i), omega3 = g_one(_i);                                             \
-            for (size_t ii = 0; ii < quarter_len; ii++) {                                       \
-                mont64 temp0 = out[ii], temp1 = out[quarter_len + ii], temp2, temp3;            \
-                _mont_mul_func(temp2, out[quarter_len * 2 + ii], omega1, _i);                   \
-                _mont_mul_func(temp3, out[quarter_len * 3 + ii], omega3, _i);                   \
-                _idit_butterfly244(temp0, temp1, temp2, temp3, _i);                             \
-                out[ii] = temp0, out[quarter_len + ii] = temp1;                                 \
-                out[quarter_len * 2 + ii] = temp2, out[quarter_len * 3 + ii] = temp3;           \
-                _mont_mulinto_func(omega1, unit_omega1, _i);                                    \
-                _mont_mulinto_func(omega3, unit_omega3, _i);                                    \
-            }                                                                                   \
-        }                                                                                       \
-    }
-
-define_conv_rec(1) define_conv_rec(2) define_conv_rec(3) 
-define_conv_single(1) define_conv_single(2) define_conv_single(3)
-define_conv_sqr(1) define_conv_sqr(2) define_conv_sqr(3)
+/* r[0, an + bn) = a * b, an >= bn >= 1, r 不与输入重叠, ws 至少 limb_mul_scratch(bn) 个字 */
+static void limb_mul(const mul_dispatch* md, u64* r, const u64* a, size_t an, const u64* b, size_t bn, u64* ws) {
+    if (bn < md->kara) {
+        limb_mul_basecase(r, a, an, b, bn);
+        return;
+    }
+    limb_mul_n(md, r, a, b, bn, ws);
+    u64 *tmp = ws, *next = ws + 2 * bn;
+    size_t off = bn;
+    for (; off + bn <= an; off += bn) {
+        limb_mul_n(md, tmp, a + off, b, bn, next);
+        u64 cy = limb_add_n(r + off, r + off, tmp, bn);
+        memcpy(r + off + bn, tmp + bn, bn * sizeof(u64));
+        limb_add_1(r + off + bn, bn, cy);
+    }
+    if (off < an) {
+        size_t rem = an - off;
+        limb_mul(md, tmp, b, bn, a + off, rem, next);
+        u64 cy = limb_add_n(r + off, r + off, tmp, bn);
+        memcpy(r + off + bn, tmp + bn, rem * sizeof(u64));
+        limb_add_1(r + off + bn, rem, cy);
+    }
+}
 
-#define conv_rec_func(in1, in2, out, table, ntt_len, _i) conv_rec_##_i(in1, in2, out, table, ntt_len, true)
-#define conv_sqr_func(in1, out, table, ntt_len, _i) conv_sqr_##_i(in1, out, table, ntt_len, true)
-#define conv_single_func(in1, in2, out, table, ntt_len, _i) conv_single_##_i(in1, in2, out, table, ntt_len, true)
+/*
+ * 不均衡乘法: 长的一方按 chunk = L - len_short + 1 个字切片, 短的一方在长度 L 下只做一次正变换 (mul_operand),
+ * 每片与其做一次 conv_single, 部分积在重叠的 len_short 个字上相加. 内存为 O(L), L 取 O(len_short).
+ */
+#define UNBAL_MIN_RATIO 16 // 长度比小于此值时直接用 abs_mul64
+#define UNBAL_MAX_SCALE 8 // L <= UNBAL_MAX_SCALE * ceil2(len_short)
+
+/* 在 2 的幂中选 L, 每个输出字的开销按 L * log2(L) / chunk 估计 */
+static u64 unbal_ntt_len(u64 len_long, u64 len_short) {
+    u64 best_len = 0, cap = int_ceil2(len_short) * UNBAL_MAX_SCALE, full = int_ceil2(len_long + len_short - 1);
+    double best = 0;
+    for (u64 len = int_ceil2(len_short + 1); len <= cap && len <= full; len *= 2) {
+        double cost = (double)len * log2_64(len) / (double)(len - len_short + 1);
+        if (best_len == 0 || cost < best) {
+            best = cost, best_len = len;
+        }
+    }
+    return best_len;
+}
 
+/* 与 abs_mul64 结果相同, 长度比至少为 UNBAL_MIN_RATIO 时按切片计算 */
+void abs_mul64_unbal(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    assert(in1 != NULL && in2 != NULL && out != NULL);
+    const u64 *a = in1, *b = in2;
+    u64 len_long = len1, len_short = len2;
+    if (len_long < len_short) {
+        a = in2, b = in1, len_long = len2, len_short = len1;
+    }
+    u64 ntt_len = unbal_ntt_len(len_long, len_short);
+    if (len_long < len_short * UNBAL_MIN_RATIO || ntt_len == 0 || ntt_len >= int_ceil2(len_long + len_short - 1)) {
+        abs_mul64((u64*)in1, len1, (u64*)in2, len2, out);
+        return;
+    }
+    const u64 chunk = ntt_len - len_short + 1;
+
+    mul_operand* op = mul_operand_precompute(b, len_short, ntt_len);
+    mont64* buf[3] = {NULL, NULL, NULL};
+    u64* tmp = (u64*)malloc((chunk + len_short) * sizeof(u64));
+    bool failed = (op == NULL || tmp == NULL);
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_MALLOC(buf[jj], mont64, ntt_len);
+        failed = failed || (buf[jj] == NULL);
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
 
-u64 int_ceil2(u64 n) {
-    const int bits = 64;
-    n--;
-    for (int i = 1; i < bits; i *= 2) {
-        n |= (n >> i);
+    /* out[0, off + len_short) 为已完成的部分积, 新的一片从 off 开始 */
+    for (u64 off = 0; off < len_long; off += chunk) {
+        u64 len = (len_long - off < chunk) ? len_long - off : chunk;
+        if (off == 0) {
+            operand_mul_run(op, a, len, buf, out);
+            continue;
+        }
+        operand_mul_run(op, a + off, len, buf, tmp);
+        u64 cy = limb_add_n(out + off, out + off, tmp, len_short);
+        memcpy(out + off + len_short, tmp + len_short, len * sizeof(u64));
+        limb_add_1(out + off + len_short, len, cy);
     }
-    return n + 1;
+
+    for (int jj = 0; jj < 3; jj++) {
+        ALIGNED_FREE(buf[jj]);
+    }
+    free(tmp);
+    mul_operand_destroy(&op);
 }
 
-void abs_mul64(u64* in1, u64 len1, u64* in2, u64 len2, u64* out) {
+#define LIMB_STACK_WS 4096
+
+/* abs_mul64_auto 的主体, 按 md 中的阈值分派 */
+static void mul_auto_run(const mul_dispatch* md, const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    const u64 *a = in1, *b = in2;
+    size_t an = len1, bn = len2;
+    if (an < bn) {
+        a = in2, b = in1, an = len2, bn = len1;
+    }
+    if (bn >= md->ntt) {
+        if (in1 == in2 && len1 == len2) {
+            abs_sqr64((u64*)in1, len1, out);
+        } else {
+            abs_mul64_unbal(in1, len1, in2, len2, out);
+        }
+        return;
+    }
+    u64 stack_ws[LIMB_STACK_WS];
+    size_t ws_len = limb_mul_scratch(md, bn);
+    u64* ws = (ws_len <= LIMB_STACK_WS) ? stack_ws : (u64*)malloc(ws_len * sizeof(u64));
+    if (ws == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    limb_mul(md, out, a, an, b, bn, ws);
+    if (ws != stack_ws) {
+        free(ws);
+    }
+}
+
+/* 与 abs_mul64 结果相同, 按长度选择算法. in1 == in2 且 len1 == len2 时大规模部分走平方 */
+void abs_mul64_auto(const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
     assert(in1 != NULL && in2 != NULL && out != NULL);
-    assert(in1 != in2);
-    u64 out_len = len1 + len2, conv_len = out_len - 1;
-    u64 ntt_len = int_ceil2(conv_len);
+    const mul_dispatch md = {mul_karatsuba_threshold, mul_toom3_threshold, mul_ntt_threshold};
+    mul_auto_run(&md, in1, len1, in2, len2, out);
+}
 
-    mont64* buf1_mont, *buf2_mont, *buf3_mont, *tmp_mont;
-    ALIGNED_MALLOC(buf1_mont, mont64, ntt_len);
-    ALIGNED_MALLOC(buf2_mont, mont64, ntt_len);
-    ALIGNED_MALLOC(buf3_mont, mont64, ntt_len);
-    ALIGNED_MALLOC(tmp_mont, mont64, ntt_len);
+#define MUL_TUNE_MAX 8192
+
+/* 一次乘法的最短时间 (ns), 每轮至少 2 ms */
+static double mul_tune_time(const mul_dispatch* md, const u64* a, const u64* b, size_t n, u64* out) {
+    double best = 1e300;
+    for (int rr = 0; rr < 3; rr++) {
+        struct timespec ts;
+        timespec_get(&ts, TIME_UTC);
+        double start = (double)ts.tv_sec * 1e9 + ts.tv_nsec, elapsed;
+        size_t calls = 0;
+        do {
+            mul_auto_run(md, a, n, b, n, out);
+            calls++;
+            timespec_get(&ts, TIME_UTC);
+            elapsed = (double)ts.tv_sec * 1e9 + ts.tv_nsec - start;
+        } while (elapsed < 2e6);
+        best = (elapsed / calls < best) ? elapsed / calls : best;
+    }
+    return best;
+}
 
-    if (buf1_mont == NULL || buf2_mont == NULL || buf3_mont == NULL || tmp_mont == NULL) {
+/*
+ * 在 [from, MUL_TUNE_MAX] 中找 *threshold = n 比 n + 1 快且连续两次成立的最小 n, 找不到时为 SIZE_MAX.
+ * threshold 指向 md 中的一项
+ */
+static size_t mul_tune_one(mul_dispatch* md, size_t* threshold, size_t from, const u64* a, const u64* b, u64* out) {
+    size_t found = SIZE_MAX, wins = 0;
+    for (size_t n = from; n <= MUL_TUNE_MAX && wins < 2; n += n / 8 + 1) {
+        *threshold = n + 1;
+        double t_old = mul_tune_time(md, a, b, n, out);
+        *threshold = n;
+        double t_new = mul_tune_time(md, a, b, n, out);
+        if (t_new < t_old) {
+            found = (wins++ == 0) ? n : found;
+        } else {
+            wins = 0;
+        }
+    }
+    *threshold = (wins >= 2) ? found : SIZE_MAX;
+    return *threshold;
+}
+
+/*
+ * 在本机上依次测出 Karatsuba, Toom-3, NTT 的交叉点并写入对应的全局阈值, 耗时约数秒.
+ * 计时只用局部的一份阈值, 结束时一次写入全局, 此时不应有其他线程在做乘法
+ */
+void mul_dispatch_tune(void) {
+    u64 *a = (u64*)malloc(MUL_TUNE_MAX * sizeof(u64)), *b = (u64*)malloc(MUL_TUNE_MAX * sizeof(u64));
+    u64* out = (u64*)malloc(MUL_TUNE_MAX * 2 * sizeof(u64));
+    if (a == NULL || b == NULL || out == NULL) {
         fprintf(stderr, "Memory allocation failed.\n");
         abort();
     }
+    for (size_t ii = 0; ii < MUL_TUNE_MAX; ii++) {
+        a[ii] = ~ii * 0x9E3779B97F4A7C15ull, b[ii] = ii * 0xC2B2AE3D27D4EB4Full;
+    }
+    mul_dispatch md = {mul_karatsuba_threshold, SIZE_MAX, SIZE_MAX};
+    size_t kara = mul_tune_one(&md, &md.kara, 4, a, b, out);
+    mul_tune_one(&md, &md.toom3, (kara > 9 && kara != SIZE_MAX) ? kara : 9, a, b, out);
+    mul_tune_one(&md, &md.ntt, 64, a, b, out);
+    mul_karatsuba_threshold = md.kara;
+    mul_toom3_threshold = md.toom3;
+    mul_ntt_threshold = md.ntt;
+    free(a);
+    free(b);
+    free(out);
+}
+
+/*
+ * 用第一个模数比较长度 ntt_len (2 的幂, > long_threshold) 的四步法与 dif244 顶层加子卷积, 计时的是 abs_mul64 中
+ * radix 为 1 的卷积 (conv_head244 + conv_tail). 四步法更快时 ntt_four_step_threshold = ntt_len, 否则为 SIZE_MAX.
+ * 计时期间不改全局阈值 (子卷积按当前阈值), 只在最后写一次, 此时不应有其他线程在做乘法.
+ * 临时占用 2 * ntt_len 个字, 参数不合法, 四步法不适用或分配失败返回 -1
+ */
+int ntt_four_step_tune(size_t ntt_len) {
+    const size_t lg1 = four_step_split(ntt_len);
+    if (lg1 == 0 || (ntt_len & (ntt_len - 1)) != 0) {
+        return -1;
+    }
+    mont64 *a, *b;
+    ALIGNED_MALLOC(a, mont64, ntt_len);
+    ALIGNED_MALLOC(b, mont64, ntt_len);
+    if (a == NULL || b == NULL) {
+        ALIGNED_FREE(a);
+        ALIGNED_FREE(b);
+        return -1;
+    }
+    ntt_short* table = get_nttshort_func(log2_64(long_threshold), 1);
+    double best[2] = {1e300, 1e300};
+    for (int rr = 0; rr < 3; rr++) {
+        for (int fs = 0; fs < 2; fs++) {
+            for (size_t ii = 0; ii < ntt_len; ii++) {
+                a[ii] = (ii * 0x9E3779B97F4A7C15ull) % g_mod(1), b[ii] = (~ii * 0xC2B2AE3D27D4EB4Full) % g_mod(1);
+            }
+            struct timespec ts;
+            timespec_get(&ts, TIME_UTC);
+            double start = (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+            conv_tail tail;
+            conv_head244_1(a, b, a, table, ntt_len, ntt_len, ntt_len, true, fs ? lg1 : 0, &tail);
+            if (tail.seg != 0) {
+                conv_tail_1(a, &tail, 0, tail.seg);
+            }
+            timespec_get(&ts, TIME_UTC);
+            double elapsed = (double)ts.tv_sec * 1e9 + ts.tv_nsec - start;
+            best[fs] = (elapsed < best[fs]) ? elapsed : best[fs];
+        }
+    }
+    ntt_four_step_threshold = (best[1] < best[0]) ? ntt_len : SIZE_MAX;
+    ALIGNED_FREE(a);
+    ALIGNED_FREE(b);
+    return 0;
+}
 
-    ntt_short table;
-    table.ntt_len = (ntt_len < long_threshold) ? ntt_len : long_threshold;
-    table.log_len = log2_64(table.ntt_len);
-    //table.omega = g_a;
-    //table.iomega = g_b;
-    ALIGNED_MALLOC(table.omega, mont64, table.ntt_len);
-    ALIGNED_MALLOC(table.iomega, mont64, table.ntt_len);
+/*
+ * 模数个数按输入自适应: 卷积的每一项不超过 min(len1, len2) * 2^(bits1 + bits2), 取乘积超过该上界的最少的
+ * 前 k 个模数 (见 garner_bits). 32 位的字或 10^9 进制只需两个模数, 系数超过 64 位的多项式需要四个以上.
+ * 各模数的卷积复用 mod_job, 之后对 k 个模数做 Garner CRT.
+ */
+
+/* 每项系数不超过 bits1 / bits2 位, 较短一方 min_len 项, 返回所需的模数个数, 超过 NTT_MOD_MAX 时返回 0 */
+size_t ntt_mod_count(unsigned bits1, unsigned bits2, u64 min_len) {
+    u64 bound = (u64)bits1 + bits2 + log2_64(int_ceil2(min_len));
+    for (size_t mods = 1; mods <= NTT_MOD_MAX; mods++) {
+        if (bound <= garner_bits[mods]) {
+            return mods;
+        }
+    }
+    return 0;
+}
 
+/* 每个系数 words 个字 (小端), 按 acc = acc * 2^64 + w 逐字转为 Montgomery 形式, 并补零到 ntt_len */
+#define define_mont_load_wide(_i)                                                                   \
+    static void mont_load_wide_##_i(const u64* in, size_t words, u64 len, u64 ntt_len, mont64* out) { \
+        for (u64 ii = 0; ii < len; ii++) {                                                          \
+            mont64 acc = 0;                                                                         \
+            for (size_t ww = words; ww-- > 0;) {                                                    \
+                mont64 x = in[ii * words + ww];                                                     \
+                _mont_tomont_func(x, _i);                                                           \
+                _mont_mulinto_func(acc, g_r2(_i), _i);                                              \
+                acc += x;                                                                           \
+                acc = (acc < g_mod(_i)) ? acc : acc - g_mod(_i);                                    \
+            }                                                                                       \
+            out[ii] = acc;                                                                          \
+        }                                                                                           \
+        for (u64 ii = len; ii < ntt_len; ii++) {                                                    \
+            out[ii] = 0;                                                                            \
+        }                                                                                           \
+    }
 
-    for (size_t ii = len1; ii < ntt_len; ii++) {
-        buf1_mont[ii] = 0;
-        buf2_mont[ii] = 0;
-        buf3_mont[ii] = 0;
+define_mont_load_wide(1) define_mont_load_wide(2) define_mont_load_wide(3) define_mont_load_wide(4) define_mont_load_wide(5)
+
+typedef void (*mont_load_wide_func)(const u64*, size_t, u64, u64, mont64*);
+typedef void (*mulc_func)(const mont64*, u64*, u64, size_t);
+
+static const mont_load_wide_func mont_load_wide_funcs[NTT_MOD_MAX] = {mont_load_wide_1, mont_load_wide_2,
+                                                                      mont_load_wide_3, mont_load_wide_4,
+                                                                      mont_load_wide_5};
+static const mulc_func mulc_funcs[NTT_MOD_MAX] = {mulc_1, mulc_2, mulc_3, mulc_4, mulc_5};
+
+/*
+ * 前 mods 个模数下的卷积, 结果 (Montgomery 形式) 留在 buf[0, mods). words1 / words2 为每个系数的字数,
+ * 为 1 时由 mod_job 转换. in2 == NULL 时为平方, 否则 tmp[jj] 为 in2 的转换缓冲;
+ * par 有多个线程时各模数作为任务并行 (同 abs_conv64_run), 此时 tmp 不能共用.
+ */
+static void conv_mods(const u64* in1, u64 len1, size_t words1, const u64* in2, u64 len2, size_t words2, size_t mods,
+                      u64 ntt_len, mont64* const buf[], mont64* const tmp[], const conv_par* par) {
+    mod_job jobs[NTT_MOD_MAX];
+    for (size_t jj = 0; jj < mods; jj++) {
+        jobs[jj].in1 = in1;
+        jobs[jj].len1 = len1;
+        jobs[jj].in2 = in2;
+        jobs[jj].len2 = len2;
+        jobs[jj].buf = buf[jj];
+        jobs[jj].tmp = tmp[jj];
+        jobs[jj].ntt_len = ntt_len;
+        jobs[jj].table_log = log2_64((ntt_len < long_threshold) ? ntt_len : long_threshold);
+        jobs[jj].par = par;
+        jobs[jj].in1_ready = (words1 > 1);
+        jobs[jj].in2_ready = (in2 != NULL && words2 > 1);
+        jobs[jj].ms = 0;
+    }
+    bool parallel = (par != NULL && par->pool != NULL && par->pool->threads > 1);
+    for (size_t jj = 0; jj < mods; jj++) {
+        /* 多字系数在这里转换; 串行时 tmp 可能共用, 须紧挨着本模数的卷积 */
+        if (jobs[jj].in1_ready) {
+            mont_load_wide_funcs[jj](in1, words1, len1, ntt_len, buf[jj]);
+        }
+        if (jobs[jj].in2_ready) {
+            mont_load_wide_funcs[jj](in2, words2, len2, ntt_len, tmp[jj]);
+        }
+        if (!parallel) {
+            mod_job_funcs[jj](jobs + jj);
+        }
     }
-    for (size_t ii = 0; ii < len1; ii++) {
-        buf1_mont[ii] = in1[ii];
-        buf2_mont[ii] = in1[ii];
-        buf3_mont[ii] = in1[ii];
-        _mont_tomont_func(buf1_mont[ii], 1);
-        _mont_tomont_func(buf2_mont[ii], 2);
-        _mont_tomont_func(buf3_mont[ii], 3);
+    if (parallel) {
+        task_group group;
+        task_group_init(&group);
+        for (size_t jj = mods; jj-- > 1;) {
+            task_spawn(par->pool, &group, mod_job_funcs[jj], jobs + jj);
+        }
+        mod_job_funcs[0](jobs);
+        task_wait(par->pool, &group);
     }
+}
 
-    for (size_t ii = len2; ii < ntt_len; ii++) {
-        tmp_mont[ii] = 0;
+/* buf[0, mods) 的 [blk, blk + len) 算出混合进制数字, v[j] 为第 j 位 */
+static void garner_digits(mont64* const buf[], size_t mods, size_t blk, size_t len, u64 v[][CRT_CHUNK]) {
+    _Alignas(64) u64 t[CRT_CHUNK];
+    for (size_t jj = 0; jj < mods; jj++) {
+        mulc_funcs[jj](buf[jj] + blk, v[jj], garner_inv[jj], len);
+        for (size_t ii = 0; ii < jj; ii++) {
+            mulc_funcs[jj](v[ii], t, garner_coef[jj][ii], len);
+            for (size_t kk = 0; kk < len; kk++) {
+                u64 sum = v[jj][kk] + t[kk];
+                v[jj][kk] = (sum < garner_mod[jj]) ? sum : sum - garner_mod[jj];
+            }
+        }
     }
-    for (size_t ii = 0; ii < len2; ii++) {
-        tmp_mont[ii] = in2[ii];
-        _mont_tomont_func(tmp_mont[ii], 1);
+}
+
+/* val[0, mods) = sum_j v[j][kk] * p_0 ... p_{j-1}, 由最高位数字起按 Horner 计算 */
+INLINE void garner_combine(u64 v[][CRT_CHUNK], size_t mods, size_t kk, u64* val) {
+    val[0] = v[mods - 1][kk];
+    size_t words = 1;
+    for (size_t jj = mods - 1; jj-- > 0;) {
+        u64 carry = v[jj][kk];
+        for (size_t ww = 0; ww < words; ww++) {
+            u128 prod = {0, 0};
+            _u128mul(prod, val[ww], garner_mod[jj]);
+            _u128add64(prod, prod, carry);
+            val[ww] = prod[0];
+            carry = prod[1];
+        }
+        val[words++] = carry;
     }
+}
 
-    //clock_t start, end;
-    //double elapsed;
-    cover_nttshort_func(table.log_len, &table, 1);
-    
-    //start = clock();
-    conv_rec_func(buf1_mont, tmp_mont, buf1_mont, &table, ntt_len, 1);
-    //end = clock();
-    //elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    //printf("%.3f\n", elapsed);
+/*
+ * 系数卷积: in1 的每个系数占 ceil(bits1 / 64) 个字 (小端) 且不超过 bits1 位, in2 同理.
+ * out 为 len1 + len2 - 1 个系数, 每个占 ntt_mod_count(bits1, bits2, min(len1, len2)) 个字.
+ * 返回所用的模数个数, 参数不合法, 超出 NTT_MOD_MAX 个模数或分配失败时返回 -1.
+ */
+int abs_conv64_coef(const u64* in1, u64 len1, unsigned bits1, const u64* in2, u64 len2, unsigned bits2, u64* out) {
+    if (in1 == NULL || in2 == NULL || out == NULL || len1 == 0 || len2 == 0 || bits1 == 0 || bits2 == 0) {
+        return -1;
+    }
+    size_t mods = ntt_mod_count(bits1, bits2, (len1 < len2) ? len1 : len2);
+    if (mods == 0) {
+        return -1;
+    }
+    bool sqr = (in1 == in2 && len1 == len2 && bits1 == bits2);
+    u64 conv_len = len1 + len2 - 1, ntt_len = int_ceil2(conv_len);
+    mont64* buf[NTT_MOD_MAX + 1] = {NULL};
+    bool failed = false;
+    for (size_t jj = 0; jj < mods + (sqr ? 0 : 1); jj++) {
+        ALIGNED_MALLOC(buf[jj], mont64, ntt_len);
+        failed = failed || (buf[jj] == NULL);
+    }
+    if (!failed) {
+        mont64* tmp[NTT_MOD_MAX] = {buf[mods], buf[mods], buf[mods], buf[mods], buf[mods]};
+        conv_mods(in1, len1, (bits1 + 63) / 64, sqr ? NULL : in2, len2, (bits2 + 63) / 64, mods, ntt_len, buf, tmp,
+                  NULL);
+        _Alignas(64) u64 v[NTT_MOD_MAX][CRT_CHUNK];
+        for (u64 blk = 0; blk < conv_len; blk += CRT_CHUNK) {
+            size_t len = (conv_len - blk < CRT_CHUNK) ? conv_len - blk : CRT_CHUNK;
+            garner_digits(buf, mods, blk, len, v);
+            for (size_t kk = 0; kk < len; kk++) {
+                garner_combine(v, mods, kk, out + (blk + kk) * mods);
+            }
+        }
+    }
+    for (size_t jj = 0; jj <= mods; jj++) {
+        ALIGNED_FREE(buf[jj]);
+    }
+    return failed ? -1 : (int)mods;
+}
 
-    for (size_t ii = len2; ii < ntt_len; ii++) {
-        tmp_mont[ii] = 0;
+/*
+ * 2^bits 进制的乘法 (1 <= bits <= 64), 每个字存一位且小于 2^bits, out[0, len1 + len2) 同为 2^bits 进制.
+ * bits = 64 时即 abs_mul64_auto; 其余按 ntt_mod_count 选模数个数, 如 32 位为两个, 进位在 Garner 之后按 bits 位做.
+ */
+void abs_mul64_bits(const u64* in1, u64 len1, const u64* in2, u64 len2, unsigned bits, u64* out) {
+    assert(in1 != NULL && in2 != NULL && out != NULL && bits >= 1 && bits <= 64);
+    if (bits == 64) {
+        abs_mul64_auto(in1, len1, in2, len2, out);
+        return;
     }
-    for (size_t ii = 0; ii < len2; ii++) {
-        tmp_mont[ii] = in2[ii];
-        _mont_tomont_func(tmp_mont[ii], 2);
+    size_t mods = ntt_mod_count(bits, bits, (len1 < len2) ? len1 : len2);
+    assert(mods != 0);
+    bool sqr = (in1 == in2 && len1 == len2);
+    u64 conv_len = len1 + len2 - 1, ntt_len = int_ceil2(conv_len);
+    mont64* buf[NTT_MOD_MAX + 1] = {NULL};
+    for (size_t jj = 0; jj < mods + (sqr ? 0 : 1); jj++) {
+        ALIGNED_MALLOC(buf[jj], mont64, ntt_len);
+        if (buf[jj] == NULL) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            abort();
+        }
+    }
+    mont64* tmp[NTT_MOD_MAX] = {buf[mods], buf[mods], buf[mods], buf[mods], buf[mods]};
+    conv_mods(in1, len1, 1, sqr ? NULL : in2, len2, 1, mods, ntt_len, buf, tmp, NULL);
+
+    /* carry 为 mods + 1 个字, 每项加上 Garner 的结果后取低 bits 位, 再整体右移 bits 位 */
+    const u64 mask = (1ull << bits) - 1;
+    u64 carry[NTT_MOD_MAX + 1] = {0}, val[NTT_MOD_MAX];
+    _Alignas(64) u64 v[NTT_MOD_MAX][CRT_CHUNK];
+    for (u64 blk = 0; blk < conv_len; blk += CRT_CHUNK) {
+        size_t len = (conv_len - blk < CRT_CHUNK) ? conv_len - blk : CRT_CHUNK;
+        garner_digits(buf, mods, blk, len, v);
+        for (size_t kk = 0; kk < len; kk++) {
+            garner_combine(v, mods, kk, val);
+            u64 cy = 0;
+            for (size_t ww = 0; ww < mods; ww++) {
+                u64 sum = carry[ww] + cy;
+                cy = (sum < cy) ? 1 : 0;
+                carry[ww] = sum + val[ww];
+                cy += (carry[ww] < sum) ? 1 : 0;
+            }
+            carry[mods] += cy;
+            out[blk + kk] = carry[0] & mask;
+            for (size_t ww = 0; ww < mods; ww++) {
+                carry[ww] = (carry[ww] >> bits) | (carry[ww + 1] << (64 - bits));
+            }
+            carry[mods] >>= bits;
+        }
+    }
+    out[conv_len] = carry[0];
+    for (size_t jj = 0; jj <= mods; jj++) {
+        ALIGNED_FREE(buf[jj]);
     }
-    cover_nttshort_func(table.log_len, &table, 2);
+}
 
-    //start = clock();
+/*
+ * 单个模数下的多项式乘法 (信号处理, 编码等只需要 mod p 的结果): 只做第 mod 个模数 (1 ~ NTT_MOD_MAX,
+ * 即 data.h 中的 global_mod1 ...) 的一次卷积, 没有 CRT 与进位, 约为整数乘法 1 / 3 的工作量.
+ * 输入输出都可以留在 Montgomery 形式 (x * R mod p), 连续运算时省去每次的 tomont / toint.
+ */
+#define POLY_MONT_IN 1u  // 输入已为 Montgomery 形式的规范值, 跳过 tomont
+#define POLY_MONT_OUT 2u // 输出保留 Montgomery 形式 (规范值), 跳过 toint
 
-    conv_rec_func(buf2_mont, tmp_mont, buf2_mont, &table, ntt_len, 2);
-    //end = clock();
-    //elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    //printf("%.3f\n", elapsed);
+typedef void (*mont_load_func_t)(const u64*, u64, u64, mont64*);
+typedef void (*poly_store_func)(const mont64*, u64*, size_t, bool);
+
+static const mont_load_func_t mont_load_funcs[NTT_MOD_MAX] = {mont_load_1, mont_load_2, mont_load_3, mont_load_4,
+                                                              mont_load_5};
+
+/* 卷积结果 (< 4p) 转为规范值: 与 1 做 mulinto 即 toint, 与 mont64(1) 做 mulinto 保留 Montgomery 形式 */
+#define define_poly_store(_i)                                                      \
+    static void poly_store_##_i(const mont64* in, u64* out, size_t len, bool mont) { \
+        mulc_##_i(in, out, mont ? g_one(_i) : 1, len);                             \
+    }
+
+define_poly_store(1) define_poly_store(2) define_poly_store(3) define_poly_store(4) define_poly_store(5)
+
+static const poly_store_func poly_store_funcs[NTT_MOD_MAX] = {poly_store_1, poly_store_2, poly_store_3, poly_store_4,
+                                                              poly_store_5};
+
+/* 第 mod 个模数的值, mod 不合法时返回 0 */
+u64 poly_mod_prime(size_t mod) {
+    return (mod >= 1 && mod <= NTT_MOD_MAX) ? garner_mod[mod - 1] : 0;
+}
+
+/* out[0, len) = in * R mod p, in 可为任意 u64 */
+void poly_mod_tomont(size_t mod, const u64* in, u64 len, u64* out) {
+    assert(mod >= 1 && mod <= NTT_MOD_MAX && in != NULL && out != NULL);
+    mont_load_funcs[mod - 1](in, len, len, out);
+}
 
-    for (size_t ii = len2; ii < ntt_len; ii++) {
-        tmp_mont[ii] = 0;
+/* out[0, len) = in / R mod p, in 为 Montgomery 形式 */
+void poly_mod_toint(size_t mod, const u64* in, u64 len, u64* out) {
+    assert(mod >= 1 && mod <= NTT_MOD_MAX && in != NULL && out != NULL);
+    poly_store_funcs[mod - 1](in, out, len, false);
+}
+
+/*
+ * out[0, len1 + len2 - 1) = in1 * in2 mod p, 输出为规范值. 没有 POLY_MONT_IN 时输入可为任意 u64 (先约化),
+ * 否则须为 < p 的 Montgomery 形式. in1 == in2 且 len1 == len2 时为平方. 参数不合法或分配失败返回 -1.
+ */
+int poly_mul_mod(size_t mod, const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out, unsigned flags) {
+    if (mod < 1 || mod > NTT_MOD_MAX || in1 == NULL || in2 == NULL || out == NULL || len1 == 0 || len2 == 0) {
+        return -1;
+    }
+    bool sqr = (in1 == in2 && len1 == len2);
+    u64 conv_len = len1 + len2 - 1, ntt_len = int_ceil2(conv_len);
+    mont64 *buf = NULL, *tmp = NULL;
+    ALIGNED_MALLOC(buf, mont64, ntt_len);
+    if (!sqr) {
+        ALIGNED_MALLOC(tmp, mont64, ntt_len);
     }
-    for (size_t ii = 0; ii < len2; ii++) {
-        tmp_mont[ii] = in2[ii];
-        _mont_tomont_func(tmp_mont[ii], 3);
+    if (buf == NULL || (!sqr && tmp == NULL)) {
+        ALIGNED_FREE(buf);
+        ALIGNED_FREE(tmp);
+        return -1;
+    }
+    mod_job job;
+    job.in1 = in1;
+    job.len1 = len1;
+    job.in2 = sqr ? NULL : in2;
+    job.len2 = len2;
+    job.buf = buf;
+    job.tmp = tmp;
+    job.ntt_len = ntt_len;
+    job.table_log = log2_64((ntt_len < long_threshold) ? ntt_len : long_threshold);
+    job.par = NULL;
+    job.in1_ready = job.in2_ready = (flags & POLY_MONT_IN) != 0;
+    job.ms = 0;
+    if (flags & POLY_MONT_IN) {
+        memcpy(buf, in1, len1 * sizeof(u64));
+        memset(buf + len1, 0, (ntt_len - len1) * sizeof(u64));
+        if (!sqr) {
+            memcpy(tmp, in2, len2 * sizeof(u64));
+            memset(tmp + len2, 0, (ntt_len - len2) * sizeof(u64));
+        }
     }
-    cover_nttshort_func(table.log_len, &table, 3);
+    mod_job_funcs[mod - 1](&job);
+    poly_store_funcs[mod - 1](buf, out, conv_len, (flags & POLY_MONT_OUT) != 0);
+    ALIGNED_FREE(buf);
+    ALIGNED_FREE(tmp);
+    return 0;
+}
 
-    //start = clock();
-    conv_rec_func(buf3_mont, tmp_mont, buf3_mont, &table, ntt_len, 3);
-    //end = clock();
-    //elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    //printf("%.3f\n", elapsed);
+/*
+ * 任意模数 m (2 <= m < 2^63) 的多项式乘法. 输入先约化到 [0, m), 卷积的每一项不超过 min(len1, len2) * (m - 1)^2,
+ * 按 ntt_mod_count 取模数个数 (63 位的 m 为三个, 30 位以下为两个). Garner 的第 j 位数字直接乘
+ * c_j = (p_0 ... p_{j-1}) mod m 累加取模, 没有多字的整数与进位链.
+ * 乘常数取模用 Shoup 的预计算商: c' = floor(c * 2^64 / m), q = hi(v * c'), r = v * c - q * m, r < 2m.
+ */
+typedef struct AnyMod {
+    u64 m;
+    size_t mods;
+    u64 one_pre; // floor(2^64 / m), 约化输入用
+    u64 c[NTT_MOD_MAX];
+    u64 c_pre[NTT_MOD_MAX];
+} anymod;
+
+/* floor((hi * 2^64 + lo) / d), 要求 hi < d; 只在初始化时用, 逐位计算 */
+static u64 udiv128by64(u64 hi, u64 lo, u64 d) {
+    u64 q = 0;
+    for (int bit = 63; bit >= 0; bit--) {
+        bool top = (hi >> 63) != 0;
+        hi = (hi << 1) | (lo >> 63);
+        lo <<= 1;
+        q <<= 1;
+        if (top || hi >= d) {
+            hi -= d;
+            q |= 1;
+        }
+    }
+    return q;
+}
 
-    ALIGNED_FREE(tmp_mont);
+/* v * c mod m, c < m < 2^63, c_pre = floor(c * 2^64 / m), v 为任意 u64 */
+INLINE u64 mulmod_shoup(u64 v, u64 c, u64 c_pre, u64 m) {
+    u128 q = {0, 0};
+    _u128mul(q, v, c_pre);
+    u64 r = v * c - q[1] * m;
+    return (r < m) ? r : r - m;
+}
 
-    //start = clock();
-    u192 carry = {0, 0, 0};
-    for (size_t ii = 0; ii < conv_len; ii++) {
-        u192 temp = {0, 0, 0};
-        crt3(buf1_mont[ii], buf2_mont[ii], buf3_mont[ii], temp);
-        _u192add(carry, temp);
-        out[ii] = (*(carry));
-        carry[0] = carry[1];
-        carry[1] = carry[2];
-        carry[2] = 0;
+static bool anymod_init(anymod* am, u64 m, u64 min_len) {
+    if (m < 2 || (m >> 63) != 0) {
+        return false;
+    }
+    unsigned bits = (unsigned)log2_64(m - 1) + 1;
+    am->m = m;
+    am->mods = ntt_mod_count(bits, bits, min_len);
+    if (am->mods == 0) {
+        return false;
     }
+    am->one_pre = udiv128by64(1, 0, m);
+    am->c[0] = 1;
+    am->c_pre[0] = am->one_pre;
+    for (size_t jj = 1; jj < am->mods; jj++) {
+        u64 pm = mulmod_shoup(garner_mod[jj - 1], 1, am->one_pre, m);
+        am->c[jj] = mulmod_shoup(am->c[jj - 1], pm, udiv128by64(pm, 0, m), m);
+        am->c_pre[jj] = udiv128by64(am->c[jj], 0, m);
+    }
+    return true;
+}
 
-    out[conv_len] = carry[0];
-    //end = clock();
-    //elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    //printf("%.3f\n", elapsed);
+/* out[begin, end) = sum_j v_j * c_j mod m */
+static void anymod_block(const anymod* am, mont64* const buf[], size_t begin, size_t end, u64* out) {
+    _Alignas(64) u64 v[NTT_MOD_MAX][CRT_CHUNK];
+    const u64 m = am->m;
+    for (size_t blk = begin; blk < end; blk += CRT_CHUNK) {
+        size_t len = (end - blk < CRT_CHUNK) ? end - blk : CRT_CHUNK;
+        garner_digits(buf, am->mods, blk, len, v);
+        for (size_t kk = 0; kk < len; kk++) {
+            u64 sum = 0;
+            for (size_t jj = 0; jj < am->mods; jj++) {
+                sum += mulmod_shoup(v[jj][kk], am->c[jj], am->c_pre[jj], m);
+                sum = (sum < m) ? sum : sum - m;
+            }
+            out[blk + kk] = sum;
+        }
+    }
+}
 
-    ALIGNED_FREE(buf1_mont);
-    ALIGNED_FREE(buf2_mont);
-    ALIGNED_FREE(buf3_mont);
-    ALIGNED_FREE(table.omega);
-    ALIGNED_FREE(table.iomega);
+typedef struct AnyModTask {
+    const anymod* am;
+    mont64* const* buf;
+    u64* out;
+    size_t begin;
+    size_t end;
+} anymod_task;
+
+static void anymod_task_run(void* arg) {
+    anymod_task* tk = (anymod_task*)arg;
+    anymod_block(tk->am, tk->buf, tk->begin, tk->end, tk->out);
 }
 
-void abs_sqr64(u64* in1, u64 len1, u64* out) {
-    assert(in1 != NULL && out != NULL);
-    u64 out_len = len1 * 2, conv_len = out_len - 1;
-    u64 ntt_len = int_ceil2(conv_len);
+/* 重建没有进位, 多线程时直接按块分给线程池 */
+static void anymod_recon(const conv_par* par, const anymod* am, mont64* const buf[], u64 conv_len, u64* out) {
+    if (par == NULL || par->pool == NULL || par->pool->threads <= 1 || conv_len < 2 * CRT_PAR_MIN_BLOCK) {
+        anymod_block(am, buf, 0, conv_len, out);
+        return;
+    }
+    size_t count = (size_t)par->pool->threads * 4;
+    count = count < CONV_PAR_MAX_CHUNKS ? count : CONV_PAR_MAX_CHUNKS;
+    count = count < conv_len / CRT_PAR_MIN_BLOCK ? count : conv_len / CRT_PAR_MIN_BLOCK;
+    size_t chunk = (conv_len + count - 1) / count;
+    anymod_task tasks[CONV_PAR_MAX_CHUNKS];
+    task_group group;
+    task_group_init(&group);
+    for (size_t cc = 0; cc < count; cc++) {
+        tasks[cc].am = am, tasks[cc].buf = buf, tasks[cc].out = out;
+        tasks[cc].begin = cc * chunk;
+        tasks[cc].end = (cc + 1) * chunk < conv_len ? (cc + 1) * chunk : conv_len;
+        if (cc + 1 < count) {
+            task_spawn(par->pool, &group, anymod_task_run, tasks + cc);
+        }
+    }
+    anymod_task_run(tasks + count - 1);
+    task_wait(par->pool, &group);
+}
 
-    mont64 *buf1_mont, *buf2_mont, *buf3_mont;
-    ALIGNED_MALLOC(buf1_mont, mont64, ntt_len);
-    ALIGNED_MALLOC(buf2_mont, mont64, ntt_len);
-    ALIGNED_MALLOC(buf3_mont, mont64, ntt_len);
+/* 一组缓冲区: buf / tmp 各 mods 个 ntt_len 长 (tmp_each 为假时共用 tmp[0]), red 存约化后的输入 */
+typedef struct AnyModWork {
+    const anymod* am;
+    u64 len1;
+    u64 len2;
+    u64 ntt_len;
+    mont64* buf[NTT_MOD_MAX];
+    mont64* tmp[NTT_MOD_MAX];
+    u64* red;
+    bool tmp_each; // 每个模数各有 tmp, 模数间并行时需要
+} anymod_work;
+
+static void anymod_work_free(anymod_work* wk) {
+    for (size_t jj = 0; jj < NTT_MOD_MAX; jj++) {
+        ALIGNED_FREE(wk->buf[jj]);
+        if (wk->tmp_each || jj == 0) {
+            ALIGNED_FREE(wk->tmp[jj]);
+        }
+        wk->buf[jj] = wk->tmp[jj] = NULL;
+    }
+    free(wk->red);
+    wk->red = NULL;
+}
 
-    if (buf1_mont == NULL || buf2_mont == NULL || buf3_mont == NULL) {
-        fprintf(stderr, "Memory allocation failed.\n");
-        abort();
+static bool anymod_work_alloc(anymod_work* wk, const anymod* am, u64 len1, u64 len2, bool tmp_each) {
+    wk->am = am;
+    wk->len1 = len1;
+    wk->len2 = len2;
+    wk->ntt_len = int_ceil2(len1 + len2 - 1);
+    wk->tmp_each = tmp_each;
+    wk->red = (u64*)malloc((len1 + len2) * sizeof(u64));
+    bool failed = (wk->red == NULL);
+    for (size_t jj = 0; jj < NTT_MOD_MAX; jj++) {
+        wk->buf[jj] = wk->tmp[jj] = NULL;
+    }
+    for (size_t jj = 0; jj < am->mods; jj++) {
+        ALIGNED_MALLOC(wk->buf[jj], mont64, wk->ntt_len);
+        if (tmp_each || jj == 0) {
+            ALIGNED_MALLOC(wk->tmp[jj], mont64, wk->ntt_len);
+        } else {
+            wk->tmp[jj] = wk->tmp[0];
+        }
+        failed = failed || wk->buf[jj] == NULL || wk->tmp[jj] == NULL;
     }
+    if (failed) {
+        anymod_work_free(wk);
+    }
+    return !failed;
+}
 
-    ntt_short table;
-    table.ntt_len = (ntt_len < long_threshold) ? ntt_len : long_threshold;
-    table.log_len = log2_64(table.ntt_len);
-    // table.omega = g_a;
-    // table.iomega = g_b;
-    ALIGNED_MALLOC(table.omega, mont64, table.ntt_len);
-    ALIGNED_MALLOC(table.iomega, mont64, table.ntt_len);
-
-    for (size_t ii = len1; ii < ntt_len; ii++) {
-        buf1_mont[ii] = 0;
-        buf2_mont[ii] = 0;
-        buf3_mont[ii] = 0;
-    }
-    for (size_t ii = 0; ii < len1; ii++) {
-        buf1_mont[ii] = in1[ii];
-        buf2_mont[ii] = in1[ii];
-        buf3_mont[ii] = in1[ii];
-        _mont_tomont_func(buf1_mont[ii], 1);
-        _mont_tomont_func(buf2_mont[ii], 2);
-        _mont_tomont_func(buf3_mont[ii], 3);
-    }
-
-    clock_t start, end;
-    double elapsed;
-    cover_nttshort_func(table.log_len, &table, 1);
-
-    start = clock();
-    conv_sqr_func(buf1_mont, buf1_mont, &table, ntt_len, 1);
-    end = clock();
-    elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    printf("%.3f\n", elapsed);
+/* out[0, len1 + len2 - 1) = in1 * in2 mod m, in1 == in2 时为平方 */
+static void anymod_work_run(anymod_work* wk, const u64* in1, const u64* in2, u64* out, const conv_par* par) {
+    const anymod* am = wk->am;
+    bool sqr = (in1 == in2 && wk->len1 == wk->len2);
+    u64* red1 = wk->red;
+    u64* red2 = wk->red + wk->len1;
+    for (u64 ii = 0; ii < wk->len1; ii++) {
+        red1[ii] = mulmod_shoup(in1[ii], 1, am->one_pre, am->m);
+    }
+    for (u64 ii = 0; !sqr && ii < wk->len2; ii++) {
+        red2[ii] = mulmod_shoup(in2[ii], 1, am->one_pre, am->m);
+    }
+    conv_mods(red1, wk->len1, 1, sqr ? NULL : red2, wk->len2, 1, am->mods, wk->ntt_len, wk->buf, wk->tmp, par);
+    anymod_recon(par, am, wk->buf, wk->len1 + wk->len2 - 1, out);
+}
+
+/*
+ * out[0, len1 + len2 - 1) = in1 * in2 mod m (2 <= m < 2^63), 输入为任意 u64, 输出在 [0, m).
+ * threads > 1 时各模数的卷积与重建在线程池中并行. 参数不合法或分配失败返回 -1.
+ */
+int poly_mul_anymod_mt(u64 m, const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out, int threads) {
+    anymod am;
+    if (in1 == NULL || in2 == NULL || out == NULL || len1 == 0 || len2 == 0 ||
+        !anymod_init(&am, m, (len1 < len2) ? len1 : len2)) {
+        return -1;
+    }
+    conv_par par = {NULL, conv_task_grain, conv_task_chunk};
+    if (threads > 1) {
+        par.pool = task_pool_create(threads);
+        if (par.pool == NULL) {
+            return -1;
+        }
+    }
+    anymod_work wk;
+    bool ok = anymod_work_alloc(&wk, &am, len1, len2, par.pool != NULL);
+    if (ok) {
+        anymod_work_run(&wk, in1, in2, out, &par);
+        anymod_work_free(&wk);
+    }
+    task_pool_destroy(&par.pool);
+    return ok ? 0 : -1;
+}
 
-    cover_nttshort_func(table.log_len, &table, 2);
+int poly_mul_anymod(u64 m, const u64* in1, u64 len1, const u64* in2, u64 len2, u64* out) {
+    return poly_mul_anymod_mt(m, in1, len1, in2, len2, out, 1);
+}
 
-    start = clock();
-    conv_sqr_func(buf2_mont, buf2_mont, &table, ntt_len, 2);
-    end = clock();
-    elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    printf("%.3f\n", elapsed);
+typedef struct AnyModBatch {
+    anymod_work wk;
+    const u64* const* in1;
+    const u64* const* in2;
+    u64* const* out;
+    size_t begin;
+    size_t step;
+    size_t count;
+} anymod_batch;
+
+static void anymod_batch_run(void* arg) {
+    anymod_batch* bt = (anymod_batch*)arg;
+    for (size_t ii = bt->begin; ii < bt->count; ii += bt->step) {
+        anymod_work_run(&bt->wk, bt->in1[ii], bt->in2[ii], bt->out[ii], NULL);
+    }
+}
+
+/*
+ * count 组同样长度的乘积 out[i] = in1[i] * in2[i] mod m, 缓冲区只分配一次.
+ * threads > 1 时各组轮流分给 threads 个线程, 每个线程一组缓冲区, 单个乘积内部串行.
+ */
+#define ANYMOD_BATCH_MAX_THREADS 64
+
+int poly_mul_anymod_batch(u64 m, size_t count, const u64* const in1[], u64 len1, const u64* const in2[], u64 len2,
+                          u64* const out[], int threads) {
+    anymod am;
+    if (in1 == NULL || in2 == NULL || out == NULL || len1 == 0 || len2 == 0 ||
+        !anymod_init(&am, m, (len1 < len2) ? len1 : len2)) {
+        return -1;
+    }
+    size_t workers = (threads > 1) ? (size_t)threads : 1;
+    workers = workers < count ? workers : count;
+    workers = workers < ANYMOD_BATCH_MAX_THREADS ? workers : ANYMOD_BATCH_MAX_THREADS;
+    if (workers == 0) {
+        return 0;
+    }
+    anymod_batch batch[ANYMOD_BATCH_MAX_THREADS];
+    size_t ready = 0;
+    for (; ready < workers; ready++) {
+        if (!anymod_work_alloc(&batch[ready].wk, &am, len1, len2, false)) {
+            break;
+        }
+        batch[ready].in1 = in1, batch[ready].in2 = in2, batch[ready].out = out;
+        batch[ready].begin = ready, batch[ready].step = workers, batch[ready].count = count;
+    }
+    task_pool* pool = (ready == workers && workers > 1) ? task_pool_create((int)workers) : NULL;
+    bool ok = (ready == workers) && (workers == 1 || pool != NULL);
+    if (ok && pool != NULL) {
+        task_group group;
+        task_group_init(&group);
+        for (size_t ww = 1; ww < workers; ww++) {
+            task_spawn(pool, &group, anymod_batch_run, batch + ww);
+        }
+        anymod_batch_run(batch);
+        task_wait(pool, &group);
+    } else if (ok) {
+        anymod_batch_run(batch);
+    }
+    task_pool_destroy(&pool);
+    for (size_t ww = 0; ww < ready; ww++) {
+        anymod_work_free(&batch[ww].wk);
+    }
+    return ok ? 0 : -1;
+}
 
-    cover_nttshort_func(table.log_len, &table, 3);
+#ifndef _WIN32
+/*
+ * 外存乘法: 操作数与乘积都是按 u64 字 (本机字节序, 低位在前) 存放的文件, 通过 mmap 访问.
+ * 各模数的变换数组放在 scratch_dir 下的一个临时文件中 (创建后立即 unlink), 按四步法 (行长 N2 = long_threshold)
+ * 做卷积: 列变换一次处理一个列窗口 (每行上连续的一段), 行变换一次处理若干整行, 转换与 CRT 按顺序分段,
+ * 每遍都按文件偏移递增的顺序读写. 每个窗口处理前 MADV_WILLNEED 预读, 处理后 MADV_DONTNEED 释放,
+ * 常驻内存约为 mem_budget. 模数按顺序逐个完成, 临时文件共 (k + 1) * ntt_len 个字 (平方时 k 个).
+ */
+#define OOC_COL_BLOCK 16 // 列变换每次拷贝的列数
+#define OOC_ALIGN 65536   // 内核读缺页时会顺带映射同一 64 KiB 块内已缓存的页
+
+typedef struct {
+    void* addr;
+    size_t bytes;
+    int fd;
+} ooc_map;
+
+typedef struct {
+    size_t lg1, lg2;            // 列长 N1 = 2^lg1, 行长 N2 = 2^lg2
+    mont64* ws;                 // four_step_cols 的缓冲区
+    size_t ws_len;
+    size_t col_win, row_win;    // 一个列窗口的列数, 一个行窗口的行数
+    size_t word_win;            // 顺序分段处理时每段的字数
+} ooc_conv;
+
+/* fd 映射为 bytes 字节, 失败时关闭 fd */
+static bool ooc_map_fd(ooc_map* m, int fd, size_t bytes, bool writable) {
+    m->addr = MAP_FAILED, m->bytes = bytes, m->fd = fd;
+    if (fd < 0) {
+        return false;
+    }
+    if (bytes != 0) {
+        m->addr = mmap(NULL, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (m->addr != MAP_FAILED) {
+        madvise(m->addr, bytes, MADV_RANDOM); // 预读只由窗口的 MADV_WILLNEED 决定, 否则常驻内存会超出窗口
+    } else {
+        close(fd);
+        m->fd = -1;
+        return false;
+    }
+    return true;
+}
 
-    start = clock();
-    conv_sqr_func(buf3_mont, buf3_mont, &table, ntt_len, 3);
-    end = clock();
-    elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    printf("%.3f\n", elapsed);
+static void ooc_unmap(ooc_map* m) {
+    if (m->addr != MAP_FAILED) {
+        munmap(m->addr, m->bytes);
+        m->addr = MAP_FAILED;
+    }
+    if (m->fd >= 0) {
+        close(m->fd);
+        m->fd = -1;
+    }
+}
 
+/* 只读映射整个文件, 长度须为 8 的非零倍数 */
+static bool ooc_map_input(ooc_map* m, const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size % sizeof(u64) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    return ooc_map_fd(m, fd, (fd >= 0) ? (size_t)st.st_size : 0, false);
+}
 
-    start = clock();
-    u192 carry = {0, 0, 0};
-    for (size_t ii = 0; ii < conv_len; ii++) {
-        u192 temp = {0, 0, 0};
-        crt3(buf1_mont[ii], buf2_mont[ii], buf3_mont[ii], temp);
-        _u192add(carry, temp);
-        out[ii] = (*(carry));
-        carry[0] = carry[1];
-        carry[1] = carry[2];
-        carry[2] = 0;
+/* 新建 (或截断) 长 bytes 的文件并映射; path 为 NULL 时在 dir 下建立已 unlink 的临时文件 */
+static bool ooc_map_create(ooc_map* m, const char* path, const char* dir, size_t bytes) {
+    int fd = -1;
+    if (path != NULL) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else {
+        char name[4096];
+        if (snprintf(name, sizeof(name), "%s/fast_mul_XXXXXX", dir) < (int)sizeof(name)) {
+            fd = mkstemp(name);
+        }
+        if (fd >= 0) {
+            unlink(name);
+        }
+    }
+    if (fd >= 0 && ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return ooc_map_fd(m, fd, bytes, true);
+}
+
+/*
+ * 对 base[0, total) 中第 [begin, begin + len) 个字所在的页做 madvise. MADV_DONTNEED 向外取整到 OOC_ALIGN
+ * (不超出 base[0, total)), 连同缺页时顺带映射进来的相邻页一起释放; 映射都是 MAP_SHARED, 释放只解除映射
+ */
+static void ooc_advise(const void* base, u64 total, u64 begin, u64 len, int advice) {
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t align = (advice == MADV_DONTNEED && page < OOC_ALIGN) ? OOC_ALIGN : page;
+    const uintptr_t start = (uintptr_t)base, end = (start + total * sizeof(u64) + page - 1) & ~(page - 1);
+    uintptr_t lo = (start + begin * sizeof(u64)) & ~(align - 1);
+    uintptr_t hi = (start + (begin + len) * sizeof(u64) + align - 1) & ~(align - 1);
+    lo = (lo < start) ? start : lo;
+    hi = (hi > end) ? end : hi;
+    if (len != 0 && lo < hi) {
+        madvise((void*)lo, hi - lo, advice);
+    }
+}
+
+/* 列窗口 [c0, c0 + cols) 在前 rows 行上的部分 */
+static void ooc_advise_cols(const mont64* buf, const ooc_conv* oc, size_t c0, size_t cols, size_t rows, int advice) {
+    for (size_t rr = 0; rr < rows; rr++) {
+        ooc_advise(buf, 1ull << (oc->lg1 + oc->lg2), (rr << oc->lg2) + c0, cols, advice);
     }
+}
+
+#define define_ooc_mod(_i)                                                                                         \
+    static void ooc_cols_##_i(const ooc_conv* oc, mont64* buf, u64 nz, mont64 root, bool inverse) {               \
+        ntt_short* table = get_nttshort_func(log2_64(long_threshold), _i);                                        \
+        const size_t n1 = 1ull << oc->lg1, n2 = 1ull << oc->lg2, rows = inverse ? n1 : (nz + n2 - 1) / n2;        \
+        for (size_t c0 = 0; c0 < n2; c0 += oc->col_win) {                                                         \
+            const size_t cols = (n2 - c0 < oc->col_win) ? n2 - c0 : oc->col_win;                                  \
+            ooc_advise_cols(buf, oc, c0, cols, rows, MADV_WILLNEED);                                              \
+            four_step_cols_##_i(buf, oc->ws, oc->ws_len, table, oc->lg1, oc->lg2, c0, c0 + cols, nz, root,        \
+                                inverse);                                                                         \
+            ooc_advise_cols(buf, oc, c0, cols, n1, MADV_DONTNEED);                                                \
+        }                                                                                                         \
+    }                                                                                                             \
+    /* a, b 为已转换的两个输入 (前 nz1 / nz2 项), 结果留在 a; b == NULL 时为平方 */                                    \
+    static void ooc_mod_##_i(const ooc_conv* oc, mont64* a, u64 nz1, mont64* b, u64 nz2) {                        \
+        const ntt_level* level = get_ntt_level_func(_i);                                                          \
+        ntt_short* table = get_nttshort_func(log2_64(long_threshold), _i);                                        \
+        const size_t lg = oc->lg1 + oc->lg2, n1 = 1ull << oc->lg1, n2 = 1ull << oc->lg2;                          \
+        ooc_cols_##_i(oc, a, nz1, level->root[lg], false);                                                        \
+        if (b != NULL) {                                                                                          \
+            ooc_cols_##_i(oc, b, nz2, level->root[lg], false);                                                    \
+        }                                                                                                         \
+        for (size_t r0 = 0; r0 < n1; r0 += oc->row_win) {                                                         \
+            const size_t r1 = (n1 - r0 < oc->row_win) ? n1 : r0 + oc->row_win;                                   \
+            ooc_advise(a, n1 * n2, r0 * n2, (r1 - r0) * n2, MADV_WILLNEED);                                       \
+            if (b != NULL) {                                                                                      \
+                ooc_advise(b, n1 * n2, r0 * n2, (r1 - r0) * n2, MADV_WILLNEED);                                   \
+            }                                                                                                     \
+            four_step_rows_##_i(a, b, a, table, oc->lg2, r0, r1, true, level->inv_len[lg]);                       \
+            ooc_advise(a, n1 * n2, r0 * n2, (r1 - r0) * n2, MADV_DONTNEED);                                       \
+            if (b != NULL) {                                                                                      \
+                ooc_advise(b, n1 * n2, r0 * n2, (r1 - r0) * n2, MADV_DONTNEED);                                   \
+            }                                                                                                     \
+        }                                                                                                         \
+        ooc_cols_##_i(oc, a, n1 * n2, level->rootinv[lg], true);                                                  \
+    }
+
+define_ooc_mod(1) define_ooc_mod(2) define_ooc_mod(3) define_ooc_mod(4) define_ooc_mod(5)
+
+typedef void (*ooc_mod_func)(const ooc_conv*, mont64*, u64, mont64*, u64);
+
+static const ooc_mod_func ooc_mod_funcs[NTT_MOD_MAX] = {ooc_mod_1, ooc_mod_2, ooc_mod_3, ooc_mod_4, ooc_mod_5};
+
+/* out[0, 补零到整行) = in[0, len) 在第 jj 个模数下的 Montgomery 形式, 按 word_win 分段 */
+static void ooc_load(const ooc_conv* oc, size_t jj, const u64* in, u64 len, mont64* out) {
+    const u64 n2 = 1ull << oc->lg2, end = (len + n2 - 1) / n2 * n2;
+    for (u64 blk = 0; blk < end; blk += oc->word_win) {
+        u64 cnt = (end - blk < oc->word_win) ? end - blk : oc->word_win;
+        u64 src = (blk >= len) ? 0 : (len - blk < cnt) ? len - blk : cnt;
+        ooc_advise(in, len, blk, src, MADV_WILLNEED);
+        mont_load_funcs[jj](in + blk, src, cnt, out + blk);
+        ooc_advise(in, len, blk, src, MADV_DONTNEED);
+        ooc_advise(out, end, blk, cnt, MADV_DONTNEED);
+    }
+}
 
+/* 各模数的结果 buf[0, mods) 做 Garner CRT 并进位, 写出 out[0, conv_len + 1) */
+static void ooc_crt(const ooc_conv* oc, mont64* const buf[], size_t mods, u64 conv_len, u64* out) {
+    u64 carry[NTT_MOD_MAX + 1] = {0}, val[NTT_MOD_MAX];
+    _Alignas(64) u64 v[NTT_MOD_MAX][CRT_CHUNK];
+    for (u64 win = 0; win < conv_len; win += oc->word_win) {
+        u64 win_len = (conv_len - win < oc->word_win) ? conv_len - win : oc->word_win;
+        for (size_t jj = 0; jj < mods; jj++) {
+            ooc_advise(buf[jj], conv_len, win, win_len, MADV_WILLNEED);
+        }
+        for (u64 blk = win; blk < win + win_len; blk += CRT_CHUNK) {
+            size_t len = (win + win_len - blk < CRT_CHUNK) ? win + win_len - blk : CRT_CHUNK;
+            garner_digits(buf, mods, blk, len, v);
+            for (size_t kk = 0; kk < len; kk++) {
+                garner_combine(v, mods, kk, val);
+                u64 cy = 0;
+                for (size_t ww = 0; ww < mods; ww++) {
+                    u64 sum = carry[ww] + cy;
+                    cy = (sum < cy) ? 1 : 0;
+                    carry[ww] = sum + val[ww];
+                    cy += (carry[ww] < sum) ? 1 : 0;
+                }
+                carry[mods] += cy;
+                out[blk + kk] = carry[0];
+                for (size_t ww = 0; ww < mods; ww++) {
+                    carry[ww] = carry[ww + 1];
+                }
+                carry[mods] = 0;
+            }
+        }
+        for (size_t jj = 0; jj < mods; jj++) {
+            ooc_advise(buf[jj], conv_len, win, win_len, MADV_DONTNEED);
+        }
+        ooc_advise(out, conv_len + 1, win, win_len, MADV_DONTNEED);
+    }
     out[conv_len] = carry[0];
-    end = clock();
-    elapsed = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    printf("%.3f\n", elapsed);
+}
 
-    ALIGNED_FREE(buf1_mont);
-    ALIGNED_FREE(buf2_mont);
-    ALIGNED_FREE(buf3_mont);
-    ALIGNED_FREE(table.omega);
-    ALIGNED_FREE(table.iomega);
+/* ooc_mul 的主体: 分配 oc->ws 与 scratch (由调用者释放), 结果写入 out */
+static bool ooc_mul(ooc_conv* oc, ooc_map* scratch, const u64* a, u64 len1, const u64* b, u64 len2,
+                    const char* scratch_dir, size_t mem_budget, u64* out) {
+    const u64 conv_len = len1 + len2 - 1, ntt_len = int_ceil2(conv_len);
+    if (ntt_len <= long_threshold) {
+        abs_mul64_auto(a, len1, (b != NULL) ? b : a, len2, out);
+        return true;
+    }
+    const size_t mods = ntt_mod_count(64, 64, (len1 < len2) ? len1 : len2);
+    const size_t arrays = mods + ((b != NULL) ? 1 : 0);
+    oc->lg2 = log2_64(long_threshold), oc->lg1 = log2_64(ntt_len) - oc->lg2;
+    const size_t n1 = 1ull << oc->lg1, n2 = 1ull << oc->lg2;
+    oc->ws_len = (OOC_COL_BLOCK + 2) * n1;
+    const size_t ws_bytes = oc->ws_len * sizeof(mont64) + 2 * n1 * OOC_ALIGN; // 加上列窗口每行首尾顺带映射的页
+    if (mods == 0 || n1 > long_threshold || mem_budget <= ws_bytes) {
+        return false;
+    }
+    oc->col_win = (mem_budget - ws_bytes) / (n1 * sizeof(mont64));
+    oc->col_win = (oc->col_win < n2) ? oc->col_win : n2;
+    oc->row_win = mem_budget / (((b != NULL) ? 2 : 1) * n2 * sizeof(mont64));
+    oc->row_win = (oc->row_win < n1) ? oc->row_win : n1;
+    oc->word_win = mem_budget / ((mods + 1) * sizeof(u64));
+    if (oc->col_win == 0 || oc->row_win == 0 || oc->word_win < CRT_CHUNK) {
+        return false;
+    }
+    ALIGNED_MALLOC(oc->ws, mont64, oc->ws_len);
+    if (oc->ws == NULL || !ooc_map_create(scratch, NULL, scratch_dir, arrays * ntt_len * sizeof(mont64))) {
+        return false;
+    }
+    mont64* buf[NTT_MOD_MAX + 1];
+    for (size_t jj = 0; jj < arrays; jj++) {
+        buf[jj] = (mont64*)scratch->addr + jj * ntt_len;
+    }
+    for (size_t jj = 0; jj < mods; jj++) {
+        ooc_load(oc, jj, a, len1, buf[jj]);
+        if (b != NULL) {
+            ooc_load(oc, jj, b, len2, buf[mods]);
+        }
+        ooc_mod_funcs[jj](oc, buf[jj], len1, (b != NULL) ? buf[mods] : NULL, len2);
+    }
+    ooc_crt(oc, buf, mods, conv_len, out);
+    return true;
+}
+
+/*
+ * path1 * path2 写入 out_path (len1 + len2 个字), path1 与 path2 相同时为平方. mem_budget 为常驻内存的上限 (字节),
+ * 至少需要约 2 * long_threshold * 8 字节与 N1 * 128 KiB (N1 = ntt_len / long_threshold). 乘积不超过 long_threshold
+ * 时直接在内存中计算.
+ * 成功返回 0; 文件打不开或长度不是 8 的倍数, 预算不足, 映射或分配失败时返回 -1.
+ */
+int abs_mul64_file(const char* path1, const char* path2, const char* out_path, const char* scratch_dir,
+                   size_t mem_budget) {
+    if (path1 == NULL || path2 == NULL || out_path == NULL || scratch_dir == NULL) {
+        return -1;
+    }
+    const bool sqr = (strcmp(path1, path2) == 0);
+    ooc_map in1 = {MAP_FAILED, 0, -1}, in2 = {MAP_FAILED, 0, -1}, out = {MAP_FAILED, 0, -1};
+    ooc_map scratch = {MAP_FAILED, 0, -1};
+    ooc_conv oc = {0};
+    bool ok = ooc_map_input(&in1, path1) && (sqr || ooc_map_input(&in2, path2));
+    if (ok) {
+        u64 len1 = in1.bytes / sizeof(u64), len2 = sqr ? len1 : in2.bytes / sizeof(u64);
+        ok = ooc_map_create(&out, out_path, NULL, (len1 + len2) * sizeof(u64)) &&
+             ooc_mul(&oc, &scratch, (const u64*)in1.addr, len1, sqr ? NULL : (const u64*)in2.addr, len2, scratch_dir,
+                     mem_budget, (u64*)out.addr);
+    }
+    ALIGNED_FREE(oc.ws);
+    ooc_unmap(&scratch);
+    ooc_unmap(&out);
+    ooc_unmap(&in2);
+    ooc_unmap(&in1);
+    return ok ? 0 : -1;
 }
+#endif
 
 double test_mul_time(int len1, int len2) {
     u64* in1 = (u64*)malloc(len1 * sizeof(u64));
@@ -615,6 +3439,8 @@ int write_longlong_arr_to_csv(const long long* arr, int arr_len, const char* csv
     return 0;
 }
 
+/* bench.c 以 NTT_NO_MAIN 包含本文件 */
+#ifndef NTT_NO_MAIN
 int main() {
     const size_t min_len = 10000;
     const size_t max_len = 10000000;
@@ -635,3 +3461,4 @@ int main() {
 
     return 0;
 }
+#endif
@@ -0,0 +1,235 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * 内核级微基准与 roofline: microbench [--max-log b]
+ *
+ * 先测 STREAM 式的 copy / triad 带宽与 Montgomery 乘法的峰值吞吐, 再逐个测内核的 ns/元素.
+ * B/元素为最少的内存流量 (每个数组读 / 写各一次), mm/元素为按下面模型数出的 Montgomery 乘法次数.
+ * roofline 的预测时间为 max(B / 带宽, mm * 每次乘法的最短时间), 较大的一项决定 bound 一列,
+ * roof% 为预测时间 / 实测时间. 数据在缓存中的规模按 DRAM 带宽算, 是偏乐观的下界;
+ * 峰值取标量宏与 mulc 中较快者, 向量化更充分的内核可以超过 100%.
+ *
+ *   dif / idit      每层每元素 1/2 次 (radix-4 的一块 4 个元素两层 4 次)
+ *   dif244 / idit244 每元素 5/4 次 (两个 twiddle, 一次乘 i, 两次生成 omega 分摊到 4 个元素)
+ *   conv_rec        长层每层 2 个 dif244 与 1 个 idit244, 叶子为两个 dif, 一个 idit 与逐点乘
+ *   crt3            3 次 mulinto 与 6 次 64x64 乘法 (折合 3 次)
+ *   cover_nttshort  omega / iomega 各一次, 依赖链上串行执行
+ */
+#define NTT_NO_MAIN
+#include "main.c"
+
+#define MB_ROUNDS 5
+#define MB_MIN_NS 2e7              // 每轮至少 20 ms
+#define MB_STREAM_LEN (1ull << 23) // 64 MiB 一个数组, 大于常见的末级缓存
+#define MB_HOT_LEN 1024            // 乘法吞吐在 L1 中测
+
+typedef struct MbCtx {
+    mont64 *a, *b, *c;
+    size_t n;
+    ntt_short* table;
+} mb_ctx;
+
+typedef void (*mb_kernel)(mb_ctx* ctx);
+
+static double mb_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* 预热一次, 之后 MB_ROUNDS 轮中每次调用的最短时间 (ns) */
+static double mb_time(mb_kernel fn, mb_ctx* ctx) {
+    fn(ctx);
+    double best = 1e300;
+    for (int rr = 0; rr < MB_ROUNDS; rr++) {
+        size_t calls = 0;
+        double start = mb_now_ns(), elapsed;
+        do {
+            fn(ctx);
+            calls++;
+            elapsed = mb_now_ns() - start;
+        } while (elapsed < MB_MIN_NS);
+        best = (elapsed / calls < best) ? elapsed / calls : best;
+    }
+    return best;
+}
+
+static void mb_copy(mb_ctx* ctx) {
+    for (size_t ii = 0; ii < ctx->n; ii++) {
+        ctx->a[ii] = ctx->b[ii];
+    }
+}
+
+static void mb_triad(mb_ctx* ctx) {
+    for (size_t ii = 0; ii < ctx->n; ii++) {
+        ctx->a[ii] = ctx->b[ii] + 3 * ctx->c[ii];
+    }
+}
+
+static void mb_mont_mul(mb_ctx* ctx) {
+    for (size_t ii = 0; ii < ctx->n; ii++) {
+        _mont_mul_func(ctx->c[ii], ctx->a[ii], ctx->b[ii], 1);
+    }
+}
+
+static void mb_mont_mulinto(mb_ctx* ctx) {
+    for (size_t ii = 0; ii < ctx->n; ii++) {
+        _mont_mulinto_func(ctx->a[ii], ctx->b[ii], 1);
+    }
+}
+
+/* 依赖链, 测延迟 */
+static void mb_mont_mul_chain(mb_ctx* ctx) {
+    mont64 x = ctx->a[0], y = ctx->b[0];
+    for (size_t ii = 0; ii < ctx->n; ii++) {
+        _mont_mul_func(x, x, y, 1);
+    }
+    ctx->c[0] = x;
+}
+
+static void mb_mulc(mb_ctx* ctx) { mulc_1(ctx->a, ctx->c, ctx->b[0], ctx->n); }
+
+static void mb_dif(mb_ctx* ctx) { dif_func(ctx->a, ctx->table, ctx->n, 1); }
+
+static void mb_idit(mb_ctx* ctx) { idit_func(ctx->a, ctx->table, ctx->n, 1); }
+
+static void mb_dif244(mb_ctx* ctx) {
+    const ntt_level* level = get_ntt_level_func(1);
+    size_t lg = log2_64(ctx->n), quarter_len = ctx->n / 4;
+    dif244_pass_1(ctx->a, quarter_len, 0, quarter_len, level->root[lg], level->root3[lg]);
+}
+
+static void mb_idit244(mb_ctx* ctx) {
+    const ntt_level* level = get_ntt_level_func(1);
+    size_t lg = log2_64(ctx->n), quarter_len = ctx->n / 4;
+    idit244_pass_1(ctx->a, quarter_len, 0, quarter_len, level->rootinv[lg], level->rootinv3[lg], g_one(1), false);
+}
+
+static void mb_conv_rec(mb_ctx* ctx) { conv_rec_func(ctx->a, ctx->b, ctx->c, ctx->table, ctx->n, 1); }
+
+static void mb_crt3(mb_ctx* ctx) { crt3_carry(ctx->a, ctx->b, ctx->c, ctx->n - 1, (u64*)ctx->a + ctx->n * 3); }
+
+static void mb_cover(mb_ctx* ctx) { cover_nttshort_func(log2_64(ctx->n), ctx->table, 1); }
+
+/* conv_rec 的每元素模型, 元素按份额走 n / 2 与两个 n / 4 的分支 */
+static double mb_conv_mm(size_t n) {
+    if (n <= long_threshold) {
+        return 3.0 * log2_64(n) / 2 + 1;
+    }
+    return 3 * 1.25 + (mb_conv_mm(n / 2) + mb_conv_mm(n / 4)) / 2;
+}
+
+static double mb_conv_bytes(size_t n) {
+    if (n <= long_threshold) {
+        return 48;
+    }
+    return 48 + (mb_conv_bytes(n / 2) + mb_conv_bytes(n / 4)) / 2;
+}
+
+static double mb_bw;    // B/ns
+static double mb_mm_ns; // 每次 Montgomery 乘法的最短时间
+
+static void mb_report(const char* name, mb_kernel fn, mb_ctx* ctx, double bytes, double mm) {
+    double ns = mb_time(fn, ctx) / ctx->n;
+    double mem_ns = bytes / mb_bw, cmp_ns = mm * mb_mm_ns;
+    double roof = (mem_ns > cmp_ns) ? mem_ns : cmp_ns;
+    printf("%-16s %10zu %9.3f %7.1f %8.2f %8.2f %6.1f%%  %s\n", name, ctx->n, ns, bytes, bytes / ns, mm,
+           roof / ns * 100, (mem_ns > cmp_ns) ? "memory" : "compute");
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    int max_log = 22;
+    if (argc == 3 && strcmp(argv[1], "--max-log") == 0) {
+        max_log = atoi(argv[2]);
+    }
+    if ((argc != 1 && argc != 3) || max_log < 18 || max_log > 30) {
+        fprintf(stderr, "usage: %s [--max-log b]  (18 <= b <= 30)\n", argv[0]);
+        return 1;
+    }
+    size_t cap = (MB_STREAM_LEN > (1ull << max_log)) ? MB_STREAM_LEN : (1ull << max_log);
+    mont64 *a, *b, *c;
+    ALIGNED_MALLOC(a, mont64, cap * 4); // crt3 的输出接在 a 的后面
+    ALIGNED_MALLOC(b, mont64, cap);
+    ALIGNED_MALLOC(c, mont64, cap);
+    if (a == NULL || b == NULL || c == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 1;
+    }
+    u64 rng = 88172645463325252ull;
+    for (size_t ii = 0; ii < cap; ii++) {
+        rng ^= rng << 13, rng ^= rng >> 7, rng ^= rng << 17;
+        a[ii] = rng % g_mod(3), b[ii] = (rng >> 3) % g_mod(3), c[ii] = (rng >> 7) % g_mod(3);
+    }
+    mb_ctx ctx = {a, b, c, MB_STREAM_LEN, NULL};
+
+    double copy = 16.0 * ctx.n / mb_time(mb_copy, &ctx), triad = 24.0 * ctx.n / mb_time(mb_triad, &ctx);
+    mb_bw = (copy > triad) ? copy : triad;
+    printf("stream copy %.2f GB/s, triad %.2f GB/s\n", copy, triad);
+
+    ctx.n = MB_HOT_LEN;
+    double mul_ns = mb_time(mb_mont_mul, &ctx) / ctx.n, mulinto_ns = mb_time(mb_mont_mulinto, &ctx) / ctx.n;
+    double chain_ns = mb_time(mb_mont_mul_chain, &ctx) / ctx.n, mulc_ns = mb_time(mb_mulc, &ctx) / ctx.n;
+    mb_mm_ns = (mul_ns < mulc_ns) ? mul_ns : mulc_ns;
+    printf("_mont_mul %.3f ns/op, _mont_mulinto %.3f ns/op, latency %.3f ns, mulc (simd) %.3f ns/op\n", mul_ns,
+           mulinto_ns, chain_ns, mulc_ns);
+    printf("ridge %.2f mulmod/B\n\n", 1 / (mb_mm_ns * mb_bw));
+
+    printf("%-16s %10s %9s %7s %8s %8s %7s  %s\n", "kernel", "n", "ns/elem", "B/elem", "GB/s", "mm/elem", "roof",
+           "bound");
+    for (size_t lg = 4; (1ull << lg) <= long_threshold; lg++) {
+        ctx.n = 1ull << lg;
+        ctx.table = get_nttshort_func(lg, 1);
+        mb_report("dif", mb_dif, &ctx, 16, lg / 2.0);
+        mb_report("idit", mb_idit, &ctx, 16, lg / 2.0);
+    }
+    for (size_t lg = log2_64(long_threshold) + 1; lg <= (size_t)max_log; lg++) {
+        ctx.n = 1ull << lg;
+        mb_report("dif244 level", mb_dif244, &ctx, 16, 1.25);
+        mb_report("idit244 level", mb_idit244, &ctx, 16, 1.25);
+    }
+    ctx.table = get_nttshort_func(log2_64(long_threshold), 1);
+    for (size_t lg = 16; lg <= (size_t)max_log; lg += 2) {
+        ctx.n = 1ull << lg;
+        mb_report("conv_rec", mb_conv_rec, &ctx, mb_conv_bytes(ctx.n), mb_conv_mm(ctx.n));
+    }
+    for (size_t lg = 12; lg <= (size_t)max_log; lg += 4) {
+        ctx.n = 1ull << lg;
+        mb_report("crt3", mb_crt3, &ctx, 32, 6);
+    }
+    const size_t table_log = log2_64(long_threshold);
+    ntt_short table = {long_threshold, table_log, NULL, NULL};
+    create_nttshort_func(table_log, &table, 1);
+    ctx.table = &table;
+    for (size_t lg = 8; lg <= table_log; lg += 3) {
+        table.ntt_len = 1ull << lg, table.log_len = lg;
+        ctx.n = table.ntt_len;
+        mb_report("cover_nttshort", mb_cover, &ctx, 16, 2);
+    }
+    destroy_nttshort_stack(&table);
+
+    ALIGNED_FREE(a);
+    ALIGNED_FREE(b);
+    ALIGNED_FREE(c);
+    return 0;
+}
@@ -0,0 +1,150 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * 平台适配: 线程, 互斥量, 条件变量与 C11 原子操作, 以及 _aligned_malloc.
+ * GCC / Clang (含 MinGW) 直接用 pthread 与 <stdatomic.h>; MSVC 没有这两者, 这里用 Win32 的 SRWLOCK,
+ * CONDITION_VARIABLE, 线程句柄与 Interlocked 函数实现用到的子集 (只支持 x64, 原子量都是 64 位).
+ * 非 Windows 平台没有 _aligned_malloc, 用 posix_memalign 代替.
+ */
+#ifndef PORT_H
+#define PORT_H
+
+#include <stdlib.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <windows.h>
+
+typedef SRWLOCK pthread_mutex_t;
+typedef CONDITION_VARIABLE pthread_cond_t;
+typedef HANDLE pthread_t;
+
+#define PTHREAD_MUTEX_INITIALIZER SRWLOCK_INIT
+
+static inline int pthread_mutex_init(pthread_mutex_t* m, const void* attr) {
+    (void)attr;
+    InitializeSRWLock(m);
+    return 0;
+}
+static inline int pthread_mutex_destroy(pthread_mutex_t* m) {
+    (void)m;
+    return 0;
+}
+static inline int pthread_mutex_lock(pthread_mutex_t* m) {
+    AcquireSRWLockExclusive(m);
+    return 0;
+}
+static inline int pthread_mutex_unlock(pthread_mutex_t* m) {
+    ReleaseSRWLockExclusive(m);
+    return 0;
+}
+static inline int pthread_cond_init(pthread_cond_t* c, const void* attr) {
+    (void)attr;
+    InitializeConditionVariable(c);
+    return 0;
+}
+static inline int pthread_cond_destroy(pthread_cond_t* c) {
+    (void)c;
+    return 0;
+}
+static inline int pthread_cond_wait(pthread_cond_t* c, pthread_mutex_t* m) {
+    return SleepConditionVariableSRW(c, m, INFINITE, 0) ? 0 : -1;
+}
+static inline int pthread_cond_signal(pthread_cond_t* c) {
+    WakeConditionVariable(c);
+    return 0;
+}
+static inline int pthread_cond_broadcast(pthread_cond_t* c) {
+    WakeAllConditionVariable(c);
+    return 0;
+}
+
+typedef struct {
+    void* (*func)(void*);
+    void* arg;
+} port_thread_start;
+
+static DWORD WINAPI port_thread_entry(LPVOID param) {
+    port_thread_start start = *(port_thread_start*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+
+static inline int pthread_create(pthread_t* tid, const void* attr, void* (*func)(void*), void* arg) {
+    (void)attr;
+    port_thread_start* start = (port_thread_start*)malloc(sizeof(port_thread_start));
+    if (start == NULL) {
+        return -1;
+    }
+    start->func = func, start->arg = arg;
+    *tid = CreateThread(NULL, 0, port_thread_entry, start, 0, NULL);
+    if (*tid == NULL) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+static inline int pthread_join(pthread_t tid, void** ret) {
+    (void)ret;
+    WaitForSingleObject(tid, INFINITE);
+    CloseHandle(tid);
+    return 0;
+}
+static inline int sched_yield(void) {
+    SwitchToThread();
+    return 0;
+}
+
+/* 原子量: 读为 volatile 读 (x64 上即 acquire), 写与读改写用 Interlocked (完整屏障) */
+typedef volatile LONG64 atomic_size_t;
+typedef volatile LONG64 atomic_bool;
+
+#define memory_order_relaxed 0
+#define memory_order_acquire 2
+#define memory_order_release 3
+#define memory_order_seq_cst 5
+
+#define atomic_init(p, v) (*(p) = (LONG64)(v))
+#define atomic_load(p) (*(p))
+#define atomic_load_explicit(p, order) (*(p))
+#define atomic_store(p, v) ((void)InterlockedExchange64((p), (LONG64)(v)))
+#define atomic_store_explicit(p, v, order) atomic_store(p, v)
+#define atomic_fetch_add(p, v) ((size_t)InterlockedExchangeAdd64((p), (LONG64)(v)))
+#define atomic_fetch_add_explicit(p, v, order) atomic_fetch_add(p, v)
+#define atomic_fetch_sub(p, v) ((size_t)InterlockedExchangeAdd64((p), -(LONG64)(v)))
+#define atomic_fetch_sub_explicit(p, v, order) atomic_fetch_sub(p, v)
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#endif
+
+#ifndef _WIN32
+static inline void* _aligned_malloc(size_t size, size_t align) {
+    void* ptr = NULL;
+    return (posix_memalign(&ptr, align, size) == 0) ? ptr : NULL;
+}
+static inline void _aligned_free(void* ptr) { free(ptr); }
+#endif
+
+#endif
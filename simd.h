@@ -0,0 +1,659 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * AVX2 (4 lanes) / AVX-512 (8 lanes) 版本的 Montgomery 运算与蝶形.
+ * 编译期选择: -mavx2 启用 v4, -mavx512f -mavx512dq 再启用 v8.
+ *
+ * 64x64->128 用 4 次 vpmuludq 的部分积拼出, 运算顺序与 macro.h 中的标量宏完全一致,
+ * 因此向量路径与标量路径的结果逐位相同:
+ *   _mont_mul(x, y) = hi(x*y) + hi(m*mod) + (lo(x*y) != 0),  m = lo(x*y) * modInvNeg
+ *
+ * 每个 simd 循环返回已处理到的下标, 剩余部分由调用者用标量代码完成.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NTT_SIMD_V4 1
+#else
+#define NTT_SIMD_V4 0
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#define NTT_SIMD_V8 1
+#else
+#define NTT_SIMD_V8 0
+#endif
+
+#if NTT_SIMD_V4
+
+typedef __m256i v4u64;
+
+#define v4_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define v4_store(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define v4_set1(x) _mm256_set1_epi64x((long long)(x))
+
+// return hi(a * b), *lo = lo(a * b)
+INLINE v4u64 v4_mul128(v4u64 a, v4u64 b, v4u64* lo) {
+    const v4u64 mask = _mm256_set1_epi64x(0xffffffffll);
+    v4u64 a1 = _mm256_srli_epi64(a, 32), b1 = _mm256_srli_epi64(b, 32);
+    v4u64 p00 = _mm256_mul_epu32(a, b), p01 = _mm256_mul_epu32(a, b1);
+    v4u64 p10 = _mm256_mul_epu32(a1, b), p11 = _mm256_mul_epu32(a1, b1);
+    v4u64 mid = _mm256_add_epi64(_mm256_srli_epi64(p00, 32), _mm256_and_si256(p01, mask));
+    mid = _mm256_add_epi64(mid, _mm256_and_si256(p10, mask));
+    *lo = _mm256_or_si256(_mm256_slli_epi64(mid, 32), _mm256_and_si256(p00, mask));
+    v4u64 hi = _mm256_add_epi64(p11, _mm256_srli_epi64(p01, 32));
+    hi = _mm256_add_epi64(hi, _mm256_srli_epi64(p10, 32));
+    return _mm256_add_epi64(hi, _mm256_srli_epi64(mid, 32));
+}
+
+// lo(a * b)
+INLINE v4u64 v4_mullo(v4u64 a, v4u64 b) {
+    v4u64 a1 = _mm256_srli_epi64(a, 32), b1 = _mm256_srli_epi64(b, 32);
+    v4u64 cross = _mm256_add_epi64(_mm256_mul_epu32(a, b1), _mm256_mul_epu32(a1, b));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+// a > b (unsigned)
+INLINE v4u64 v4_cmpgt(v4u64 a, v4u64 b) {
+    const v4u64 sign = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+INLINE v4u64 v4_mont_mul(v4u64 x, v4u64 y, v4u64 mod, v4u64 modInvNeg) {
+    v4u64 lo, mlo;
+    v4u64 hi = v4_mul128(x, y, &lo);
+    v4u64 m = v4_mullo(lo, modInvNeg);
+    v4u64 mhi = v4_mul128(m, mod, &mlo);
+    v4u64 carry = _mm256_add_epi64(_mm256_cmpeq_epi64(lo, _mm256_setzero_si256()), _mm256_set1_epi64x(1));
+    return _mm256_add_epi64(_mm256_add_epi64(hi, mhi), carry);
+}
+
+// r = x < mod ? x : x - mod
+INLINE v4u64 v4_norm(v4u64 x, v4u64 mod) { return _mm256_sub_epi64(x, _mm256_andnot_si256(v4_cmpgt(mod, x), mod)); }
+
+INLINE v4u64 v4_mont_mulinto(v4u64 x, v4u64 y, v4u64 mod, v4u64 modInvNeg) {
+    return v4_norm(v4_mont_mul(x, y, mod, modInvNeg), mod);
+}
+
+INLINE v4u64 v4_mont_add(v4u64 x, v4u64 y, v4u64 mod2) { return v4_norm(_mm256_add_epi64(x, y), mod2); }
+
+INLINE v4u64 v4_mont_sub(v4u64 x, v4u64 y, v4u64 mod2) {
+    return _mm256_add_epi64(_mm256_sub_epi64(x, y), _mm256_and_si256(v4_cmpgt(y, x), mod2));
+}
+
+INLINE v4u64 v4_raw_add(v4u64 x, v4u64 y) { return _mm256_add_epi64(x, y); }
+
+INLINE v4u64 v4_raw_sub(v4u64 x, v4u64 y, v4u64 mod2) { return _mm256_add_epi64(_mm256_sub_epi64(x, y), mod2); }
+
+// 4x4 转置, 用于一次处理 4 个相邻的短 NTT 块
+INLINE void v4_transpose(v4u64* r0, v4u64* r1, v4u64* r2, v4u64* r3) {
+    v4u64 t0 = _mm256_unpacklo_epi64(*r0, *r1), t1 = _mm256_unpackhi_epi64(*r0, *r1);
+    v4u64 t2 = _mm256_unpacklo_epi64(*r2, *r3), t3 = _mm256_unpackhi_epi64(*r2, *r3);
+    *r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    *r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    *r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    *r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+#endif
+
+#if NTT_SIMD_V8
+
+typedef __m512i v8u64;
+
+#define v8_load(p) _mm512_loadu_si512((const void*)(p))
+#define v8_store(p, v) _mm512_storeu_si512((void*)(p), (v))
+#define v8_set1(x) _mm512_set1_epi64((long long)(x))
+
+INLINE v8u64 v8_mul128(v8u64 a, v8u64 b, v8u64* lo) {
+    const v8u64 mask = _mm512_set1_epi64(0xffffffffll);
+    v8u64 a1 = _mm512_srli_epi64(a, 32), b1 = _mm512_srli_epi64(b, 32);
+    v8u64 p00 = _mm512_mul_epu32(a, b), p01 = _mm512_mul_epu32(a, b1);
+    v8u64 p10 = _mm512_mul_epu32(a1, b), p11 = _mm512_mul_epu32(a1, b1);
+    v8u64 mid = _mm512_add_epi64(_mm512_srli_epi64(p00, 32), _mm512_and_si512(p01, mask));
+    mid = _mm512_add_epi64(mid, _mm512_and_si512(p10, mask));
+    *lo = _mm512_or_si512(_mm512_slli_epi64(mid, 32), _mm512_and_si512(p00, mask));
+    v8u64 hi = _mm512_add_epi64(p11, _mm512_srli_epi64(p01, 32));
+    hi = _mm512_add_epi64(hi, _mm512_srli_epi64(p10, 32));
+    return _mm512_add_epi64(hi, _mm512_srli_epi64(mid, 32));
+}
+
+INLINE v8u64 v8_mont_mul(v8u64 x, v8u64 y, v8u64 mod, v8u64 modInvNeg) {
+    v8u64 lo, mlo;
+    v8u64 hi = v8_mul128(x, y, &lo);
+    v8u64 m = _mm512_mullo_epi64(lo, modInvNeg);
+    v8u64 mhi = v8_mul128(m, mod, &mlo);
+    v8u64 r = _mm512_add_epi64(hi, mhi);
+    return _mm512_mask_add_epi64(r, _mm512_test_epi64_mask(lo, lo), r, _mm512_set1_epi64(1));
+}
+
+INLINE v8u64 v8_norm(v8u64 x, v8u64 mod) { return _mm512_mask_sub_epi64(x, _mm512_cmpge_epu64_mask(x, mod), x, mod); }
+
+INLINE v8u64 v8_mont_mulinto(v8u64 x, v8u64 y, v8u64 mod, v8u64 modInvNeg) {
+    return v8_norm(v8_mont_mul(x, y, mod, modInvNeg), mod);
+}
+
+INLINE v8u64 v8_mont_add(v8u64 x, v8u64 y, v8u64 mod2) { return v8_norm(_mm512_add_epi64(x, y), mod2); }
+
+INLINE v8u64 v8_mont_sub(v8u64 x, v8u64 y, v8u64 mod2) {
+    v8u64 d = _mm512_sub_epi64(x, y);
+    return _mm512_mask_add_epi64(d, _mm512_cmpgt_epu64_mask(y, x), d, mod2);
+}
+
+INLINE v8u64 v8_raw_add(v8u64 x, v8u64 y) { return _mm512_add_epi64(x, y); }
+
+INLINE v8u64 v8_raw_sub(v8u64 x, v8u64 y, v8u64 mod2) { return _mm512_add_epi64(_mm512_sub_epi64(x, y), mod2); }
+
+#endif
+
+/* 与 core.h 中标量蝶形一一对应, V 为 v4 或 v8 */
+#define _v_mont_mul_func(V, x, y, _i) V##_mont_mul(x, y, V##_set1(g_mod(_i)), V##_set1(g_modInvNeg(_i)))
+#define _v_mont_mulinto_func(V, x, y, _i) V##_mont_mulinto(x, y, V##_set1(g_mod(_i)), V##_set1(g_modInvNeg(_i)))
+#define _v_mont_add_func(V, x, y, _i) V##_mont_add(x, y, V##_set1(g_mod2(_i)))
+#define _v_mont_sub_func(V, x, y, _i) V##_mont_sub(x, y, V##_set1(g_mod2(_i)))
+#define _v_mont_norm2_func(V, x, _i) V##_norm(x, V##_set1(g_mod2(_i)))
+#define _v_raw_add_func(V, x, y, _i) V##_raw_add(x, y)
+#define _v_raw_sub_func(V, x, y, _i) V##_raw_sub(x, y, V##_set1(g_mod2(_i)))
+
+#define _v_transform2(V, sum, diff, _i)               \
+    do {                                              \
+        V##u64 _t = sum, _u = diff;                   \
+        sum = _v_mont_add_func(V, _t, _u, _i);        \
+        diff = _v_mont_sub_func(V, _t, _u, _i);       \
+    } while (0)
+
+#define _v_dif_butterfly2(V, r0, r1, o, _i)            \
+    do {                                               \
+        V##u64 _x = _v_mont_add_func(V, r0, r1, _i);   \
+        V##u64 _y = _v_raw_sub_func(V, r0, r1, _i);    \
+        r0 = _x;                                       \
+        r1 = _v_mont_mul_func(V, _y, o, _i);           \
+    } while (0)
+
+#define _v_dit_butterfly2(V, r0, r1, o, _i)            \
+    do {                                               \
+        V##u64 _x = _v_mont_norm2_func(V, r0, _i);     \
+        V##u64 _y = _v_mont_mul_func(V, r1, o, _i);    \
+        r0 = _v_raw_add_func(V, _x, _y, _i);           \
+        r1 = _v_raw_sub_func(V, _x, _y, _i);           \
+    } while (0)
+
+#define _v_dif_butterfly244(V, r0, r1, r2, r3, _i)                   \
+    do {                                                             \
+        V##u64 _t0 = _v_raw_add_func(V, r0, r2, _i);                 \
+        V##u64 _t2 = _v_mont_sub_func(V, r0, r2, _i);                \
+        V##u64 _t1 = _v_raw_add_func(V, r1, r3, _i);                 \
+        V##u64 _t3 = _v_raw_sub_func(V, r1, r3, _i);                 \
+        _t3 = _v_mont_mul_func(V, _t3, V##_set1(g_w41(_i)), _i);     \
+        r0 = _v_mont_norm2_func(V, _t0, _i);                         \
+        r1 = _v_mont_norm2_func(V, _t1, _i);                         \
+        r2 = _v_raw_add_func(V, _t2, _t3, _i);                       \
+        r3 = _v_raw_sub_func(V, _t2, _t3, _i);                       \
+    } while (0)
+
+#define _v_idit_butterfly244(V, r0, r1, r2, r3, _i)                  \
+    do {                                                             \
+        V##u64 _t0 = _v_mont_norm2_func(V, r0, _i);                  \
+        V##u64 _t1 = _v_mont_norm2_func(V, r1, _i);                  \
+        V##u64 _t2 = _v_mont_add_func(V, r2, r3, _i);                \
+        V##u64 _t3 = _v_raw_sub_func(V, r2, r3, _i);                 \
+        _t3 = _v_mont_mul_func(V, _t3, V##_set1(g_w41inv(_i)), _i);  \
+        r0 = _v_raw_add_func(V, _t0, _t2, _i);                       \
+        r2 = _v_raw_sub_func(V, _t0, _t2, _i);                       \
+        r1 = _v_raw_add_func(V, _t1, _t3, _i);                       \
+        r3 = _v_raw_sub_func(V, _t1, _t3, _i);                       \
+    } while (0)
+
+/* dif / idit 中一个 rank 的 radix-4 循环, 处理 [ii, gap) 中 W 的整数倍部分 */
+#define define_simd_rank(V, W, _i)                                                                              \
+    INLINE size_t V##_dif_rank_##_i(mont64* it0, mont64* it1, mont64* it2, mont64* it3, const mont64* omega_it, \
+                                    const mont64* last_omega_it, size_t gap, size_t ii) {                       \
+        for (; ii + W <= gap; ii += W) {                                                                        \
+            V##u64 temp0 = V##_load(it0 + ii), temp1 = V##_load(it1 + ii);                                      \
+            V##u64 temp2 = V##_load(it2 + ii), temp3 = V##_load(it3 + ii);                                      \
+            V##u64 omega = V##_load(last_omega_it + ii);                                                        \
+            _v_dif_butterfly2(V, temp0, temp2, V##_load(omega_it + ii), _i);                                    \
+            _v_dif_butterfly2(V, temp1, temp3, V##_load(omega_it + gap + ii), _i);                              \
+            _v_dif_butterfly2(V, temp0, temp1, omega, _i);                                                      \
+            _v_dif_butterfly2(V, temp2, temp3, omega, _i);                                                      \
+            V##_store(it0 + ii, temp0), V##_store(it1 + ii, temp1);                                             \
+            V##_store(it2 + ii, temp2), V##_store(it3 + ii, temp3);                                             \
+        }                                                                                                       \
+        return ii;                                                                                              \
+    }                                                                                                           \
+    /* 同 dif_rank, 但 it2 / it3 已知为 0, 处理 [ii, end) */                                                            \
+    INLINE size_t V##_dif_rank_half_##_i(mont64* it0, mont64* it1, mont64* it2, mont64* it3, const mont64* omega_it, \
+                                         const mont64* last_omega_it, size_t gap, size_t end, size_t ii) {      \
+        for (; ii + W <= end; ii += W) {                                                                        \
+            V##u64 temp0 = V##_load(it0 + ii), temp1 = V##_load(it1 + ii);                                      \
+            V##u64 temp2 = V##_set1(0), temp3 = V##_set1(0);                                                    \
+            V##u64 omega = V##_load(last_omega_it + ii);                                                        \
+            _v_dif_butterfly2(V, temp0, temp2, V##_load(omega_it + ii), _i);                                    \
+            _v_dif_butterfly2(V, temp1, temp3, V##_load(omega_it + gap + ii), _i);                              \
+            _v_dif_butterfly2(V, temp0, temp1, omega, _i);                                                      \
+            _v_dif_butterfly2(V, temp2, temp3, omega, _i);                                                      \
+            V##_store(it0 + ii, temp0), V##_store(it1 + ii, temp1);                                             \
+            V##_store(it2 + ii, temp2), V##_store(it3 + ii, temp3);                                             \
+        }                                                                                                       \
+        return ii;                                                                                              \
+    }                                                                                                           \
+    INLINE size_t V##_idit_rank_##_i(mont64* it0, mont64* it1, mont64* it2, mont64* it3, const mont64* omega_it, \
+                                     const mont64* last_omega_it, size_t gap, size_t ii) {                      \
+        for (; ii + W <= gap; ii += W) {                                                                        \
+            V##u64 temp0 = V##_load(it0 + ii), temp1 = V##_load(it1 + ii);                                      \
+            V##u64 temp2 = V##_load(it2 + ii), temp3 = V##_load(it3 + ii);                                      \
+            V##u64 omega = V##_load(last_omega_it + ii);                                                        \
+            _v_dit_butterfly2(V, temp0, temp1, omega, _i);                                                      \
+            _v_dit_butterfly2(V, temp2, temp3, omega, _i);                                                      \
+            _v_dit_butterfly2(V, temp0, temp2, V##_load(omega_it + ii), _i);                                    \
+            _v_dit_butterfly2(V, temp1, temp3, V##_load(omega_it + gap + ii), _i);                              \
+            V##_store(it0 + ii, temp0), V##_store(it1 + ii, temp1);                                             \
+            V##_store(it2 + ii, temp2), V##_store(it3 + ii, temp3);                                             \
+        }                                                                                                       \
+        return ii;                                                                                              \
+    }
+
+/* out = in1 * in2 (norm 时再乘 inv_len) */
+#define define_simd_pointwise(V, W, _i)                                                                          \
+    INLINE size_t V##_pointwise_##_i(mont64* out, const mont64* in1, const mont64* in2, size_t len, bool norm,   \
+                                     mont64 inv_len, size_t ii) {                                                \
+        if (norm) {                                                                                              \
+            V##u64 inv = V##_set1(inv_len);                                                                      \
+            for (; ii + W <= len; ii += W) {                                                                     \
+                V##u64 r = _v_mont_mul_func(V, V##_load(in1 + ii), V##_load(in2 + ii), _i);                      \
+                V##_store(out + ii, _v_mont_mulinto_func(V, r, inv, _i));                                        \
+            }                                                                                                    \
+        } else {                                                                                                 \
+            for (; ii + W <= len; ii += W) {                                                                     \
+                V##_store(out + ii, _v_mont_mul_func(V, V##_load(in1 + ii), V##_load(in2 + ii), _i));            \
+            }                                                                                                    \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/* out = in * R mod p, 输入为任意 u64 (未约化), 结果为规范值 */
+#define define_simd_tomont(V, W, _i)                                                                             \
+    INLINE size_t V##_tomont_##_i(const u64* in, mont64* out, size_t len, size_t ii) {                           \
+        V##u64 r2 = V##_set1(g_r2(_i));                                                                          \
+        for (; ii + W <= len; ii += W) {                                                                         \
+            V##_store(out + ii, _v_mont_mulinto_func(V, V##_load(in + ii), r2, _i));                             \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/* out = in * c (mulinto, 规范值); c 为普通整数时即 crt3 中的 "乘逆并转回普通整数" */
+#define define_simd_mulc(V, W, _i)                                                                               \
+    INLINE size_t V##_mulc_##_i(const mont64* in, u64* out, u64 c, size_t len, size_t ii) {                      \
+        V##u64 cv = V##_set1(c);                                                                                 \
+        for (; ii + W <= len; ii += W) {                                                                         \
+            V##_store(out + ii, _v_mont_mulinto_func(V, V##_load(in + ii), cv, _i));                             \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/* 一次读入 in, 同时写出三个模数下的 Montgomery 形式 */
+#define define_simd_tomont3(V, W)                                                                                \
+    INLINE size_t V##_tomont3(const u64* in, mont64* out1, mont64* out2, mont64* out3, size_t len, size_t ii) {  \
+        V##u64 r1 = V##_set1(g_r2(1)), r2 = V##_set1(g_r2(2)), r3 = V##_set1(g_r2(3));                           \
+        for (; ii + W <= len; ii += W) {                                                                         \
+            V##u64 x = V##_load(in + ii);                                                                        \
+            V##_store(out1 + ii, _v_mont_mulinto_func(V, x, r1, 1));                                             \
+            V##_store(out2 + ii, _v_mont_mulinto_func(V, x, r2, 2));                                             \
+            V##_store(out3 + ii, _v_mont_mulinto_func(V, x, r3, 3));                                             \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/*
+ * conv_rec 大层的 radix-4 循环, 处理一个 twiddle 块 [ii, end).
+ * 块内 omega = base * pw[ii - blk], 各 lane 互不依赖; 结果是规范值, 与标量相同.
+ */
+#define define_simd_pass244(V, W, _i)                                                                            \
+    INLINE size_t V##_dif244_##_i(mont64* in, size_t quarter_len, size_t blk, size_t ii, size_t end,             \
+                                  mont64 base1, mont64 base3, const mont64* pw1, const mont64* pw3) {            \
+        V##u64 b1 = V##_set1(base1), b3 = V##_set1(base3);                                                       \
+        for (; ii + W <= end; ii += W) {                                                                         \
+            V##u64 w1 = _v_mont_mulinto_func(V, b1, V##_load(pw1 + ii - blk), _i);                               \
+            V##u64 w3 = _v_mont_mulinto_func(V, b3, V##_load(pw3 + ii - blk), _i);                               \
+            V##u64 temp0 = V##_load(in + ii), temp1 = V##_load(in + quarter_len + ii);                           \
+            V##u64 temp2 = V##_load(in + quarter_len * 2 + ii), temp3 = V##_load(in + quarter_len * 3 + ii);     \
+            _v_dif_butterfly244(V, temp0, temp1, temp2, temp3, _i);                                              \
+            V##_store(in + ii, temp0), V##_store(in + quarter_len + ii, temp1);                                  \
+            V##_store(in + quarter_len * 2 + ii, _v_mont_mul_func(V, temp2, w1, _i));                            \
+            V##_store(in + quarter_len * 3 + ii, _v_mont_mul_func(V, temp3, w3, _i));                            \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }                                                                                                            \
+    /* 同 dif244, 但后两个 quarter 已知为 0; 前两个 quarter 的结果等于输入 (< 2p), 不写回 */                          \
+    INLINE size_t V##_dif244_half_##_i(mont64* in, size_t quarter_len, size_t blk, size_t ii, size_t end,        \
+                                       mont64 base1, mont64 base3, const mont64* pw1, const mont64* pw3) {       \
+        V##u64 b1 = V##_set1(base1), b3 = V##_set1(base3);                                                       \
+        for (; ii + W <= end; ii += W) {                                                                         \
+            V##u64 w1 = _v_mont_mulinto_func(V, b1, V##_load(pw1 + ii - blk), _i);                               \
+            V##u64 w3 = _v_mont_mulinto_func(V, b3, V##_load(pw3 + ii - blk), _i);                               \
+            V##u64 temp0 = V##_load(in + ii), temp1 = V##_load(in + quarter_len + ii);                           \
+            V##u64 temp2 = V##_set1(0), temp3 = V##_set1(0);                                                     \
+            _v_dif_butterfly244(V, temp0, temp1, temp2, temp3, _i);                                              \
+            V##_store(in + quarter_len * 2 + ii, _v_mont_mul_func(V, temp2, w1, _i));                            \
+            V##_store(in + quarter_len * 3 + ii, _v_mont_mul_func(V, temp3, w3, _i));                            \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }                                                                                                            \
+    INLINE size_t V##_idit244_##_i(mont64* out, size_t quarter_len, size_t blk, size_t ii, size_t end,           \
+                                   mont64 base1, mont64 base3, const mont64* pw1, const mont64* pw3,             \
+                                   mont64 inv_len, bool norm) {                                                  \
+        V##u64 b1 = V##_set1(base1), b3 = V##_set1(base3), inv = V##_set1(inv_len);                              \
+        for (; ii + W <= end; ii += W) {                                                                         \
+            V##u64 w1 = _v_mont_mulinto_func(V, b1, V##_load(pw1 + ii - blk), _i);                               \
+            V##u64 w3 = _v_mont_mulinto_func(V, b3, V##_load(pw3 + ii - blk), _i);                               \
+            V##u64 temp0 = V##_load(out + ii), temp1 = V##_load(out + quarter_len + ii);                         \
+            V##u64 temp2 = V##_load(out + quarter_len * 2 + ii), temp3 = V##_load(out + quarter_len * 3 + ii);   \
+            if (norm) {                                                                                          \
+                temp0 = _v_mont_mul_func(V, temp0, inv, _i);                                                     \
+                temp1 = _v_mont_mul_func(V, temp1, inv, _i);                                                     \
+            }                                                                                                    \
+            temp2 = _v_mont_mul_func(V, temp2, w1, _i);                                                          \
+            temp3 = _v_mont_mul_func(V, temp3, w3, _i);                                                          \
+            _v_idit_butterfly244(V, temp0, temp1, temp2, temp3, _i);                                             \
+            V##_store(out + ii, temp0), V##_store(out + quarter_len + ii, temp1);                                \
+            V##_store(out + quarter_len * 2 + ii, temp2), V##_store(out + quarter_len * 3 + ii, temp3);          \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/* 3 * 2^k / 5 * 2^k 变换的顶层 radix 遍, 与 core.h 的 dft_odd 相同, 加减按 mod 取规范值 */
+#define _v_mod_add_func(V, x, y, _i) V##_mont_add(x, y, V##_set1(g_mod(_i)))
+#define _v_mod_sub_func(V, x, y, _i) V##_mont_sub(x, y, V##_set1(g_mod(_i)))
+
+#define define_simd_radix(V, W, _i)                                                                              \
+    INLINE void V##_dft_odd_##_i(V##u64 x[], const mont64 cs[], size_t m) {                                      \
+        const size_t half = m / 2;                                                                               \
+        V##u64 sum[NTT_RADIX_MAX / 2 + 1], dif[NTT_RADIX_MAX / 2 + 1], x0 = x[0];                                \
+        for (size_t jj = 1; jj <= half; jj++) {                                                                  \
+            sum[jj] = _v_mod_add_func(V, x[jj], x[m - jj], _i);                                                  \
+            dif[jj] = _v_mod_sub_func(V, x[jj], x[m - jj], _i);                                                  \
+            x[0] = _v_mod_add_func(V, x[0], sum[jj], _i);                                                        \
+        }                                                                                                        \
+        for (size_t rr = 1; rr <= half; rr++) {                                                                  \
+            V##u64 a = x0, b = V##_set1(0);                                                                      \
+            for (size_t jj = 1, kk = rr; jj <= half; jj++, kk = (kk + rr) % m) {                                 \
+                a = _v_mod_add_func(V, a, _v_mont_mulinto_func(V, sum[jj], V##_set1(cs[kk]), _i), _i);           \
+                b = _v_mod_add_func(V, b, _v_mont_mulinto_func(V, dif[jj], V##_set1(cs[m + kk]), _i), _i);       \
+            }                                                                                                    \
+            x[rr] = _v_mod_add_func(V, a, b, _i);                                                                \
+            x[m - rr] = _v_mod_sub_func(V, a, b, _i);                                                            \
+        }                                                                                                        \
+    }                                                                                                            \
+    INLINE size_t V##_dif_radix_##_i(mont64* in, size_t K, size_t radix, size_t blk, size_t ii, size_t end,      \
+                                     mont64 base, const mont64* pw, const mont64 cs[]) {                         \
+        V##u64 b = V##_set1(base);                                                                               \
+        for (; ii + W <= end; ii += W) {                                                                         \
+            V##u64 x[NTT_RADIX_MAX] = {V##_set1(0)};                                                             \
+            V##u64 omega = _v_mont_mulinto_func(V, b, V##_load(pw + ii - blk), _i), w = omega;                   \
+            for (size_t rr = 0; rr < radix; rr++) {                                                              \
+                x[rr] = V##_load(in + rr * K + ii);                                                              \
+            }                                                                                                    \
+            V##_dft_odd_##_i(x, cs, radix);                                                                      \
+            V##_store(in + ii, x[0]);                                                                            \
+            for (size_t rr = 1; rr < radix; rr++) {                                                              \
+                V##_store(in + rr * K + ii, _v_mont_mul_func(V, x[rr], w, _i));                                  \
+                w = _v_mont_mulinto_func(V, w, omega, _i);                                                       \
+            }                                                                                                    \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }                                                                                                            \
+    INLINE size_t V##_idit_radix_##_i(mont64* out, size_t K, size_t radix, size_t blk, size_t ii, size_t end,    \
+                                      mont64 base, const mont64* pw, const mont64 cs[], mont64 scale) {          \
+        V##u64 b = V##_set1(base), sc = V##_set1(scale);                                                         \
+        for (; ii + W <= end; ii += W) {                                                                         \
+            V##u64 x[NTT_RADIX_MAX] = {V##_set1(0)};                                                             \
+            V##u64 omega = _v_mont_mulinto_func(V, b, V##_load(pw + ii - blk), _i), w = sc;                      \
+            for (size_t rr = 0; rr < radix; rr++) {                                                              \
+                x[rr] = _v_mont_mulinto_func(V, V##_load(out + rr * K + ii), w, _i);                             \
+                w = _v_mont_mulinto_func(V, w, omega, _i);                                                       \
+            }                                                                                                    \
+            V##_dft_odd_##_i(x, cs, radix);                                                                      \
+            for (size_t rr = 0; rr < radix; rr++) {                                                              \
+                V##_store(out + rr * K + ii, x[rr]);                                                             \
+            }                                                                                                    \
+        }                                                                                                        \
+        return ii;                                                                                               \
+    }
+
+/* 4 个相邻的长度 4 / 8 短 NTT 块转置后按 lane 并行计算 */
+#define define_simd_short(_i)                                                                 \
+    INLINE void v4_ntt_short_dif_4x4_##_i(mont64 in_out[]) {                                  \
+        v4u64 t0 = v4_load(in_out), t1 = v4_load(in_out + 4);                                 \
+        v4u64 t2 = v4_load(in_out + 8), t3 = v4_load(in_out + 12);                            \
+        v4_transpose(&t0, &t1, &t2, &t3);                                                     \
+        _v_transform2(v4, t0, t2, _i);                                                        \
+        _v_transform2(v4, t1, t3, _i);                                                        \
+        t3 = _v_mont_mul_func(v4, t3, v4_set1(g_w41(_i)), _i);                                \
+        v4u64 r0 = _v_mont_add_func(v4, t0, t1, _i), r1 = _v_mont_sub_func(v4, t0, t1, _i);   \
+        v4u64 r2 = _v_mont_add_func(v4, t2, t3, _i), r3 = _v_mont_sub_func(v4, t2, t3, _i);   \
+        v4_transpose(&r0, &r1, &r2, &r3);                                                     \
+        v4_store(in_out, r0), v4_store(in_out + 4, r1);                                       \
+        v4_store(in_out + 8, r2), v4_store(in_out + 12, r3);                                  \
+    }                                                                                         \
+    INLINE void v4_intt_short_dit_4x4_##_i(mont64 in_out[]) {                                 \
+        v4u64 t0 = v4_load(in_out), t1 = v4_load(in_out + 4);                                 \
+        v4u64 t2 = v4_load(in_out + 8), t3 = v4_load(in_out + 12);                            \
+        v4_transpose(&t0, &t1, &t2, &t3);                                                     \
+        _v_transform2(v4, t0, t1, _i);                                                        \
+        _v_transform2(v4, t2, t3, _i);                                                        \
+        t3 = _v_mont_mul_func(v4, t3, v4_set1(g_w41inv(_i)), _i);                             \
+        v4u64 r0 = _v_mont_add_func(v4, t0, t2, _i), r1 = _v_mont_add_func(v4, t1, t3, _i);   \
+        v4u64 r2 = _v_mont_sub_func(v4, t0, t2, _i), r3 = _v_mont_sub_func(v4, t1, t3, _i);   \
+        v4_transpose(&r0, &r1, &r2, &r3);                                                     \
+        v4_store(in_out, r0), v4_store(in_out + 4, r1);                                       \
+        v4_store(in_out + 8, r2), v4_store(in_out + 12, r3);                                  \
+    }                                                                                         \
+    INLINE void v4_ntt_short_dif_8x4_##_i(mont64 in_out[]) {                                  \
+        v4u64 t0 = v4_load(in_out), t1 = v4_load(in_out + 8);                                 \
+        v4u64 t2 = v4_load(in_out + 16), t3 = v4_load(in_out + 24);                           \
+        v4u64 t4 = v4_load(in_out + 4), t5 = v4_load(in_out + 12);                            \
+        v4u64 t6 = v4_load(in_out + 20), t7 = v4_load(in_out + 28);                           \
+        v4_transpose(&t0, &t1, &t2, &t3);                                                     \
+        v4_transpose(&t4, &t5, &t6, &t7);                                                     \
+        _v_transform2(v4, t0, t4, _i);                                                        \
+        _v_transform2(v4, t1, t5, _i);                                                        \
+        _v_transform2(v4, t2, t6, _i);                                                        \
+        _v_transform2(v4, t3, t7, _i);                                                        \
+        t5 = _v_mont_mul_func(v4, t5, v4_set1(g_w1(_i)), _i);                                 \
+        t6 = _v_mont_mul_func(v4, t6, v4_set1(g_w2(_i)), _i);                                 \
+        t7 = _v_mont_mul_func(v4, t7, v4_set1(g_w3(_i)), _i);                                 \
+        _v_transform2(v4, t0, t2, _i);                                                        \
+        _v_transform2(v4, t1, t3, _i);                                                        \
+        _v_transform2(v4, t4, t6, _i);                                                        \
+        _v_transform2(v4, t5, t7, _i);                                                        \
+        t3 = _v_mont_mul_func(v4, t3, v4_set1(g_w41(_i)), _i);                                \
+        t7 = _v_mont_mul_func(v4, t7, v4_set1(g_w41(_i)), _i);                                \
+        v4u64 r0 = _v_mont_add_func(v4, t0, t1, _i), r1 = _v_mont_sub_func(v4, t0, t1, _i);   \
+        v4u64 r2 = _v_mont_add_func(v4, t2, t3, _i), r3 = _v_mont_sub_func(v4, t2, t3, _i);   \
+        v4u64 r4 = _v_mont_add_func(v4, t4, t5, _i), r5 = _v_mont_sub_func(v4, t4, t5, _i);   \
+        v4u64 r6 = _v_mont_add_func(v4, t6, t7, _i), r7 = _v_mont_sub_func(v4, t6, t7, _i);   \
+        v4_transpose(&r0, &r1, &r2, &r3);                                                     \
+        v4_transpose(&r4, &r5, &r6, &r7);                                                     \
+        v4_store(in_out, r0), v4_store(in_out + 8, r1);                                       \
+        v4_store(in_out + 16, r2), v4_store(in_out + 24, r3);                                 \
+        v4_store(in_out + 4, r4), v4_store(in_out + 12, r5);                                  \
+        v4_store(in_out + 20, r6), v4_store(in_out + 28, r7);                                 \
+    }                                                                                         \
+    INLINE void v4_intt_short_dit_8x4_##_i(mont64 in_out[]) {                                 \
+        v4u64 t0 = v4_load(in_out), t1 = v4_load(in_out + 8);                                 \
+        v4u64 t2 = v4_load(in_out + 16), t3 = v4_load(in_out + 24);                           \
+        v4u64 t4 = v4_load(in_out + 4), t5 = v4_load(in_out + 12);                            \
+        v4u64 t6 = v4_load(in_out + 20), t7 = v4_load(in_out + 28);                           \
+        v4_transpose(&t0, &t1, &t2, &t3);                                                     \
+        v4_transpose(&t4, &t5, &t6, &t7);                                                     \
+        _v_transform2(v4, t0, t1, _i);                                                        \
+        _v_transform2(v4, t2, t3, _i);                                                        \
+        _v_transform2(v4, t4, t5, _i);                                                        \
+        _v_transform2(v4, t6, t7, _i);                                                        \
+        t3 = _v_mont_mul_func(v4, t3, v4_set1(g_w41inv(_i)), _i);                             \
+        t7 = _v_mont_mul_func(v4, t7, v4_set1(g_w41inv(_i)), _i);                             \
+        _v_transform2(v4, t0, t2, _i);                                                        \
+        _v_transform2(v4, t1, t3, _i);                                                        \
+        _v_transform2(v4, t4, t6, _i);                                                        \
+        _v_transform2(v4, t5, t7, _i);                                                        \
+        t5 = _v_mont_mul_func(v4, t5, v4_set1(g_w1inv(_i)), _i);                              \
+        t6 = _v_mont_mul_func(v4, t6, v4_set1(g_w2inv(_i)), _i);                              \
+        t7 = _v_mont_mul_func(v4, t7, v4_set1(g_w3inv(_i)), _i);                              \
+        v4u64 r0 = _v_mont_add_func(v4, t0, t4, _i), r1 = _v_mont_add_func(v4, t1, t5, _i);   \
+        v4u64 r2 = _v_mont_add_func(v4, t2, t6, _i), r3 = _v_mont_add_func(v4, t3, t7, _i);   \
+        v4u64 r4 = _v_mont_sub_func(v4, t0, t4, _i), r5 = _v_mont_sub_func(v4, t1, t5, _i);   \
+        v4u64 r6 = _v_mont_sub_func(v4, t2, t6, _i), r7 = _v_mont_sub_func(v4, t3, t7, _i);   \
+        v4_transpose(&r0, &r1, &r2, &r3);                                                     \
+        v4_transpose(&r4, &r5, &r6, &r7);                                                     \
+        v4_store(in_out, r0), v4_store(in_out + 8, r1);                                       \
+        v4_store(in_out + 16, r2), v4_store(in_out + 24, r3);                                 \
+        v4_store(in_out + 4, r4), v4_store(in_out + 12, r5);                                  \
+        v4_store(in_out + 20, r6), v4_store(in_out + 28, r7);                                 \
+    }                                                                                         \
+    INLINE size_t v4_ntt_short_dif_##_i(mont64 in_out[], size_t len, size_t _N) {             \
+        size_t ii = 0;                                                                        \
+        if (_N == 4) {                                                                        \
+            for (; ii + 16 <= len; ii += 16) {                                                \
+                v4_ntt_short_dif_4x4_##_i(in_out + ii);                                       \
+            }                                                                                 \
+        } else {                                                                              \
+            for (; ii + 32 <= len; ii += 32) {                                                \
+                v4_ntt_short_dif_8x4_##_i(in_out + ii);                                       \
+            }                                                                                 \
+        }                                                                                     \
+        return ii;                                                                            \
+    }                                                                                         \
+    INLINE size_t v4_intt_short_dit_##_i(mont64 in_out[], size_t len, size_t _N) {            \
+        size_t ii = 0;                                                                        \
+        if (_N == 4) {                                                                        \
+            for (; ii + 16 <= len; ii += 16) {                                                \
+                v4_intt_short_dit_4x4_##_i(in_out + ii);                                      \
+            }                                                                                 \
+        } else {                                                                              \
+            for (; ii + 32 <= len; ii += 32) {                                                \
+                v4_intt_short_dit_8x4_##_i(in_out + ii);                                      \
+            }                                                                                 \
+        }                                                                                     \
+        return ii;                                                                            \
+    }
+
+#if NTT_SIMD_V4
+define_simd_rank(v4, 4, 1) define_simd_rank(v4, 4, 2) define_simd_rank(v4, 4, 3) define_simd_rank(v4, 4, 4) define_simd_rank(v4, 4, 5)
+define_simd_pointwise(v4, 4, 1) define_simd_pointwise(v4, 4, 2) define_simd_pointwise(v4, 4, 3) define_simd_pointwise(v4, 4, 4) define_simd_pointwise(v4, 4, 5)
+define_simd_tomont(v4, 4, 1) define_simd_tomont(v4, 4, 2) define_simd_tomont(v4, 4, 3) define_simd_tomont(v4, 4, 4) define_simd_tomont(v4, 4, 5) define_simd_tomont3(v4, 4)
+define_simd_mulc(v4, 4, 1) define_simd_mulc(v4, 4, 2) define_simd_mulc(v4, 4, 3) define_simd_mulc(v4, 4, 4) define_simd_mulc(v4, 4, 5)
+define_simd_pass244(v4, 4, 1) define_simd_pass244(v4, 4, 2) define_simd_pass244(v4, 4, 3) define_simd_pass244(v4, 4, 4) define_simd_pass244(v4, 4, 5)
+define_simd_radix(v4, 4, 1) define_simd_radix(v4, 4, 2) define_simd_radix(v4, 4, 3)
+define_simd_short(1) define_simd_short(2) define_simd_short(3) define_simd_short(4) define_simd_short(5)
+#endif
+
+#if NTT_SIMD_V8
+define_simd_rank(v8, 8, 1) define_simd_rank(v8, 8, 2) define_simd_rank(v8, 8, 3) define_simd_rank(v8, 8, 4) define_simd_rank(v8, 8, 5)
+define_simd_pointwise(v8, 8, 1) define_simd_pointwise(v8, 8, 2) define_simd_pointwise(v8, 8, 3) define_simd_pointwise(v8, 8, 4) define_simd_pointwise(v8, 8, 5)
+define_simd_tomont(v8, 8, 1) define_simd_tomont(v8, 8, 2) define_simd_tomont(v8, 8, 3) define_simd_tomont(v8, 8, 4) define_simd_tomont(v8, 8, 5) define_simd_tomont3(v8, 8)
+define_simd_mulc(v8, 8, 1) define_simd_mulc(v8, 8, 2) define_simd_mulc(v8, 8, 3) define_simd_mulc(v8, 8, 4) define_simd_mulc(v8, 8, 5)
+define_simd_pass244(v8, 8, 1) define_simd_pass244(v8, 8, 2) define_simd_pass244(v8, 8, 3) define_simd_pass244(v8, 8, 4) define_simd_pass244(v8, 8, 5)
+define_simd_radix(v8, 8, 1) define_simd_radix(v8, 8, 2) define_simd_radix(v8, 8, 3)
+#endif
+
+/*
+ * 供 core.h / main.c 调用的入口, 返回 simd 已处理到的下标.
+ * 未启用 simd 时返回传入的起始下标, 全部交给标量代码.
+ */
+#if NTT_SIMD_V8
+#define _simd_v8(expr8, ii) (expr8)
+#else
+#define _simd_v8(expr8, ii) (ii)
+#endif
+
+#if NTT_SIMD_V4
+#define _simd_v4(expr4, ii) (expr4)
+#else
+#define _simd_v4(expr4, ii) (ii)
+#endif
+
+#define _simd_dif_rank(it0, it1, it2, it3, omega_it, last_omega_it, gap, _i)                                     \
+    _simd_v4(v4_dif_rank_##_i(it0, it1, it2, it3, omega_it, last_omega_it, gap,                                  \
+                              _simd_v8(v8_dif_rank_##_i(it0, it1, it2, it3, omega_it, last_omega_it, gap, 0), 0)), \
+             0)
+
+#define _simd_dif_rank_half(it0, it1, it2, it3, omega_it, last_omega_it, gap, end, _i)                         \
+    _simd_v4(v4_dif_rank_half_##_i(it0, it1, it2, it3, omega_it, last_omega_it, gap, end,                        \
+                                   _simd_v8(v8_dif_rank_half_##_i(it0, it1, it2, it3, omega_it, last_omega_it,   \
+                                                                  gap, end, 0),                                  \
+                                            0)),                                                                 \
+             0)
+
+#define _simd_idit_rank(it0, it1, it2, it3, omega_it, last_omega_it, gap, _i)                                     \
+    _simd_v4(v4_idit_rank_##_i(it0, it1, it2, it3, omega_it, last_omega_it, gap,                                  \
+                               _simd_v8(v8_idit_rank_##_i(it0, it1, it2, it3, omega_it, last_omega_it, gap, 0), 0)), \
+             0)
+
+#define _simd_pointwise(out, in1, in2, len, norm, inv_len, _i)                                         \
+    _simd_v4(v4_pointwise_##_i(out, in1, in2, len, norm, inv_len,                                      \
+                               _simd_v8(v8_pointwise_##_i(out, in1, in2, len, norm, inv_len, 0), 0)), \
+             0)
+
+#define _simd_tomont(in, out, len, _i)                                                                           \
+    _simd_v4(v4_tomont_##_i(in, out, len, _simd_v8(v8_tomont_##_i(in, out, len, 0), 0)), 0)
+
+#define _simd_mulc(in, out, c, len, _i)                                                                          \
+    _simd_v4(v4_mulc_##_i(in, out, c, len, _simd_v8(v8_mulc_##_i(in, out, c, len, 0), 0)), 0)
+
+#define _simd_tomont3(in, out1, out2, out3, len)                                                                 \
+    _simd_v4(v4_tomont3(in, out1, out2, out3, len, _simd_v8(v8_tomont3(in, out1, out2, out3, len, 0), 0)), 0)
+
+#define _simd_dif244(in, quarter_len, blk, end, base1, base3, pw1, pw3, _i)                                      \
+    _simd_v4(v4_dif244_##_i(in, quarter_len, blk,                                                                \
+                            _simd_v8(v8_dif244_##_i(in, quarter_len, blk, blk, end, base1, base3, pw1, pw3), blk), \
+                            end, base1, base3, pw1, pw3),                                                        \
+             blk)
+
+#define _simd_dif244_half(in, quarter_len, blk, end, base1, base3, pw1, pw3, _i)                                 \
+    _simd_v4(v4_dif244_half_##_i(in, quarter_len, blk,                                                           \
+                                 _simd_v8(v8_dif244_half_##_i(in, quarter_len, blk, blk, end, base1, base3, pw1, \
+                                                              pw3),                                              \
+                                          blk),                                                                  \
+                                 end, base1, base3, pw1, pw3),                                                   \
+             blk)
+
+#define _simd_idit244(out, quarter_len, blk, end, base1, base3, pw1, pw3, inv_len, norm, _i)                     \
+    _simd_v4(v4_idit244_##_i(out, quarter_len, blk,                                                              \
+                             _simd_v8(v8_idit244_##_i(out, quarter_len, blk, blk, end, base1, base3, pw1, pw3,   \
+                                                      inv_len, norm),                                            \
+                                      blk),                                                                      \
+                             end, base1, base3, pw1, pw3, inv_len, norm),                                        \
+             blk)
+
+#define _simd_dif_radix(in, K, radix, blk, end, base, pw, cs, _i)                                                \
+    _simd_v4(v4_dif_radix_##_i(in, K, radix, blk, _simd_v8(v8_dif_radix_##_i(in, K, radix, blk, blk, end, base, pw, cs), blk), \
+                               end, base, pw, cs),                                                               \
+             blk)
+
+#define _simd_idit_radix(out, K, radix, blk, end, base, pw, cs, scale, _i)                                       \
+    _simd_v4(v4_idit_radix_##_i(out, K, radix, blk,                                                              \
+                                _simd_v8(v8_idit_radix_##_i(out, K, radix, blk, blk, end, base, pw, cs, scale), blk), \
+                                end, base, pw, cs, scale),                                                       \
+             blk)
+
+#define _simd_ntt_short_dif(in_out, len, _N, _i) _simd_v4(v4_ntt_short_dif_##_i(in_out, len, _N), 0)
+#define _simd_intt_short_dit(in_out, len, _N, _i) _simd_v4(v4_intt_short_dit_##_i(in_out, len, _N), 0)
@@ -0,0 +1,254 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * work-stealing 任务池 (fork-join)
+ *
+ * 每个 worker 一个双端队列: 自己从尾部 push/pop (LIFO), 空闲时从其他队列头部偷 (FIFO).
+ * worker 0 是调用者线程, 只在 task_wait 里参与执行, 同一时刻只允许一个外部线程使用池.
+ * task_wait 在等待期间会执行其他任务, 因此任务内部可以继续 spawn / wait.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "port.h"
+
+typedef void (*task_func)(void* arg);
+
+typedef struct TaskGroup {
+    atomic_size_t pending;
+} task_group;
+
+typedef struct Task {
+    task_func func;
+    void* arg;
+    task_group* group;
+} task;
+
+typedef struct TaskDeque {
+    pthread_mutex_t lock;
+    task* buf;
+    size_t head;
+    size_t tail;
+    size_t cap;
+} task_deque;
+
+struct TaskPool;
+
+typedef struct TaskWorker {
+    struct TaskPool* pool;
+    int id;
+} task_worker;
+
+typedef struct TaskPool {
+    int threads;
+    task_deque* deques;
+    task_worker* workers;
+    pthread_t* tid;
+    int spawned;
+    atomic_size_t queued;
+    atomic_bool stop;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+} task_pool;
+
+static _Thread_local task_pool* task_tls_pool = NULL;
+static _Thread_local int task_tls_id = 0;
+
+INLINE int task_self_id(task_pool* pool) { return (task_tls_pool == pool) ? task_tls_id : 0; }
+
+INLINE void task_group_init(task_group* group) { atomic_init(&group->pending, 0); }
+
+INLINE bool task_deque_push(task_deque* dq, task tk) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->cap) {
+        if (dq->head > 0) {
+            for (size_t ii = dq->head; ii < dq->tail; ii++) {
+                dq->buf[ii - dq->head] = dq->buf[ii];
+            }
+            dq->tail -= dq->head;
+            dq->head = 0;
+        } else {
+            size_t cap = (dq->cap == 0) ? 64 : dq->cap * 2;
+            task* buf = (task*)realloc(dq->buf, cap * sizeof(task));
+            if (buf == NULL) {
+                pthread_mutex_unlock(&dq->lock);
+                return false;
+            }
+            dq->buf = buf;
+            dq->cap = cap;
+        }
+    }
+    dq->buf[dq->tail++] = tk;
+    pthread_mutex_unlock(&dq->lock);
+    return true;
+}
+
+INLINE bool task_deque_pop(task_deque* dq, task* tk) {
+    bool got = false;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) {
+        *tk = dq->buf[--dq->tail];
+        got = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return got;
+}
+
+INLINE bool task_deque_steal(task_deque* dq, task* tk) {
+    bool got = false;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) {
+        *tk = dq->buf[dq->head++];
+        got = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return got;
+}
+
+INLINE bool task_try_run(task_pool* pool, int id) {
+    task tk;
+    bool got = task_deque_pop(pool->deques + id, &tk);
+    for (int kk = 1; !got && kk < pool->threads; kk++) {
+        got = task_deque_steal(pool->deques + (id + kk) % pool->threads, &tk);
+    }
+    if (!got) {
+        return false;
+    }
+    atomic_fetch_sub(&pool->queued, 1);
+    tk.func(tk.arg);
+    atomic_fetch_sub_explicit(&tk.group->pending, 1, memory_order_release);
+    return true;
+}
+
+/* arg 必须在 task_wait(group) 返回之前保持有效 */
+INLINE void task_spawn(task_pool* pool, task_group* group, task_func func, void* arg) {
+    task tk = {func, arg, group};
+    if (pool == NULL || pool->threads <= 1) {
+        func(arg);
+        return;
+    }
+    atomic_fetch_add(&group->pending, 1);
+    if (!task_deque_push(pool->deques + task_self_id(pool), tk)) {
+        atomic_fetch_sub(&group->pending, 1);
+        func(arg);
+        return;
+    }
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+INLINE void task_wait(task_pool* pool, task_group* group) {
+    if (pool == NULL) {
+        return;
+    }
+    int id = task_self_id(pool);
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) != 0) {
+        if (!task_try_run(pool, id)) {
+            sched_yield();
+        }
+    }
+}
+
+static void* task_worker_loop(void* arg) {
+    task_worker* worker = (task_worker*)arg;
+    task_pool* pool = worker->pool;
+    task_tls_pool = pool;
+    task_tls_id = worker->id;
+    while (!atomic_load(&pool->stop)) {
+        if (task_try_run(pool, worker->id)) {
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stop)) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return NULL;
+}
+
+void task_pool_destroy(task_pool** pool) {
+    if (pool == NULL || *pool == NULL) {
+        return;
+    }
+    task_pool* pl = *pool;
+    pthread_mutex_lock(&pl->idle_lock);
+    atomic_store(&pl->stop, true);
+    pthread_cond_broadcast(&pl->idle_cond);
+    pthread_mutex_unlock(&pl->idle_lock);
+    for (int ii = 0; ii < pl->spawned; ii++) {
+        pthread_join(pl->tid[ii], NULL);
+    }
+    for (int ii = 0; ii < pl->threads; ii++) {
+        pthread_mutex_destroy(&pl->deques[ii].lock);
+        free(pl->deques[ii].buf);
+    }
+    pthread_mutex_destroy(&pl->idle_lock);
+    pthread_cond_destroy(&pl->idle_cond);
+    free(pl->deques);
+    free(pl->workers);
+    free(pl->tid);
+    free(pl);
+    *pool = NULL;
+}
+
+/* threads 为包括调用者在内的线程数, 失败返回 NULL */
+task_pool* task_pool_create(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    task_pool* pool = (task_pool*)calloc(1, sizeof(task_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->threads = threads;
+    pool->deques = (task_deque*)calloc(threads, sizeof(task_deque));
+    pool->workers = (task_worker*)calloc(threads, sizeof(task_worker));
+    pool->tid = (pthread_t*)calloc(threads, sizeof(pthread_t));
+    if (pool->deques == NULL || pool->workers == NULL || pool->tid == NULL) {
+        free(pool->deques);
+        free(pool->workers);
+        free(pool->tid);
+        free(pool);
+        return NULL;
+    }
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->stop, false);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    for (int ii = 0; ii < threads; ii++) {
+        pthread_mutex_init(&pool->deques[ii].lock, NULL);
+        pool->workers[ii].pool = pool;
+        pool->workers[ii].id = ii;
+    }
+    for (int ii = 1; ii < threads; ii++) {
+        if (pthread_create(&pool->tid[pool->spawned], NULL, task_worker_loop, &pool->workers[ii]) != 0) {
+            /* 未能启动的 worker 的队列仍会被其他线程偷取 */
+            break;
+        }
+        pool->spawned++;
+    }
+    return pool;
+}
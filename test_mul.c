@@ -0,0 +1,561 @@
+// MIT License
+//
+// Copyright (c) 2025 Jecricho Knox
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/*
+ * 正确性测试 (ctest): test_mul
+ *
+ * 整数乘法: 小规模与 limb_mul_basecase 逐字比较; 大规模先用模 q = 2^61 - 1 的值校验 abs_mul64 / abs_sqr64
+ * (2^64 = 8 mod q), 其余接口 (mt, plan, ws, pre, trunc, aos, auto, unbal, bits, file) 须与之逐字相同.
+ * 多项式: abs_conv64_coef 与精确的系数卷积比较, poly_mul_mod / poly_mul_anymod 小规模与朴素卷积比较,
+ * 大规模检查随机点上 C(x) = A(x) * B(x). abs_mul64_bits 检查每位 < 2^bits 且模 q 的值正确.
+ * 输入为随机与全 1 两种, 长度取 2^k, 3 * 2^k, 5 * 2^k 附近; 用例以默认参数, 降低的 conv_task_grain,
+ * 强制四步法各跑一遍 (后两遍只跑受其影响的用例). 失败时打印第一处不同并以 1 退出.
+ */
+#undef NDEBUG // 断言在测试中始终生效
+#define NTT_NO_MAIN
+#include "main.c"
+
+#define TEST_Q 0x1FFFFFFFFFFFFFFFull // 2^61 - 1
+#define TEST_THREADS 3
+
+static int test_failures = 0;
+static const char* test_pass_name = "";
+static u64 test_rng = 88172645463325252ull;
+
+static u64 test_next(void) {
+    test_rng ^= test_rng << 13;
+    test_rng ^= test_rng >> 7;
+    test_rng ^= test_rng << 17;
+    return test_rng;
+}
+
+/* ones 为真时全 1, 否则随机; 每个字再与 mask 相与 */
+static void test_fill(u64* arr, u64 len, bool ones, u64 mask) {
+    for (u64 ii = 0; ii < len; ii++) {
+        arr[ii] = (ones ? ~0ull : test_next()) & mask;
+    }
+}
+
+static u64* test_alloc(u64 len) {
+    u64* arr = (u64*)malloc((len ? len : 1) * sizeof(u64));
+    if (arr == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    return arr;
+}
+
+static void test_fail(const char* what, u64 len1, u64 len2, const char* detail) {
+    printf("FAIL [%s] %s len1=%llu len2=%llu: %s\n", test_pass_name, what, (unsigned long long)len1,
+           (unsigned long long)len2, detail);
+    test_failures++;
+}
+
+static void test_expect(bool ok, const char* what, u64 len1, u64 len2, const char* detail) {
+    if (!ok) {
+        test_fail(what, len1, len2, detail);
+    }
+}
+
+static void test_cmp(const char* what, const u64* got, const u64* want, u64 len, u64 len1, u64 len2) {
+    for (u64 ii = 0; ii < len; ii++) {
+        if (got[ii] != want[ii]) {
+            char detail[128];
+            snprintf(detail, sizeof(detail), "word %llu is %016llx, expected %016llx", (unsigned long long)ii,
+                     (unsigned long long)got[ii], (unsigned long long)want[ii]);
+            test_fail(what, len1, len2, detail);
+            return;
+        }
+    }
+}
+
+/* a * b mod m, a, b < m < 2^63 */
+static u64 test_mulmod(u64 a, u64 b, u64 m) {
+    u128 prod = {0, 0};
+    _u128mul(prod, a, b);
+    return prod[0] - udiv128by64(prod[1], prod[0], m) * m;
+}
+
+/* sum_i c[i * stride] * x^i mod m, x < m < 2^63; 乘 x 用预计算的商 x' = floor(x * 2^64 / m) */
+static u64 test_eval(const u64* c, u64 len, size_t stride, u64 x, u64 m) {
+    const u64 x_pre = udiv128by64(x, 0, m);
+    u64 h = 0;
+    for (u64 ii = len; ii-- > 0;) {
+        u128 q = {0, 0};
+        _u128mul(q, h, x_pre);
+        h = h * x - q[1] * m;
+        h = (h >= m) ? h - m : h;
+        h += c[ii * stride] % m;
+        h = (h >= m) ? h - m : h;
+    }
+    return h;
+}
+
+/* 2^bits mod m */
+static u64 test_pow2(unsigned bits, u64 m) {
+    return (bits == 64) ? 0 - udiv128by64(1, 0, m) * m : (1ull << bits) % m;
+}
+
+/* 2^bits 进制的 out[0, len1 + len2) 是否等于 a * b (模 q) */
+static bool test_int_mod_q(const u64* a, u64 len1, const u64* b, u64 len2, const u64* out, unsigned bits) {
+    u64 x = test_pow2(bits, TEST_Q);
+    u64 va = test_eval(a, len1, 1, x, TEST_Q), vb = test_eval(b, len2, 1, x, TEST_Q);
+    return test_eval(out, len1 + len2, 1, x, TEST_Q) == test_mulmod(va, vb, TEST_Q);
+}
+
+/* 所有整数乘法接口的结果都须与 want[0, len1 + len2) 逐字相同, a == b 时为平方 */
+static void test_int_apis(const u64* a, u64 len1, const u64* b, u64 len2, const u64* want) {
+    const bool sqr = (a == b && len1 == len2);
+    const u64 len = len1 + len2;
+    u64* out = test_alloc(len);
+#define TEST_RUN(what, call)                               \
+    do {                                                   \
+        memset(out, 0xA5, len * sizeof(u64));              \
+        call;                                              \
+        test_cmp(what, out, want, len, len1, len2);        \
+    } while (0)
+
+    if (sqr) {
+        TEST_RUN("abs_sqr64", abs_sqr64((u64*)a, len1, out));
+        TEST_RUN("abs_sqr64_mt", abs_sqr64_mt((u64*)a, len1, out, TEST_THREADS));
+    } else {
+        TEST_RUN("abs_mul64", abs_mul64((u64*)a, len1, (u64*)b, len2, out));
+        TEST_RUN("abs_mul64_mt", abs_mul64_mt((u64*)a, len1, (u64*)b, len2, out, TEST_THREADS));
+        TEST_RUN("abs_mul64_unbal", abs_mul64_unbal(a, len1, b, len2, out));
+    }
+    TEST_RUN("abs_mul64_trunc", abs_mul64_trunc(a, len1, b, len2, out));
+    TEST_RUN("abs_mul64_aos", abs_mul64_aos(a, len1, b, len2, out));
+    TEST_RUN("abs_mul64_auto", abs_mul64_auto(a, len1, b, len2, out));
+    TEST_RUN("abs_mul64_bits(64)", abs_mul64_bits(a, len1, b, len2, 64, out));
+
+    size_t bytes = abs_mul64_workspace_size(len1, len2);
+    void* ws = malloc(bytes);
+    if (ws == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        abort();
+    }
+    test_expect(abs_mul64_ws(a, len1, b, len2, out, ws, bytes - 1) == -1, "abs_mul64_ws", len1, len2,
+                "accepted a short workspace");
+    TEST_RUN("abs_mul64_ws", test_expect(abs_mul64_ws(a, len1, b, len2, out, ws, bytes) == 0, "abs_mul64_ws",
+                                         len1, len2, "returned -1"));
+    free(ws);
+
+    /* 单线程计划的三个模数共用一块 tmp, 多线程计划各自一块; 同一计划执行两次 */
+    for (int threads = 1; threads <= TEST_THREADS; threads += TEST_THREADS - 1) {
+        unsigned flags = (threads == 1) ? MUL_PLAN_DEFAULT : MUL_PLAN_NO_PREFAULT;
+        mul_plan* plan = mul_plan_create_mt(len1, len2, flags, threads);
+        test_expect(plan != NULL, "mul_plan_create_mt", len1, len2, "returned NULL");
+        if (plan == NULL) {
+            continue;
+        }
+        for (int rep = 0; rep < 2; rep++) {
+            TEST_RUN(threads == 1 ? "mul_plan_execute" : "mul_plan_execute(mt)",
+                     test_expect(mul_plan_execute(plan, a, len1, b, len2, out) == 0, "mul_plan_execute", len1, len2,
+                                 "returned -1"));
+        }
+        mul_plan_destroy(&plan);
+        test_expect(plan == NULL, "mul_plan_destroy", len1, len2, "did not clear the handle");
+    }
+
+    mul_operand* op = mul_operand_precompute(a, len1, len1 + len2 - 1);
+    test_expect(op != NULL, "mul_operand_precompute", len1, len2, "returned NULL");
+    if (op != NULL) {
+        TEST_RUN("abs_mul64_pre", test_expect(abs_mul64_pre(op, b, len2, out) == 0, "abs_mul64_pre", len1, len2,
+                                              "returned -1"));
+        mul_operand_destroy(&op);
+    }
+#undef TEST_RUN
+    free(out);
+}
+
+/* 小规模: 以 limb_mul_basecase 为准 */
+static void test_int_small(u64 len1, u64 len2, bool ones) {
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *want = test_alloc(len1 + ((len1 > len2) ? len1 : len2));
+    test_fill(a, len1, ones, ~0ull);
+    test_fill(b, len2, ones, ~0ull);
+    limb_mul_basecase(want, a, len1, b, len2);
+    test_int_apis(a, len1, b, len2, want);
+    limb_mul_basecase(want, a, len1, a, len1);
+    test_int_apis(a, len1, a, len1, want);
+    free(a);
+    free(b);
+    free(want);
+}
+
+/* 大规模: abs_mul64 / abs_sqr64 模 q 校验后作为其余接口的参照 */
+static void test_int_large(u64 len1, u64 len2, bool ones, bool with_sqr) {
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *want = test_alloc(len1 + len2);
+    test_fill(a, len1, ones, ~0ull);
+    test_fill(b, len2, ones, ~0ull);
+    abs_mul64(a, len1, b, len2, want);
+    test_expect(test_int_mod_q(a, len1, b, len2, want, 64), "abs_mul64 mod q", len1, len2, "wrong residue");
+    test_int_apis(a, len1, b, len2, want);
+    if (with_sqr) {
+        abs_sqr64(a, len1, want);
+        test_expect(test_int_mod_q(a, len1, a, len1, want, 64), "abs_sqr64 mod q", len1, len1, "wrong residue");
+        test_int_apis(a, len1, a, len1, want);
+    }
+    free(a);
+    free(b);
+    free(want);
+}
+
+/* in2 为 in1 的前缀 (同一指针, 长度不同), 各接口的结果须与不重叠时相同 */
+static void test_int_alias(u64 len1, u64 len2, bool ones) {
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *want = test_alloc(len1 + len2);
+    test_fill(a, len1, ones, ~0ull);
+    memcpy(b, a, len2 * sizeof(u64));
+    abs_mul64(a, len1, b, len2, want);
+    test_expect(test_int_mod_q(a, len1, b, len2, want, 64), "abs_mul64 mod q", len1, len2, "wrong residue");
+    test_int_apis(a, len1, a, len2, want);
+    free(a);
+    free(b);
+    free(want);
+}
+
+/* abs_mul64_bits: 每位 < 2^bits, 且按 2^bits 进制的值模 q 正确 */
+static void test_bits(u64 len1, u64 len2, unsigned bits, bool ones) {
+    const u64 mask = (bits == 64) ? ~0ull : (1ull << bits) - 1;
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *out = test_alloc(len1 + ((len1 > len2) ? len1 : len2));
+    test_fill(a, len1, ones, mask);
+    test_fill(b, len2, ones, mask);
+    for (int sqr = 0; sqr < 2; sqr++) {
+        const u64* bb = sqr ? a : b;
+        u64 lb = sqr ? len1 : len2;
+        abs_mul64_bits(a, len1, bb, lb, bits, out);
+        bool digits_ok = true;
+        for (u64 ii = 0; ii < len1 + lb; ii++) {
+            digits_ok = digits_ok && (out[ii] & ~mask) == 0;
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "abs_mul64_bits(%u)%s", bits, sqr ? " sqr" : "");
+        test_expect(digits_ok, what, len1, lb, "digit out of range");
+        test_expect(test_int_mod_q(a, len1, bb, lb, out, bits), what, len1, lb, "wrong residue");
+    }
+    free(a);
+    free(b);
+    free(out);
+}
+
+/* abs_conv64_coef: 与逐项 limb_mul_basecase 累加的精确系数比较 */
+#define TEST_COEF_WORDS 8
+
+static void test_coef(u64 len1, unsigned bits1, u64 len2, unsigned bits2, bool ones) {
+    const size_t w1 = (bits1 + 63) / 64, w2 = (bits2 + 63) / 64;
+    const u64 conv_len = len1 + len2 - 1;
+    u64 *a = test_alloc(len1 * w1), *b = test_alloc(len2 * w2);
+    for (u64 ii = 0; ii < len1 * w1; ii++) {
+        unsigned top = bits1 - (unsigned)(ii % w1) * 64;
+        a[ii] = (ones ? ~0ull : test_next()) & ((top >= 64) ? ~0ull : (1ull << top) - 1);
+    }
+    for (u64 ii = 0; ii < len2 * w2; ii++) {
+        unsigned top = bits2 - (unsigned)(ii % w2) * 64;
+        b[ii] = (ones ? ~0ull : test_next()) & ((top >= 64) ? ~0ull : (1ull << top) - 1);
+    }
+    for (int sqr = 0; sqr < 2; sqr++) {
+        if (sqr && (bits1 != bits2 || len1 != len2)) {
+            break;
+        }
+        const u64* bb = sqr ? a : b;
+        size_t mods = ntt_mod_count(bits1, bits2, (len1 < len2) ? len1 : len2);
+        u64* out = test_alloc(conv_len * (mods ? mods : 1));
+        int ret = abs_conv64_coef(a, len1, bits1, bb, len2, bits2, out);
+        char what[64];
+        snprintf(what, sizeof(what), "abs_conv64_coef(%u, %u)%s", bits1, bits2, sqr ? " sqr" : "");
+        if (mods == 0 || ret != (int)mods) {
+            test_expect(mods == 0 && ret == -1, what, len1, len2, "wrong modulus count");
+            free(out);
+            continue;
+        }
+        u64 acc[TEST_COEF_WORDS], prod[TEST_COEF_WORDS];
+        for (u64 kk = 0; kk < conv_len; kk++) {
+            memset(acc, 0, sizeof(acc));
+            u64 lo = (kk >= len2) ? kk - len2 + 1 : 0, hi = (kk < len1) ? kk : len1 - 1;
+            for (u64 ii = lo; ii <= hi; ii++) {
+                memset(prod, 0, sizeof(prod));
+                limb_mul_basecase(prod, a + ii * w1, w1, bb + (kk - ii) * w2, w2);
+                limb_add_n(acc, acc, prod, TEST_COEF_WORDS);
+            }
+            bool ok = true;
+            for (size_t ww = 0; ww < TEST_COEF_WORDS; ww++) {
+                ok = ok && (ww < mods ? out[kk * mods + ww] : 0) == acc[ww];
+            }
+            if (!ok) {
+                char detail[64];
+                snprintf(detail, sizeof(detail), "coefficient %llu", (unsigned long long)kk);
+                test_fail(what, len1, len2, detail);
+                break;
+            }
+        }
+        free(out);
+    }
+    free(a);
+    free(b);
+}
+
+/* 多项式乘积 out (规范值, < m) 的校验: 短的与朴素卷积逐项比较, 长的在随机点上求值 */
+#define TEST_NAIVE_MAX 600
+
+static void test_poly_check(const char* what, const u64* a, u64 len1, const u64* b, u64 len2, const u64* out, u64 m) {
+    const u64 conv_len = len1 + len2 - 1;
+    for (u64 kk = 0; kk < conv_len; kk++) {
+        if (out[kk] >= m) {
+            test_fail(what, len1, len2, "coefficient not reduced");
+            return;
+        }
+    }
+    if (len1 > TEST_NAIVE_MAX || len2 > TEST_NAIVE_MAX) {
+        for (int rep = 0; rep < 2; rep++) {
+            u64 x = test_next() % m;
+            u64 va = test_eval(a, len1, 1, x, m), vb = test_eval(b, len2, 1, x, m);
+            if (test_eval(out, conv_len, 1, x, m) != test_mulmod(va, vb, m)) {
+                test_fail(what, len1, len2, "C(x) != A(x) * B(x)");
+                return;
+            }
+        }
+        return;
+    }
+    for (u64 kk = 0; kk < conv_len; kk++) {
+        u64 sum = 0, lo = (kk >= len2) ? kk - len2 + 1 : 0, hi = (kk < len1) ? kk : len1 - 1;
+        for (u64 ii = lo; ii <= hi; ii++) {
+            sum += test_mulmod(a[ii] % m, b[kk - ii] % m, m);
+            sum = (sum >= m) ? sum - m : sum;
+        }
+        if (out[kk] != sum) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "coefficient %llu", (unsigned long long)kk);
+            test_fail(what, len1, len2, detail);
+            return;
+        }
+    }
+}
+
+/* poly_mul_mod: 任意 u64 输入, 以及 Montgomery 形式的输入输出 */
+static void test_poly_mod(size_t mod, u64 len1, u64 len2, bool ones) {
+    const u64 p = poly_mod_prime(mod), len_max = (len1 > len2) ? len1 : len2, conv_len = len1 + len_max - 1;
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *out = test_alloc(conv_len);
+    u64 *ma = test_alloc(len1), *mb = test_alloc(len_max), *mout = test_alloc(conv_len);
+    test_fill(a, len1, ones, ~0ull);
+    test_fill(b, len2, ones, ~0ull);
+    char what[64];
+    for (int sqr = 0; sqr < 2; sqr++) {
+        const u64* bb = sqr ? a : b;
+        u64 lb = sqr ? len1 : len2, cl = len1 + lb - 1;
+        snprintf(what, sizeof(what), "poly_mul_mod(%zu)%s", mod, sqr ? " sqr" : "");
+        test_expect(poly_mul_mod(mod, a, len1, bb, lb, out, 0) == 0, what, len1, lb, "returned -1");
+        test_poly_check(what, a, len1, bb, lb, out, p);
+
+        /* Montgomery 形式的往返须得到同样的结果 */
+        snprintf(what, sizeof(what), "poly_mul_mod(%zu) mont%s", mod, sqr ? " sqr" : "");
+        poly_mod_tomont(mod, a, len1, ma);
+        poly_mod_tomont(mod, bb, lb, mb);
+        test_expect(poly_mul_mod(mod, ma, len1, sqr ? ma : mb, lb, mout, POLY_MONT_IN | POLY_MONT_OUT) == 0, what,
+                    len1, lb, "returned -1");
+        poly_mod_toint(mod, mout, cl, mout);
+        test_cmp(what, mout, out, cl, len1, lb);
+    }
+    free(a);
+    free(b);
+    free(out);
+    free(ma);
+    free(mb);
+    free(mout);
+}
+
+/* poly_mul_anymod, _mt 与 _batch; batch 的每一组须与单独计算的结果相同 */
+#define TEST_BATCH 4
+
+static void test_anymod(u64 m, u64 len1, u64 len2, bool ones) {
+    const u64 conv_len = len1 + len2 - 1;
+    u64 *a = test_alloc(len1 * TEST_BATCH), *b = test_alloc(len2 * TEST_BATCH);
+    u64 *out = test_alloc(conv_len), *bout = test_alloc(conv_len * TEST_BATCH);
+    test_fill(a, len1 * TEST_BATCH, ones, ~0ull);
+    test_fill(b, len2 * TEST_BATCH, ones, ~0ull);
+    char what[64];
+    snprintf(what, sizeof(what), "poly_mul_anymod(%llu)", (unsigned long long)m);
+    test_expect(poly_mul_anymod(m, a, len1, b, len2, out) == 0, what, len1, len2, "returned -1");
+    test_poly_check(what, a, len1, b, len2, out, m);
+
+    snprintf(what, sizeof(what), "poly_mul_anymod_mt(%llu)", (unsigned long long)m);
+    test_expect(poly_mul_anymod_mt(m, a, len1, b, len2, bout, TEST_THREADS) == 0, what, len1, len2, "returned -1");
+    test_cmp(what, bout, out, conv_len, len1, len2);
+
+    snprintf(what, sizeof(what), "poly_mul_anymod_mt(%llu) sqr", (unsigned long long)m);
+    test_expect(poly_mul_anymod_mt(m, a, len1, a, len1, bout, TEST_THREADS) == 0, what, len1, len1, "returned -1");
+    test_poly_check(what, a, len1, a, len1, bout, m);
+
+    const u64* in1[TEST_BATCH];
+    const u64* in2[TEST_BATCH];
+    u64* outs[TEST_BATCH];
+    for (size_t ii = 0; ii < TEST_BATCH; ii++) {
+        in1[ii] = a + ii * len1, in2[ii] = b + ii * len2, outs[ii] = bout + ii * conv_len;
+    }
+    snprintf(what, sizeof(what), "poly_mul_anymod_batch(%llu)", (unsigned long long)m);
+    test_expect(poly_mul_anymod_batch(m, TEST_BATCH, in1, len1, in2, len2, outs, 2) == 0, what, len1, len2,
+                "returned -1");
+    for (size_t ii = 0; ii < TEST_BATCH; ii++) {
+        test_expect(poly_mul_anymod(m, in1[ii], len1, in2[ii], len2, out) == 0, what, len1, len2, "returned -1");
+        test_cmp(what, outs[ii], out, conv_len, len1, len2);
+    }
+    free(a);
+    free(b);
+    free(out);
+    free(bout);
+}
+
+#ifndef _WIN32
+static void test_write_file(const char* path, const u64* arr, u64 len) {
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL || fwrite(arr, sizeof(u64), len, fp) != len) {
+        fprintf(stderr, "Cannot write %s.\n", path);
+        abort();
+    }
+    fclose(fp);
+}
+
+/* abs_mul64_file: 在当前目录下建立输入与临时文件, mem_budget 小于整个变换时走文件映射的四步法 */
+static void test_file(u64 len1, u64 len2, size_t mem_budget) {
+    const u64 len = len1 + ((len1 > len2) ? len1 : len2);
+    u64 *a = test_alloc(len1), *b = test_alloc(len2), *want = test_alloc(len), *out = test_alloc(len);
+    test_fill(a, len1, false, ~0ull);
+    test_fill(b, len2, false, ~0ull);
+    test_write_file("test_mul_a.bin", a, len1);
+    test_write_file("test_mul_b.bin", b, len2);
+    for (int sqr = 0; sqr < 2; sqr++) {
+        const char* what = sqr ? "abs_mul64_file sqr" : "abs_mul64_file";
+        u64 lb = sqr ? len1 : len2;
+        if (sqr) {
+            abs_sqr64(a, len1, want);
+        } else {
+            abs_mul64(a, len1, b, len2, want);
+        }
+        int ret = abs_mul64_file("test_mul_a.bin", sqr ? "test_mul_a.bin" : "test_mul_b.bin", "test_mul_out.bin", ".",
+                                 mem_budget);
+        test_expect(ret == 0, what, len1, lb, "returned -1");
+        FILE* fp = fopen("test_mul_out.bin", "rb");
+        bool read_ok = fp != NULL && fread(out, sizeof(u64), len1 + lb, fp) == len1 + lb;
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        test_expect(ret != 0 || read_ok, what, len1, lb, "output file too short");
+        if (ret == 0 && read_ok) {
+            test_cmp(what, out, want, len1 + lb, len1, lb);
+        }
+    }
+    remove("test_mul_a.bin");
+    remove("test_mul_b.bin");
+    remove("test_mul_out.bin");
+    free(a);
+    free(b);
+    free(want);
+    free(out);
+}
+#endif
+
+/*
+ * full 为假时只跑受 conv_task_grain / ntt_four_step_threshold 影响的用例: 小规模 (多线程路径) 与变换长度
+ * 2^18 (> long_threshold) 的随机输入.
+ */
+static void test_pass(const char* name, bool full) {
+    test_pass_name = name;
+    static const u64 small[][2] = {{1, 1},      {1, 5},       {2, 3},       {7, 7},       {31, 33},
+                                   {64, 64},    {127, 129},   {128, 128},   {255, 1},     {256, 257},
+                                   {1000, 24},  {1023, 1024}, {1024, 1025}, {768, 769},   {1280, 1281},
+                                   {1536, 1537}, {2049, 40},  {3000, 100}};
+    /* 卷积长度 2^17 - 1, 2^17, 3 * 2^16, 5 * 2^15 - 1, 2^18 - 1, 2^18, 以及不平衡; 第三列为是否也测平方 */
+    static const u64 large[][3] = {{1 << 16, 1 << 16, 1},       {(1 << 16) + 1, 1 << 16, 0},
+                                   {(3 << 15) + 1, 3 << 15, 0}, {5 << 14, 5 << 14, 1},
+                                   {1 << 17, 1 << 17, 1},       {(1 << 17) + 1, 1 << 17, 0},
+                                   {1 << 18, 3000, 0}};
+    static const u64 moduli[] = {2, 3, 998244353, 1000000007, 1ull << 40, (1ull << 61) - 1, (1ull << 63) - 25};
+    static const unsigned bits[] = {1, 7, 32, 52, 63};
+    static const unsigned coef_bits[][2] = {{32, 32}, {64, 64}, {100, 64}, {128, 128}, {64, 1}, {192, 192}};
+
+    for (int ones = 0; ones < (full ? 2 : 1); ones++) {
+        for (size_t ii = 0; ii < sizeof(small) / sizeof(small[0]); ii++) {
+            test_int_small(small[ii][0], small[ii][1], ones);
+        }
+        for (size_t ii = 0; ii < sizeof(large) / sizeof(large[0]); ii++) {
+            if (full || int_ceil2(large[ii][0] + large[ii][1] - 1) == 2 * long_threshold) {
+                test_int_large(large[ii][0], large[ii][1], ones, large[ii][2] != 0);
+            }
+        }
+        test_bits((1 << 17) + 1, 1 << 17, 32, ones);
+        test_poly_mod(1, (1 << 17) + 1, 1 << 17, ones);
+        test_anymod((1ull << 63) - 25, 3 << 15, (3 << 15) + 1, ones);
+        if (!full) {
+            continue;
+        }
+        test_int_alias(3000, 1500, ones);
+        test_int_alias(1 << 17, 5 << 13, ones);
+        test_bits((1 << 17) + 1, 1 << 17, 7, ones);
+        test_poly_mod(4, (1 << 17) + 1, 1 << 17, ones);
+        test_anymod(1000000007, 3 << 15, (3 << 15) + 1, ones);
+
+        for (size_t bb = 0; bb < sizeof(bits) / sizeof(bits[0]); bb++) {
+            test_bits(1, 1, bits[bb], ones);
+            test_bits(100, 37, bits[bb], ones);
+            test_bits(1000, 1000, bits[bb], ones);
+            test_bits(5000, 4097, bits[bb], ones);
+        }
+        for (size_t cc = 0; cc < sizeof(coef_bits) / sizeof(coef_bits[0]); cc++) {
+            test_coef(1, coef_bits[cc][0], 1, coef_bits[cc][1], ones);
+            test_coef(5, coef_bits[cc][0], 300, coef_bits[cc][1], ones);
+            test_coef(257, coef_bits[cc][0], 257, coef_bits[cc][1], ones);
+        }
+        for (size_t mod = 1; mod <= NTT_MOD_MAX; mod++) {
+            test_poly_mod(mod, 1, 1, ones);
+            test_poly_mod(mod, 300, 257, ones);
+            test_poly_mod(mod, 5000, 4097, ones);
+        }
+        for (size_t mm = 0; mm < sizeof(moduli) / sizeof(moduli[0]); mm++) {
+            test_anymod(moduli[mm], 1, 1, ones);
+            test_anymod(moduli[mm], 300, 257, ones);
+            test_anymod(moduli[mm], 5000, 4097, ones);
+        }
+    }
+#ifndef _WIN32
+    if (full) {
+        test_file(100, 50, (size_t)64 << 20);
+    }
+    test_file(1 << 17, (1 << 17) - 3, (size_t)4 << 20);
+#endif
+}
+
+int main(void) {
+    test_pass("default", true);
+
+    /* 让并行路径在较短的变换上也切出任务 */
+    size_t grain = conv_task_grain, chunk = conv_task_chunk;
+    conv_task_grain = 4096, conv_task_chunk = 1024;
+    test_pass("grain 4096", false);
+    conv_task_grain = grain, conv_task_chunk = chunk;
+
+    /* 所有超过 long_threshold 的 2 的幂长度都用四步法 */
+    size_t four_step = ntt_four_step_threshold;
+    ntt_four_step_threshold = 0;
+    test_pass("four-step", false);
+    ntt_four_step_threshold = four_step;
+
+    printf("%s: %d failure(s)\n", (test_failures == 0) ? "PASSED" : "FAILED", test_failures);
+    return (test_failures == 0) ? 0 : 1;
+}